@@ -1,5 +1,8 @@
 #include "app.h"
 
+#include <thread>
+#include <string>
+
 #include "third_party/imgui/imgui.h"
 #include "third_party/imgui/imgui_impl_sdl3.h"
 #include "third_party/imgui/imgui_impl_vulkan.h"
@@ -11,18 +14,76 @@
 #include "math/colour.h"
 #include "math/timer.h"
 
+#include "graphics/bitmap.h"
+#include "graphics/swapchain.h"
+
 #include "rendering/light.h"
 #include "rendering/vertex_types.h"
 #include "rendering/model.h"
+#include "rendering/culling.h"
 
 using namespace mgp;
 
+// the path comes straight off the command line so it never gets anywhere near printf as a format
+// the first %d or %0Nd is replaced with the frame number, %% is a literal % and anything else is copied as is
+static std::string formatCapturePath(const char *pattern, unsigned frame)
+{
+	std::string path;
+	bool replaced = false;
+
+	for (const char *c = pattern; *c != '\0'; c++)
+	{
+		if (c[0] == '%' && c[1] == '%')
+		{
+			path += '%';
+			c++;
+
+			continue;
+		}
+
+		if (c[0] == '%' && !replaced)
+		{
+			const char *end = c + 1;
+
+			bool zeroPad = (*end == '0');
+			int width = 0;
+
+			while (*end >= '0' && *end <= '9')
+			{
+				width = CalcI::min(width * 10 + (*end - '0'), 16);
+				end++;
+			}
+
+			if (*end == 'd')
+			{
+				std::string number = std::to_string(frame);
+
+				if ((int)number.size() < width)
+					number.insert(0, width - (int)number.size(), zeroPad ? '0' : ' ');
+
+				path += number;
+				c = end;
+				replaced = true;
+
+				continue;
+			}
+		}
+
+		path += *c;
+	}
+
+	return path;
+}
+
 void App::run(const Config &config)
 {
 	m_config = config;
 
 	init();
 
+	if (m_config.cullBenchmarkCount > 0)
+		runCullingBenchmark(m_platform, m_config.cullBenchmarkCount);
+
 	m_running = true;
 
 	auto obj = m_scene.createRenderObject();
@@ -61,6 +122,21 @@ void App::run(const Config &config)
 	double accumulator = 0.0;
 	const double fixedDeltaTime = 1.0 / static_cast<double>(CalcU::min(m_config.targetFPS, m_platform->getWindowRefreshRate()));
 
+	const bool headless = m_config.hasFlag(CONFIG_FLAG_HEADLESS_BIT);
+
+	Bitmap *capture = nullptr;
+
+	if (headless && m_config.capturePath)
+	{
+		capture = new Bitmap(m_graphics->getSwapchain()->getWidth(), m_graphics->getSwapchain()->getHeight());
+		m_graphics->setFrameReadback(true);
+	}
+
+	unsigned frameCount = 0;
+
+	Timer runTimer(m_platform);
+	runTimer.start();
+
 	Timer deltaTimer(m_platform);
 	deltaTimer.start();
 
@@ -68,17 +144,30 @@ void App::run(const Config &config)
 
 	while (m_running)
 	{
-		m_platform->pollEvents(&m_inputSt, [&]() { exit(); }, nullptr);
-		m_inputSt.update();
+		double deltaTime = deltaTimer.reset();
 
-		if (m_inputSt.isPressed(KB_KEY_ESCAPE))
-			exit();
+		if (headless)
+		{
+			// no window to pull input or a display size from
+			ImGuiIO &io = ImGui::GetIO();
+			io.DisplaySize = ImVec2((float)m_config.width, (float)m_config.height);
+			io.DeltaTime = CalcD::max(deltaTime, 1.0 / 1000.0);
 
-		ImGui_ImplVulkan_NewFrame();
-		ImGui_ImplSDL3_NewFrame();
-		ImGui::NewFrame();
+			ImGui_ImplVulkan_NewFrame();
+			ImGui::NewFrame();
+		}
+		else
+		{
+			m_platform->pollEvents(&m_inputSt, [&]() { exit(); }, nullptr);
+			m_inputSt.update();
 
-		double deltaTime = deltaTimer.reset();
+			if (m_inputSt.isPressed(KB_KEY_ESCAPE))
+				exit();
+
+			ImGui_ImplVulkan_NewFrame();
+			ImGui_ImplSDL3_NewFrame();
+			ImGui::NewFrame();
+		}
 
 		tick(deltaTime);
 
@@ -91,13 +180,34 @@ void App::run(const Config &config)
 			accumulator -= fixedDeltaTime;
 		}
 
+		m_textures.update();
+
 		CommandBuffer *cmd = m_graphics->beginPresent();
-		render(cmd);
+		render(cmd, deltaTime);
 		m_graphics->present();
+
+		if (capture)
+		{
+			std::string path = formatCapturePath(m_config.capturePath, frameCount);
+
+			m_graphics->readbackFrame(capture);
+			capture->saveToPng(m_platform, path.c_str());
+		}
+
+		frameCount++;
+
+		if (m_config.frameCount > 0 && frameCount >= m_config.frameCount)
+			exit();
 	}
 
 	m_graphics->waitIdle();
 
+	double runTime = runTimer.getElapsedSeconds();
+
+	mgp_LOG("Rendered %u frames in %.3fs (%.3fms / frame)", frameCount, runTime, (runTime * 1000.0) / CalcD::max(frameCount, 1));
+
+	delete capture;
+
 	destroy();
 }
 
@@ -110,7 +220,8 @@ void App::init()
 	m_descriptorLayouts.init(m_graphics);
 	m_imageViews.init(m_graphics);
 
-	configure(m_config);
+	if (!m_config.hasFlag(CONFIG_FLAG_HEADLESS_BIT))
+		configure(m_config);
 	
 	vertex_types::initVertexTypes();
 
@@ -132,16 +243,41 @@ void App::init()
 	
 	m_bindlessResources = new BindlessResources(m_graphics);
 
-	m_textures.init(m_graphics);
+	m_textures.init(this);
 	m_shaders.init(this);
 
+	// compile everything the last run used up front so we don't hitch on first use
+	m_pipelines.prewarm(
+		gfx_constants::PIPELINE_MANIFEST_PATH,
+		[&](const std::string &name) -> const Shader * { return m_shaders.getShader(name); },
+		[&](const std::string &name) -> const VertexFormat * {
+			for (const VertexFormat *format : { &vertex_types::PRIMITIVE_VERTEX_FORMAT, &vertex_types::PRIMITIVE_UV_VERTEX_FORMAT, &vertex_types::MODEL_VERTEX_FORMAT, &vertex_types::PACKED_MODEL_VERTEX_FORMAT })
+			{
+				if (format->getName() == name)
+					return format;
+			}
+
+			return nullptr;
+		}
+	);
+
 	m_renderer.init(this);
 
+	// headless captures should be deterministic so only go async when we have a window
+	if (!m_config.hasFlag(CONFIG_FLAG_HEADLESS_BIT))
+	{
+		m_pipelines.startCompileWorkers(CalcU::max(1, std::thread::hardware_concurrency() / 2));
+		m_textures.startStreamingWorkers(CalcU::max(1, std::thread::hardware_concurrency() / 2));
+	}
+
 	m_camera = Camera(1280.0f / 720.0f, 70.0f, 0.01f, 50.0f);
 }
 
 void App::destroy()
 {
+	// the workers still hold on to shaders so they need to finish first
+	m_pipelines.stopCompileWorkers();
+
 	delete m_scene.getRenderObjects()[0].model; // kys
 	
 	delete m_modelLoader;
@@ -155,10 +291,15 @@ void App::destroy()
 	
 	m_imageViews.destroy();
 	m_descriptorLayouts.destroy();
+
+	m_pipelines.saveManifest(gfx_constants::PIPELINE_MANIFEST_PATH);
 	m_pipelines.destroy();
 
 	ImGui_ImplVulkan_Shutdown();
-	ImGui_ImplSDL3_Shutdown();
+
+	if (!m_config.hasFlag(CONFIG_FLAG_HEADLESS_BIT))
+		ImGui_ImplSDL3_Shutdown();
+
 	ImGui::DestroyContext();
 
 	delete m_graphics;
@@ -192,13 +333,14 @@ void App::tickFixed(float dt)
 {
 }
 
-void App::render(CommandBuffer *cmd)
+void App::render(CommandBuffer *cmd, float dt)
 {
 	RenderContext context;
 	context.cmd = cmd;
 	context.swapchain = m_graphics->getSwapchain();
 	context.scene = &m_scene;
 	context.camera = &m_camera;
+	context.deltaTime = dt;
 
 	m_renderer.render(context);
 }
@@ -55,7 +55,7 @@ namespace mgp
 
 		void tick(float dt);
 		void tickFixed(float dt);
-		void render(CommandBuffer *cmd);
+		void render(CommandBuffer *cmd, float dt);
 
 		Config m_config;
 		bool m_running;
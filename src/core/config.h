@@ -18,7 +18,8 @@ namespace mgp
 		CONFIG_FLAG_CURSOR_INVISIBLE_BIT	= 1 << 2,
 		CONFIG_FLAG_CENTRE_WINDOW_BIT		= 1 << 3,
 		CONFIG_FLAG_HIGH_PIXEL_DENSITY_BIT	= 1 << 4,
-		CONFIG_FLAG_LOCK_CURSOR_BIT			= 1 << 5
+		CONFIG_FLAG_LOCK_CURSOR_BIT			= 1 << 5,
+		CONFIG_FLAG_HEADLESS_BIT			= 1 << 6
 	};
 
 	struct Config
@@ -44,6 +45,10 @@ namespace mgp
 		int flags = 0;
 		bool vsync = false;
 
+		unsigned frameCount = 0; // exit after this many frames, 0 = run until closed
+		const char *capturePath = nullptr; // headless only, path each frame is saved to, %d or %0Nd becomes the frame number
+		unsigned cullBenchmarkCount = 0; // if set, cull a synthetic scene of this many objects at startup and log the timings
+
 		WindowMode windowMode = WINDOW_MODE_WINDOWED;
 
 		constexpr bool hasFlag(ConfigFlag flag) const { return flags & flag; }
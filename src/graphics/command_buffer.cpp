@@ -14,6 +14,11 @@ CommandBuffer::CommandBuffer(VkCommandBuffer buffer)
 	: m_buffer(buffer)
 	, m_viewport()
 	, m_scissor()
+	, m_boundVertexBuffer(VK_NULL_HANDLE)
+	, m_boundVertexOffset(0)
+	, m_boundIndexBuffer(VK_NULL_HANDLE)
+	, m_boundIndexOffset(0)
+	, m_boundIndexType(VK_INDEX_TYPE_UINT16)
 {
 }
 
@@ -37,6 +42,8 @@ void CommandBuffer::begin()
 	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
+	resetBindings();
+
 	mgp_VK_CHECK(
 		vkBeginCommandBuffer(m_buffer, &commandBufferBeginInfo),
 		"Failed to begin recording instant command buffer"
@@ -71,6 +78,18 @@ void CommandBuffer::beginRendering(const RenderInfo &target)
 void CommandBuffer::endRendering()
 {
 	vkCmdEndRendering(m_buffer);
+
+	// anything recorded behind our back (imgui) may have bound its own buffers
+	resetBindings();
+}
+
+void CommandBuffer::resetBindings()
+{
+	m_boundVertexBuffer = VK_NULL_HANDLE;
+	m_boundVertexOffset = 0;
+	m_boundIndexBuffer = VK_NULL_HANDLE;
+	m_boundIndexOffset = 0;
+	m_boundIndexType = VK_INDEX_TYPE_UINT16;
 }
 
 void CommandBuffer::bindPipeline(
@@ -125,6 +144,48 @@ void CommandBuffer::drawIndexed(
 	);
 }
 
+void CommandBuffer::drawIndexedIndirectCount(
+	const GPUBuffer *buffer,
+	VkDeviceSize offset,
+	const GPUBuffer *countBuffer,
+	VkDeviceSize countOffset,
+	uint32_t maxDrawCount,
+	uint32_t stride
+)
+{
+	vkCmdSetViewport(m_buffer, 0, 1, &m_viewport);
+	vkCmdSetScissor(m_buffer, 0, 1, &m_scissor);
+
+	vkCmdDrawIndexedIndirectCount(
+		m_buffer,
+		buffer->getHandle(),
+		offset,
+		countBuffer->getHandle(),
+		countOffset,
+		maxDrawCount,
+		stride
+	);
+}
+
+void CommandBuffer::drawMeshTasksIndirect(
+	const GPUBuffer *buffer,
+	VkDeviceSize offset,
+	uint32_t drawCount,
+	uint32_t stride
+)
+{
+	vkCmdSetViewport(m_buffer, 0, 1, &m_viewport);
+	vkCmdSetScissor(m_buffer, 0, 1, &m_scissor);
+
+	vkCmdDrawMeshTasksIndirectEXT(
+		m_buffer,
+		buffer->getHandle(),
+		offset,
+		drawCount,
+		stride
+	);
+}
+
 void CommandBuffer::bindDescriptors(
 	uint32_t first,
 	VkPipelineBindPoint bindPoint,
@@ -191,6 +252,19 @@ void CommandBuffer::bindVertexBuffers(
 	const VkDeviceSize *offsets
 )
 {
+	if (firstBinding == 0 && count == 1)
+	{
+		if (buffers[0]->getHandle() == m_boundVertexBuffer && offsets[0] == m_boundVertexOffset)
+			return;
+
+		m_boundVertexBuffer = buffers[0]->getHandle();
+		m_boundVertexOffset = offsets[0];
+	}
+	else
+	{
+		m_boundVertexBuffer = VK_NULL_HANDLE;
+	}
+
 	std::vector<VkBuffer> vkBuffers(count);
 
 	for (uint32_t i = 0; i < count; i++) {
@@ -212,6 +286,13 @@ void CommandBuffer::bindIndexBuffer(
 	VkIndexType indexType
 )
 {
+	if (buffer->getHandle() == m_boundIndexBuffer && offset == m_boundIndexOffset && indexType == m_boundIndexType)
+		return;
+
+	m_boundIndexBuffer = buffer->getHandle();
+	m_boundIndexOffset = offset;
+	m_boundIndexType = indexType;
+
 	vkCmdBindIndexBuffer(
 		m_buffer,
 		buffer->getHandle(),
@@ -426,6 +507,22 @@ void CommandBuffer::copyBufferToBuffer(
 	);
 }
 
+void CommandBuffer::fillBuffer(
+	const GPUBuffer *buffer,
+	VkDeviceSize offset,
+	VkDeviceSize size,
+	uint32_t data
+)
+{
+	vkCmdFillBuffer(
+		m_buffer,
+		buffer->getHandle(),
+		offset,
+		size,
+		data
+	);
+}
+
 void CommandBuffer::copyBufferToImage(
 	const GPUBuffer *buffer,
 	const Image *image
@@ -469,6 +566,34 @@ void CommandBuffer::copyBufferToImage(
 	);
 }
 
+void CommandBuffer::copyImageToBuffer(
+	const Image *image,
+	const GPUBuffer *buffer
+)
+{
+	mgp_ASSERT(image->getLayout() == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, "image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL");
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { image->getWidth(), image->getHeight(), 1 };
+
+	vkCmdCopyImageToBuffer(
+		m_buffer,
+		image->getHandle(),
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		buffer->getHandle(),
+		1,
+		&region
+	);
+}
+
 void CommandBuffer::writeTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool pool, uint32_t query)
 {
 	vkCmdWriteTimestamp(
@@ -497,6 +622,15 @@ void CommandBuffer::dispatch(uint32_t gcX, uint32_t gcY, uint32_t gcZ)
 	);
 }
 
+void CommandBuffer::dispatchIndirect(const GPUBuffer *buffer, VkDeviceSize offset)
+{
+	vkCmdDispatchIndirect(
+		m_buffer,
+		buffer->getHandle(),
+		offset
+	);
+}
+
 VkCommandBuffer CommandBuffer::getHandle() const
 {
 	return m_buffer;
@@ -49,6 +49,24 @@ namespace mgp
 			uint32_t firstInstance = 0
 		);
 
+		// count is read from the gpu at countBuffer + countOffset and clamped to maxDrawCount
+		void drawIndexedIndirectCount(
+			const GPUBuffer *buffer,
+			VkDeviceSize offset,
+			const GPUBuffer *countBuffer,
+			VkDeviceSize countOffset,
+			uint32_t maxDrawCount,
+			uint32_t stride
+		);
+
+		// VK_EXT_mesh_shader, each command is a task workgroup count
+		void drawMeshTasksIndirect(
+			const GPUBuffer *buffer,
+			VkDeviceSize offset,
+			uint32_t drawCount,
+			uint32_t stride
+		);
+
 		void bindDescriptors(
 			uint32_t first,
 			VkPipelineBindPoint bindPoint,
@@ -104,6 +122,13 @@ namespace mgp
 			const std::vector<VkBufferCopy> &regions
 		);
 
+		void fillBuffer(
+			const GPUBuffer *buffer,
+			VkDeviceSize offset,
+			VkDeviceSize size,
+			uint32_t data
+		);
+
 		void copyBufferToImage(
 			const GPUBuffer *buffer,
 			const Image *image
@@ -115,21 +140,40 @@ namespace mgp
 			const std::vector<VkBufferImageCopy> &regions
 		);
 
+		void copyImageToBuffer(
+			const Image *image,
+			const GPUBuffer *buffer
+		);
+
 		void dispatch(
 			uint32_t gcX,
 			uint32_t gcY,
 			uint32_t gcZ
 		);
 
+		void dispatchIndirect(
+			const GPUBuffer *buffer,
+			VkDeviceSize offset
+		);
+
 		void writeTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool pool, uint32_t query);
 		void resetQueryPool(VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount);
 
 		VkCommandBuffer getHandle() const;
 
 	private:
+		void resetBindings();
+
 		VkCommandBuffer m_buffer;
 
 		VkViewport m_viewport;
 		VkRect2D m_scissor;
+
+		// meshes in the same geometry block bind the same buffers, so repeat binds get skipped
+		VkBuffer m_boundVertexBuffer;
+		VkDeviceSize m_boundVertexOffset;
+		VkBuffer m_boundIndexBuffer;
+		VkDeviceSize m_boundIndexOffset;
+		VkIndexType m_boundIndexType;
 	};
 }
@@ -7,5 +7,10 @@ namespace mgp
 	namespace gfx_constants
 	{
 		const static uint32_t FRAMES_IN_FLIGHT = 3;
+
+		const static uint64_t UPLOAD_RING_SIZE = 64 * 1024 * 1024;
+
+		const static char *const PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+		const static char *const PIPELINE_MANIFEST_PATH = "pipeline_manifest.bin";
 	}
 }
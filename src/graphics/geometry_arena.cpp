@@ -0,0 +1,282 @@
+#include "geometry_arena.h"
+
+#include "core/common.h"
+
+#include "math/calc.h"
+
+#include "graphics_core.h"
+#include "gpu_buffer.h"
+#include "vertex_format.h"
+
+using namespace mgp;
+
+RangeAllocator::RangeAllocator()
+	: m_freeRanges()
+	, m_size(0)
+	, m_used(0)
+{
+}
+
+void RangeAllocator::init(uint64_t size)
+{
+	m_freeRanges.clear();
+	m_freeRanges.insert({ 0, size });
+
+	m_size = size;
+	m_used = 0;
+}
+
+bool RangeAllocator::allocate(uint64_t size, uint64_t *offset)
+{
+	if (size == 0)
+	{
+		(*offset) = 0;
+		return true;
+	}
+
+	auto best = m_freeRanges.end();
+
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); it++)
+	{
+		if (it->second < size)
+			continue;
+
+		if (best == m_freeRanges.end() || it->second < best->second)
+			best = it;
+
+		// can't do any better than this
+		if (it->second == size)
+			break;
+	}
+
+	if (best == m_freeRanges.end())
+		return false;
+
+	uint64_t rangeOffset = best->first;
+	uint64_t rangeSize = best->second;
+
+	m_freeRanges.erase(best);
+
+	if (rangeSize > size)
+		m_freeRanges.insert({ rangeOffset + size, rangeSize - size });
+
+	m_used += size;
+
+	(*offset) = rangeOffset;
+
+	return true;
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t size)
+{
+	if (size == 0)
+		return;
+
+	m_used -= size;
+
+	auto next = m_freeRanges.lower_bound(offset);
+
+	// merge with the range right after us
+	if (next != m_freeRanges.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = m_freeRanges.erase(next);
+	}
+
+	// and the one right before
+	if (next != m_freeRanges.begin())
+	{
+		auto prev = std::prev(next);
+
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+
+	m_freeRanges.insert({ offset, size });
+}
+
+GeometryArena::GeometryArena()
+	: m_gfx(nullptr)
+	, m_pools()
+{
+}
+
+void GeometryArena::init(GraphicsCore *gfx)
+{
+	m_gfx = gfx;
+}
+
+void GeometryArena::destroy()
+{
+	for (auto &pool : m_pools)
+	{
+		for (auto &block : pool.blocks)
+		{
+			delete block.vertexBuffer;
+			delete block.indexBuffer;
+		}
+	}
+
+	m_pools.clear();
+}
+
+GeometryAllocation GeometryArena::allocate(const VertexFormat *format, const void *vertices, uint32_t vertexCount, const void *indices, uint32_t indexCount, VkIndexType indexType)
+{
+	int poolIndex = getPool(format, indexType);
+	Pool &pool = m_pools[poolIndex];
+
+	uint64_t firstVertex = 0;
+	uint64_t firstIndex = 0;
+
+	int blockIndex = -1;
+
+	// both halves have to come from the same block so one bind covers them
+	for (int i = 0; i < pool.blocks.size(); i++)
+	{
+		Block &block = pool.blocks[i];
+
+		if (!block.vertices.allocate(vertexCount, &firstVertex))
+			continue;
+
+		if (!block.indices.allocate(indexCount, &firstIndex))
+		{
+			block.vertices.free(firstVertex, vertexCount);
+			continue;
+		}
+
+		blockIndex = i;
+		break;
+	}
+
+	if (blockIndex < 0)
+	{
+		blockIndex = createBlock(pool, vertexCount, indexCount);
+
+		Block &block = pool.blocks[blockIndex];
+
+		block.vertices.allocate(vertexCount, &firstVertex);
+		block.indices.allocate(indexCount, &firstIndex);
+	}
+
+	Block &block = pool.blocks[blockIndex];
+
+	uint64_t vertexSize = format->getVertexSize();
+	uint64_t indexSize = getIndexSize(indexType);
+
+	if (vertexCount > 0)
+		m_gfx->getUploader().uploadBuffer(block.vertexBuffer, vertices, vertexCount * vertexSize, firstVertex * vertexSize);
+
+	if (indexCount > 0)
+		m_gfx->getUploader().uploadBuffer(block.indexBuffer, indices, indexCount * indexSize, firstIndex * indexSize);
+
+	GeometryAllocation allocation = {};
+	allocation.vertexBuffer = block.vertexBuffer;
+	allocation.indexBuffer = block.indexBuffer;
+	allocation.firstVertex = firstVertex;
+	allocation.firstIndex = firstIndex;
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+	allocation.indexType = indexType;
+	allocation.pool = poolIndex;
+	allocation.block = blockIndex;
+
+	return allocation;
+}
+
+void GeometryArena::free(const GeometryAllocation &allocation)
+{
+	Block &block = m_pools[allocation.pool].blocks[allocation.block];
+
+	block.vertices.free(allocation.firstVertex, allocation.vertexCount);
+	block.indices.free(allocation.firstIndex, allocation.indexCount);
+}
+
+int GeometryArena::getPool(const VertexFormat *format, VkIndexType indexType)
+{
+	for (int i = 0; i < m_pools.size(); i++)
+	{
+		if (m_pools[i].format == format && m_pools[i].indexType == indexType)
+			return i;
+	}
+
+	m_pools.push_back({ format, indexType, {} });
+
+	return m_pools.size() - 1;
+}
+
+int GeometryArena::createBlock(Pool &pool, uint64_t vertexCount, uint64_t indexCount)
+{
+	uint64_t vertexSize = pool.format->getVertexSize();
+	uint64_t indexSize = getIndexSize(pool.indexType);
+
+	// oversized meshes get a block of exactly their size rather than failing
+	uint64_t vertexCapacity = Calc<uint64_t>::max(VERTEX_BLOCK_SIZE / vertexSize, vertexCount);
+	uint64_t indexCapacity = Calc<uint64_t>::max(INDEX_BLOCK_SIZE / indexSize, indexCount);
+
+	Block block = {};
+
+	block.vertexBuffer = m_gfx->createGPUBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		vertexCapacity * vertexSize
+	);
+
+	block.indexBuffer = m_gfx->createGPUBuffer(
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		indexCapacity * indexSize
+	);
+
+	block.vertices.init(vertexCapacity);
+	block.indices.init(indexCapacity);
+
+	pool.blocks.push_back(block);
+
+	mgp_LOG("Created geometry block %d for vertex format '%s' (%llu vertices, %llu indices).", (int)pool.blocks.size() - 1, pool.format->getName().c_str(), (unsigned long long)vertexCapacity, (unsigned long long)indexCapacity);
+
+	return pool.blocks.size() - 1;
+}
+
+uint64_t GeometryArena::getUsedMemory() const
+{
+	uint64_t result = 0;
+
+	for (cauto &pool : m_pools)
+	{
+		for (cauto &block : pool.blocks)
+			result += block.vertices.getUsed() * pool.format->getVertexSize() + block.indices.getUsed() * getIndexSize(pool.indexType);
+	}
+
+	return result;
+}
+
+uint64_t GeometryArena::getReservedMemory() const
+{
+	uint64_t result = 0;
+
+	for (cauto &pool : m_pools)
+	{
+		for (cauto &block : pool.blocks)
+			result += block.vertexBuffer->getSize() + block.indexBuffer->getSize();
+	}
+
+	return result;
+}
+
+uint32_t GeometryArena::getBlockCount() const
+{
+	uint32_t result = 0;
+
+	for (cauto &pool : m_pools)
+		result += pool.blocks.size();
+
+	return result;
+}
+
+uint64_t GeometryArena::getIndexSize(VkIndexType indexType)
+{
+	return (indexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <vector>
+#include <map>
+
+#include <Volk/volk.h>
+
+namespace mgp
+{
+	class GraphicsCore;
+	class GPUBuffer;
+	class VertexFormat;
+
+	/*
+		Hands out ranges of a fixed-size span, picking the smallest free range that fits.
+		Freed ranges get merged back with their neighbours so the span doesn't fragment over time.
+	*/
+	class RangeAllocator
+	{
+	public:
+		RangeAllocator();
+		~RangeAllocator() = default;
+
+		void init(uint64_t size);
+
+		bool allocate(uint64_t size, uint64_t *offset);
+		void free(uint64_t offset, uint64_t size);
+
+		uint64_t getSize() const { return m_size; }
+		uint64_t getUsed() const { return m_used; }
+
+	private:
+		// offset -> size, ordered so neighbours are easy to find when merging
+		std::map<uint64_t, uint64_t> m_freeRanges;
+
+		uint64_t m_size;
+		uint64_t m_used;
+	};
+
+	// where a mesh's vertices and indices ended up, offsets are in elements rather than bytes so they can go straight into a draw
+	struct GeometryAllocation
+	{
+		GPUBuffer *vertexBuffer;
+		GPUBuffer *indexBuffer;
+
+		uint32_t firstVertex;
+		uint32_t firstIndex;
+
+		uint32_t vertexCount;
+		uint32_t indexCount;
+
+		VkIndexType indexType;
+
+		int pool;
+		int block;
+	};
+
+	/*
+		Big device-local vertex / index buffers shared by every mesh of the same vertex format and index type.
+		Meshes only get offsets into them, so drawing a run of meshes needs a single bind and they can share indirect draws.
+		A pool gets another block whenever it runs out of room, anything bigger than a block gets one to itself.
+	*/
+	class GeometryArena
+	{
+		constexpr static uint64_t VERTEX_BLOCK_SIZE = 64 * 1024 * 1024;
+		constexpr static uint64_t INDEX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+		struct Block
+		{
+			GPUBuffer *vertexBuffer;
+			GPUBuffer *indexBuffer;
+
+			RangeAllocator vertices;
+			RangeAllocator indices;
+		};
+
+		struct Pool
+		{
+			const VertexFormat *format;
+			VkIndexType indexType;
+			std::vector<Block> blocks;
+		};
+
+	public:
+		GeometryArena();
+		~GeometryArena() = default;
+
+		void init(GraphicsCore *gfx);
+		void destroy();
+
+		// the data goes up through the uploader so it's ready for the next submission
+		GeometryAllocation allocate(const VertexFormat *format, const void *vertices, uint32_t vertexCount, const void *indices, uint32_t indexCount, VkIndexType indexType);
+
+		// the gpu must be done with it already
+		void free(const GeometryAllocation &allocation);
+
+		uint64_t getUsedMemory() const;
+		uint64_t getReservedMemory() const;
+
+		uint32_t getBlockCount() const;
+
+		static uint64_t getIndexSize(VkIndexType indexType);
+
+	private:
+		int getPool(const VertexFormat *format, VkIndexType indexType);
+		int createBlock(Pool &pool, uint64_t vertexCount, uint64_t indexCount);
+
+		GraphicsCore *m_gfx;
+
+		// there's only ever a handful of vertex formats and index types so a linear search is fine
+		std::vector<Pool> m_pools;
+	};
+}
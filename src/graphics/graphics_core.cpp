@@ -6,6 +6,10 @@
 
 #include "core/common.h"
 
+#include "io/file_stream.h"
+
+#include "math/timer.h"
+
 #include "vertex_format.h"
 #include "swapchain.h"
 #include "pipeline.h"
@@ -18,21 +22,28 @@
 #include "shader.h"
 #include "render_graph.h"
 #include "descriptor.h"
+#include "bitmap.h"
 
 using namespace mgp;
 
-static std::vector<const char *> getInstanceExtensions(const PlatformCore *platform)
+static std::vector<const char *> getInstanceExtensions(const PlatformCore *platform, bool headless)
 {
-	uint32_t extCount = 0;
-	const char *const *names = platform->vkGetInstanceExtensions(&extCount);
+	std::vector<const char *> extensions;
+
+	// no window means no surface extensions
+	if (!headless)
+	{
+		uint32_t extCount = 0;
+		const char *const *names = platform->vkGetInstanceExtensions(&extCount);
 
-	if (!names)
-		mgp_ERROR("Unable to get instance extension count.");
+		if (!names)
+			mgp_ERROR("Unable to get instance extension count.");
 
-	std::vector<const char *> extensions(extCount);
+		extensions.resize(extCount);
 
-	for (int i = 0; i < extCount; i++) {
-		extensions[i] = names[i];
+		for (int i = 0; i < extCount; i++) {
+			extensions[i] = names[i];
+		}
 	}
 
 #if MGP_DEBUG
@@ -42,7 +53,9 @@ static std::vector<const char *> getInstanceExtensions(const PlatformCore *platf
 
 #if MGP_MAC_SUPPORT
 	extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
-	extensions.push_back("VK_EXT_metal_surface");
+
+	if (!headless)
+		extensions.push_back("VK_EXT_metal_surface");
 #endif
 
 	extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
@@ -50,8 +63,28 @@ static std::vector<const char *> getInstanceExtensions(const PlatformCore *platf
 	return extensions;
 }
 
+static std::vector<const char *> getDeviceExtensions(bool headless)
+{
+	std::vector<const char *> extensions(
+		vk_toolbox::DEVICE_EXTENSIONS,
+		vk_toolbox::DEVICE_EXTENSIONS + mgp_ARRAY_LENGTH(vk_toolbox::DEVICE_EXTENSIONS)
+	);
+
+	if (!headless)
+	{
+		for (cauto &ext : vk_toolbox::PRESENT_DEVICE_EXTENSIONS)
+			extensions.push_back(ext);
+	}
+
+	return extensions;
+}
+
 GraphicsCore::GraphicsCore(const Config &config, PlatformCore *platform)
 	: m_platform(platform)
+	, m_headless(config.hasFlag(CONFIG_FLAG_HEADLESS_BIT))
+	, m_asyncCompute(false)
+	, m_dedicatedTransfer(false)
+	, m_meshShaders(false)
 	, m_instance()
 	, m_device()
 	, m_physicalDevice()
@@ -67,9 +100,17 @@ GraphicsCore::GraphicsCore(const Config &config, PlatformCore *platform)
 	, m_swapchain(nullptr)
 	, m_surface()
 	, m_graphicsQueue()
+	, m_computeQueue()
+	, m_transferQueue()
+	, m_uploader()
+	, m_geometryArena()
 	, m_slangGlobalSession()
 	, m_slangSession()
 	, m_inFlightCmd()
+	, m_frameWaits()
+	, m_frameWaitTime(0.0)
+	, m_readbackBuffer(nullptr)
+	, m_lastPresentedValue(0)
 #if MGP_DEBUG
 	, m_debugMessenger()
 #endif
@@ -99,7 +140,7 @@ GraphicsCore::GraphicsCore(const Config &config, PlatformCore *platform)
 
 	volkInitialize();
 
-	auto extensions = getInstanceExtensions(m_platform);
+	auto extensions = getInstanceExtensions(m_platform, m_headless);
 	createInfo.enabledExtensionCount = extensions.size();
 	createInfo.ppEnabledExtensionNames = extensions.data();
 	
@@ -128,7 +169,9 @@ GraphicsCore::GraphicsCore(const Config &config, PlatformCore *platform)
 	}
 #endif
 
-	m_surface.create(this, m_platform);
+	// in headless mode the surface handle just stays null
+	if (!m_headless)
+		m_surface.create(this, m_platform);
 
 	enumeratePhysicalDevices(m_surface.getHandle());
 
@@ -144,6 +187,9 @@ GraphicsCore::GraphicsCore(const Config &config, PlatformCore *platform)
 
 	createPipelineProcessCache();
 
+	m_uploader.init(this);
+	m_geometryArena.init(this);
+
 	initSlang();
 
 	m_swapchain = new Swapchain(this, m_platform);
@@ -156,15 +202,28 @@ GraphicsCore::~GraphicsCore()
 {
 	waitIdle();
 
+	delete m_readbackBuffer;
+
+	m_geometryArena.destroy();
+	m_uploader.destroy();
+
 	delete m_swapchain;
 	
 	delete m_imGuiDescriptorPool;
 
+	savePipelineProcessCache();
 	vkDestroyPipelineCache(m_device, m_pipelineProcessCache, nullptr);
 	
 	m_graphicsQueue.destroy();
+
+	if (m_asyncCompute)
+		m_computeQueue.destroy();
+
+	if (m_dedicatedTransfer)
+		m_transferQueue.destroy();
 	
-	m_surface.destroy();
+	if (!m_headless)
+		m_surface.destroy();
 	
 	vmaDestroyAllocator(m_vmaAllocator);
 	
@@ -177,8 +236,23 @@ CommandBuffer *GraphicsCore::beginPresent()
 {
 	auto &currentFrame = m_graphicsQueue.getFrame(m_currentFrameIndex);
 
-	waitForFence(currentFrame.inFlightFence);
-	resetFence(currentFrame.inFlightFence);
+	// block until the gpu has finished the last submission that used this frame's resources
+	// with FRAMES_IN_FLIGHT frames in the queue this is normally already done
+	Timer waitTimer(m_platform);
+	waitTimer.start();
+
+	m_graphicsQueue.waitForTimelineValue(currentFrame.timelineValue);
+
+	if (m_asyncCompute)
+		m_computeQueue.waitForTimelineValue(m_computeQueue.getFrame(m_currentFrameIndex).timelineValue);
+
+	m_frameWaitTime = waitTimer.getElapsedSeconds();
+
+	// now safe to recycle the command buffers
+	currentFrame.pool.reset();
+
+	if (m_asyncCompute)
+		m_computeQueue.getFrame(m_currentFrameIndex).pool.reset();
 
 	m_swapchain->acquireNextImage();
 
@@ -190,34 +264,15 @@ CommandBuffer *GraphicsCore::beginPresent()
 
 void GraphicsCore::present()
 {
-	m_inFlightCmd.transitionLayout(m_swapchain->getCurrentSwapchainImage(), VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-
-	m_inFlightCmd.end();
-
-	VkFence fence = m_graphicsQueue.getFrame(m_currentFrameIndex).inFlightFence;
-
-	VkSemaphoreSubmitInfo imageAvailableSemaphore = m_swapchain->getImageAvailableSemaphoreSubmitInfo();
-	VkSemaphoreSubmitInfo renderFinishedSemaphore = m_swapchain->getRenderFinishedSemaphoreSubmitInfo();
-
-	VkCommandBufferSubmitInfo bufferInfo = m_inFlightCmd.getSubmitInfo();
-
-	VkSubmitInfo2 submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-	submitInfo.flags = 0;
+	if (m_headless)
+	{
+		presentHeadless();
+		return;
+	}
 
-	submitInfo.commandBufferInfoCount = 1;
-	submitInfo.pCommandBufferInfos = &bufferInfo;
+	m_inFlightCmd.transitionLayout(m_swapchain->getCurrentSwapchainImage(), VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
-	submitInfo.signalSemaphoreInfoCount = 1;
-	submitInfo.pSignalSemaphoreInfos = &renderFinishedSemaphore;
-
-	submitInfo.waitSemaphoreInfoCount = 1;
-	submitInfo.pWaitSemaphoreInfos = &imageAvailableSemaphore;
-	
-	mgp_VK_CHECK(
-		vkQueueSubmit2(m_graphicsQueue.getHandle(), 1, &submitInfo, fence),
-		"Failed to submit in-flight draw command to buffer"
-	);
+	submitFrame(true);
 
 	VkSemaphoreSubmitInfo waitSemaphoreSubmitInfo = m_swapchain->getRenderFinishedSemaphoreSubmitInfo();
 	unsigned imageIndex = m_swapchain->getCurrentSwapchainImageIndex();
@@ -245,18 +300,211 @@ void GraphicsCore::present()
 		mgp_ERROR("Failed to present swap chain image: %d", result);
 	}
 
+	// move onto the next frame, we only wait for it in beginPresent once we actually need its resources again
 	m_currentFrameIndex = (m_currentFrameIndex + 1) % gfx_constants::FRAMES_IN_FLIGHT;
+}
+
+void GraphicsCore::presentHeadless()
+{
+	Image *target = m_swapchain->getCurrentSwapchainImage();
+
+	if (m_readbackBuffer)
+	{
+		m_inFlightCmd.transitionLayout(target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		m_inFlightCmd.copyImageToBuffer(target, m_readbackBuffer);
+	}
 
-	vkQueueWaitIdle(m_graphicsQueue.getHandle());
-	m_graphicsQueue.getFrame(m_currentFrameIndex).pool.reset();
+	// nothing to wait on, the offscreen image is free as soon as the frame slot is
+	m_lastPresentedValue = submitFrame(false);
+
+	m_currentFrameIndex = (m_currentFrameIndex + 1) % gfx_constants::FRAMES_IN_FLIGHT;
 }
 
-CommandBuffer *GraphicsCore::beginInstantSubmit()
+uint64_t GraphicsCore::submitFrame(bool present)
 {
+	m_frameWaits.push_back(flushUploads());
+
+	m_inFlightCmd.end();
+
 	auto &currentFrame = m_graphicsQueue.getFrame(m_currentFrameIndex);
+	currentFrame.timelineValue = m_graphicsQueue.nextTimelineValue();
+
+	VkSemaphoreSubmitInfo timelineSemaphore = {};
+	timelineSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	timelineSemaphore.semaphore = m_graphicsQueue.getTimelineSemaphore();
+	timelineSemaphore.value = currentFrame.timelineValue;
+	timelineSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	timelineSemaphore.deviceIndex = 0;
+
+	VkSemaphoreSubmitInfo signalSemaphores[] = { timelineSemaphore, {} };
+	uint32_t signalCount = 1;
+
+	// only the submission that actually draws to the swapchain image waits for it
+	if (present)
+	{
+		m_frameWaits.push_back(m_swapchain->getImageAvailableSemaphoreSubmitInfo());
+		signalSemaphores[signalCount++] = m_swapchain->getRenderFinishedSemaphoreSubmitInfo();
+	}
+
+	VkCommandBufferSubmitInfo bufferInfo = m_inFlightCmd.getSubmitInfo();
+
+	VkSubmitInfo2 submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.flags = 0;
+
+	submitInfo.commandBufferInfoCount = 1;
+	submitInfo.pCommandBufferInfos = &bufferInfo;
+
+	submitInfo.signalSemaphoreInfoCount = signalCount;
+	submitInfo.pSignalSemaphoreInfos = signalSemaphores;
+
+	submitInfo.waitSemaphoreInfoCount = m_frameWaits.size();
+	submitInfo.pWaitSemaphoreInfos = m_frameWaits.data();
+
+	mgp_VK_CHECK(
+		vkQueueSubmit2(m_graphicsQueue.getHandle(), 1, &submitInfo, VK_NULL_HANDLE),
+		"Failed to submit in-flight draw command to buffer"
+	);
+
+	m_frameWaits.clear();
+
+	return currentFrame.timelineValue;
+}
+
+uint64_t GraphicsCore::flushFrame()
+{
+	uint64_t value = submitFrame(false);
+
+	auto &currentFrame = m_graphicsQueue.getFrame(m_currentFrameIndex);
+
+	m_inFlightCmd = CommandBuffer(currentFrame.pool.getFreeBuffer());
+	m_inFlightCmd.begin();
+
+	return value;
+}
+
+CommandBuffer *GraphicsCore::beginAsyncCompute()
+{
+	mgp_ASSERT(m_asyncCompute, "Device doesn't have a dedicated compute queue.");
+
+	auto &computeFrame = m_computeQueue.getFrame(m_currentFrameIndex);
+
+	CommandBuffer *cmd = new CommandBuffer(computeFrame.pool.getFreeBuffer());
+	cmd->begin();
+
+	return cmd;
+}
+
+uint64_t GraphicsCore::submitAsyncCompute(CommandBuffer *cmd)
+{
+	cmd->end();
 
-	waitForFence(currentFrame.instantSubmitFence);
-	resetFence(currentFrame.instantSubmitFence);
+	VkCommandBufferSubmitInfo bufferInfo = cmd->getSubmitInfo();
+
+	delete cmd;
+
+	auto &computeFrame = m_computeQueue.getFrame(m_currentFrameIndex);
+	computeFrame.timelineValue = m_computeQueue.nextTimelineValue();
+
+	VkSemaphoreSubmitInfo waitSemaphore = {};
+	waitSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	waitSemaphore.semaphore = m_graphicsQueue.getTimelineSemaphore();
+	waitSemaphore.value = m_graphicsQueue.getLatestTimelineValue();
+	waitSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	waitSemaphore.deviceIndex = 0;
+
+	VkSemaphoreSubmitInfo signalSemaphore = {};
+	signalSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	signalSemaphore.semaphore = m_computeQueue.getTimelineSemaphore();
+	signalSemaphore.value = computeFrame.timelineValue;
+	signalSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	signalSemaphore.deviceIndex = 0;
+
+	VkSubmitInfo2 submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.flags = 0;
+
+	submitInfo.commandBufferInfoCount = 1;
+	submitInfo.pCommandBufferInfos = &bufferInfo;
+
+	submitInfo.signalSemaphoreInfoCount = 1;
+	submitInfo.pSignalSemaphoreInfos = &signalSemaphore;
+
+	submitInfo.waitSemaphoreInfoCount = 1;
+	submitInfo.pWaitSemaphoreInfos = &waitSemaphore;
+
+	mgp_VK_CHECK(
+		vkQueueSubmit2(m_computeQueue.getHandle(), 1, &submitInfo, VK_NULL_HANDLE),
+		"Failed to submit async compute command buffer"
+	);
+
+	return computeFrame.timelineValue;
+}
+
+void GraphicsCore::waitForAsyncCompute(uint64_t value)
+{
+	VkSemaphoreSubmitInfo waitSemaphore = {};
+	waitSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	waitSemaphore.semaphore = m_computeQueue.getTimelineSemaphore();
+	waitSemaphore.value = value;
+	waitSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	waitSemaphore.deviceIndex = 0;
+
+	m_frameWaits.push_back(waitSemaphore);
+}
+
+VkSemaphoreSubmitInfo GraphicsCore::flushUploads()
+{
+	// anything loaded since the last submission goes out in one batch, and whatever gets submitted next waits on it
+	uint64_t value = m_uploader.flush();
+
+	VkSemaphoreSubmitInfo waitSemaphore = {};
+	waitSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	waitSemaphore.semaphore = m_graphicsQueue.getTimelineSemaphore();
+	waitSemaphore.value = value;
+	waitSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	waitSemaphore.deviceIndex = 0;
+
+	return waitSemaphore;
+}
+
+void GraphicsCore::setFrameReadback(bool enabled)
+{
+	mgp_ASSERT(m_headless, "Frame readback is only supported in headless mode.");
+
+	waitIdle();
+
+	delete m_readbackBuffer;
+	m_readbackBuffer = nullptr;
+
+	if (enabled)
+	{
+		m_readbackBuffer = createGPUBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+			m_swapchain->getWidth() * m_swapchain->getHeight() * 4
+		);
+	}
+}
+
+void GraphicsCore::readbackFrame(Bitmap *bitmap)
+{
+	mgp_ASSERT(m_readbackBuffer, "Frame readback must be enabled first.");
+
+	// serialises the cpu and gpu, fine for captures but don't use it when benchmarking
+	m_graphicsQueue.waitForTimelineValue(m_lastPresentedValue);
+
+	mgp_ASSERT(
+		bitmap->getWidth() == m_swapchain->getWidth() && bitmap->getHeight() == m_swapchain->getHeight(),
+		"Bitmap must match the size of the offscreen target."
+	);
+
+	m_readbackBuffer->read(bitmap->getData(), m_readbackBuffer->getSize(), 0);
+}
+
+CommandBuffer *GraphicsCore::beginInstantSubmit()
+{
+	auto &currentFrame = m_graphicsQueue.getFrame(m_currentFrameIndex);
 
 	CommandBuffer *cmd = new CommandBuffer(currentFrame.pool.getFreeBuffer());
 	cmd->begin();
@@ -272,7 +520,18 @@ void GraphicsCore::submit(CommandBuffer *cmd)
 
 	delete cmd;
 
-	VkFence fence = m_graphicsQueue.getFrame(m_currentFrameIndex).instantSubmitFence;
+	VkSemaphoreSubmitInfo uploadSemaphore = flushUploads();
+
+	// the command buffer came from this frame's pool so the frame can't be recycled until it's done
+	auto &currentFrame = m_graphicsQueue.getFrame(m_currentFrameIndex);
+	currentFrame.timelineValue = m_graphicsQueue.nextTimelineValue();
+
+	VkSemaphoreSubmitInfo timelineSemaphore = {};
+	timelineSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	timelineSemaphore.semaphore = m_graphicsQueue.getTimelineSemaphore();
+	timelineSemaphore.value = currentFrame.timelineValue;
+	timelineSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	timelineSemaphore.deviceIndex = 0;
 
 	VkSubmitInfo2 submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
@@ -281,11 +540,14 @@ void GraphicsCore::submit(CommandBuffer *cmd)
 	submitInfo.commandBufferInfoCount = 1;
 	submitInfo.pCommandBufferInfos = &bufferInfo;
 
-	submitInfo.signalSemaphoreInfoCount = 0;
-	submitInfo.waitSemaphoreInfoCount = 0;
+	submitInfo.signalSemaphoreInfoCount = 1;
+	submitInfo.pSignalSemaphoreInfos = &timelineSemaphore;
+
+	submitInfo.waitSemaphoreInfoCount = 1;
+	submitInfo.pWaitSemaphoreInfos = &uploadSemaphore;
 
 	mgp_VK_CHECK(
-		vkQueueSubmit2(m_graphicsQueue.getHandle(), 1, &submitInfo, fence),
+		vkQueueSubmit2(m_graphicsQueue.getHandle(), 1, &submitInfo, VK_NULL_HANDLE),
 		"Failed to submit instant draw command to buffer"
 	);
 }
@@ -313,9 +575,11 @@ void GraphicsCore::enumeratePhysicalDevices(VkSurfaceKHR surface)
 	m_physicalDeviceProperties = properties;
 	m_physicalDeviceFeatures = features;
 
+	auto extensions = getDeviceExtensions(m_headless);
+
 	// try to rank our physical devices and select one accordingly
 	bool hasEssentials = false;
-	uint32_t usability0 = vk_toolbox::assignPhysicalDeviceUsability(surface, m_physicalDevice, properties, features, &hasEssentials);
+	uint32_t usability0 = vk_toolbox::assignPhysicalDeviceUsability(surface, m_physicalDevice, properties, features, extensions, &hasEssentials);
 
 	// select the device of the highest usability
 	int iSelected = 0;
@@ -324,7 +588,7 @@ void GraphicsCore::enumeratePhysicalDevices(VkSurfaceKHR surface)
 		vkGetPhysicalDeviceProperties2(devices[i], &m_physicalDeviceProperties);
 		vkGetPhysicalDeviceFeatures2(devices[i], &m_physicalDeviceFeatures);
 
-		uint32_t usability1 = vk_toolbox::assignPhysicalDeviceUsability(surface, devices[i], properties, features, &hasEssentials);
+		uint32_t usability1 = vk_toolbox::assignPhysicalDeviceUsability(surface, devices[i], properties, features, extensions, &hasEssentials);
 
 		if (usability1 > usability0 && hasEssentials)
 		{
@@ -355,8 +619,18 @@ void GraphicsCore::createLogicalDevice()
 
 	queueCreateInfos.push_back(m_graphicsQueue.getCreateInfo(QUEUE_PRIORITIES));
 
+	if (m_asyncCompute)
+		queueCreateInfos.push_back(m_computeQueue.getCreateInfo(QUEUE_PRIORITIES));
+
+	if (m_dedicatedTransfer)
+		queueCreateInfos.push_back(m_transferQueue.getCreateInfo(QUEUE_PRIORITIES));
+
 	m_physicalDeviceFeatures.features.robustBufferAccess = VK_FALSE;
 
+	// storage images get used with formats other than rgba32f, e.g. the compact g-buffer's lighting target
+	m_physicalDeviceFeatures.features.shaderStorageImageReadWithoutFormat = VK_TRUE;
+	m_physicalDeviceFeatures.features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+
 	VkPhysicalDeviceVulkan11Features vulkan11Features = {};
 	vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
 	vulkan11Features.shaderDrawParameters = VK_TRUE;
@@ -372,7 +646,10 @@ void GraphicsCore::createLogicalDevice()
 	vulkan12Features.descriptorBindingUniformBufferUpdateAfterBind = VK_TRUE;
 	vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
 	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
 	vulkan12Features.bufferDeviceAddress = VK_TRUE;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+	vulkan12Features.drawIndirectCount = VK_TRUE;
 	vulkan12Features.pNext = &vulkan11Features;
 
 	VkPhysicalDeviceVulkan13Features vulkan13Features = {};
@@ -381,16 +658,42 @@ void GraphicsCore::createLogicalDevice()
 	vulkan13Features.synchronization2 = VK_TRUE;
 	vulkan13Features.pNext = &vulkan12Features;
 
+	// optional, meshlet culling falls back to compute and indirect draws without it
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderSupport = {};
+	meshShaderSupport.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+	if (vk_toolbox::checkDeviceExtensionSupport(m_physicalDevice, { VK_EXT_MESH_SHADER_EXTENSION_NAME }))
+	{
+		VkPhysicalDeviceFeatures2 supportedFeatures = {};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &meshShaderSupport;
+
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+	}
+
+	m_meshShaders = meshShaderSupport.taskShader && meshShaderSupport.meshShader;
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	meshShaderFeatures.taskShader = VK_TRUE;
+	meshShaderFeatures.meshShader = VK_TRUE;
+	meshShaderFeatures.pNext = &vulkan13Features;
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = queueCreateInfos.size();
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.enabledLayerCount = 0;
 	createInfo.ppEnabledLayerNames = nullptr;
-	createInfo.enabledExtensionCount = mgp_ARRAY_LENGTH(vk_toolbox::DEVICE_EXTENSIONS);
-	createInfo.ppEnabledExtensionNames = vk_toolbox::DEVICE_EXTENSIONS;
+	auto extensions = getDeviceExtensions(m_headless);
+
+	if (m_meshShaders)
+		extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+
+	createInfo.enabledExtensionCount = extensions.size();
+	createInfo.ppEnabledExtensionNames = extensions.data();
 	createInfo.pEnabledFeatures = &m_physicalDeviceFeatures.features;
-	createInfo.pNext = &vulkan13Features;
+	createInfo.pNext = m_meshShaders ? (void *)&meshShaderFeatures : (void *)&vulkan13Features;
 
 #if MGP_DEBUG
 	// enable the validation layers on the device
@@ -412,6 +715,12 @@ void GraphicsCore::createLogicalDevice()
 	// create queues
 	m_graphicsQueue.create(this, 0);
 
+	if (m_asyncCompute)
+		m_computeQueue.create(this, 0);
+
+	if (m_dedicatedTransfer)
+		m_transferQueue.create(this, 0);
+
 	// print out current device version
 	uint32_t version = 0;
 	VkResult result = vkEnumerateInstanceVersion(&version);
@@ -431,14 +740,61 @@ void GraphicsCore::createLogicalDevice()
 	mgp_LOG("Created logical device!");
 }
 
+// written in front of the driver's blob so we never hand it data from a different device or driver
+struct PipelineCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t dataSize;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static constexpr uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x4350474D; // "MGPC"
+
 void GraphicsCore::createPipelineProcessCache()
 {
+	std::vector<byte> initialData;
+
+	cauto &deviceProperties = m_physicalDeviceProperties.properties;
+
+	FileStream fs(m_platform, gfx_constants::PIPELINE_CACHE_PATH, "rb");
+
+	if (fs.getStream() && fs.getSize() >= (int64_t)sizeof(PipelineCacheFileHeader))
+	{
+		PipelineCacheFileHeader header = {};
+		fs.read(&header, sizeof(PipelineCacheFileHeader));
+
+		bool valid =
+			header.magic == PIPELINE_CACHE_FILE_MAGIC &&
+			header.vendorID == deviceProperties.vendorID &&
+			header.deviceID == deviceProperties.deviceID &&
+			header.driverVersion == deviceProperties.driverVersion &&
+			mem::compare(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+			header.dataSize == fs.getSize() - sizeof(PipelineCacheFileHeader);
+
+		if (valid)
+		{
+			initialData.resize(header.dataSize);
+			fs.read(initialData.data(), header.dataSize);
+
+			mgp_LOG("Loaded pipeline cache from disk (%u bytes).", header.dataSize);
+		}
+		else
+		{
+			mgp_LOG("Pipeline cache on disk is from a different device or driver, ignoring it.");
+		}
+	}
+
+	fs.close();
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 	pipelineCacheCreateInfo.pNext = nullptr;
 	pipelineCacheCreateInfo.flags = 0;
-	pipelineCacheCreateInfo.initialDataSize = 0;
-	pipelineCacheCreateInfo.pInitialData = nullptr;
+	pipelineCacheCreateInfo.initialDataSize = initialData.size();
+	pipelineCacheCreateInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
 
 	mgp_VK_CHECK(
 		vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, nullptr, &m_pipelineProcessCache),
@@ -448,6 +804,46 @@ void GraphicsCore::createPipelineProcessCache()
 	mgp_LOG("Created graphics pipeline process cache!");
 }
 
+void GraphicsCore::savePipelineProcessCache()
+{
+	size_t dataSize = 0;
+	vkGetPipelineCacheData(m_device, m_pipelineProcessCache, &dataSize, nullptr);
+
+	if (!dataSize)
+		return;
+
+	std::vector<byte> data(dataSize);
+
+	if (vkGetPipelineCacheData(m_device, m_pipelineProcessCache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		mgp_LOG("Failed to get pipeline cache data, not saving it.");
+		return;
+	}
+
+	cauto &deviceProperties = m_physicalDeviceProperties.properties;
+
+	PipelineCacheFileHeader header = {};
+	header.magic = PIPELINE_CACHE_FILE_MAGIC;
+	header.dataSize = (uint32_t)dataSize;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	mem::copy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	FileStream fs(m_platform, gfx_constants::PIPELINE_CACHE_PATH, "wb");
+
+	if (!fs.getStream())
+	{
+		mgp_LOG("Failed to open pipeline cache file for writing.");
+		return;
+	}
+
+	fs.write(&header, sizeof(PipelineCacheFileHeader));
+	fs.write(data.data(), dataSize);
+
+	mgp_LOG("Saved pipeline cache to disk (%llu bytes).", (unsigned long long)dataSize);
+}
+
 void GraphicsCore::findQueueFamilies()
 {
 	uint32_t queueFamilyCount = 0;
@@ -463,8 +859,10 @@ void GraphicsCore::findQueueFamilies()
 	{
 		if ((queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
 		{
-			VkBool32 presentSupport = VK_FALSE;
-			vkGetPhysicalDeviceSurfaceSupportKHR(m_physicalDevice, i, m_surface.getHandle(), &presentSupport);
+			VkBool32 presentSupport = VK_TRUE;
+
+			if (!m_headless)
+				vkGetPhysicalDeviceSurfaceSupportKHR(m_physicalDevice, i, m_surface.getHandle(), &presentSupport);
 
 			if (presentSupport)
 				m_graphicsQueue.setFamilyIndex(i);
@@ -472,6 +870,42 @@ void GraphicsCore::findQueueFamilies()
 			continue;
 		}
 	}
+
+	// a family that can do compute but not graphics usually maps to separate hardware queues that run alongside the graphics one
+	for (int i = 0; i < queueFamilyCount; i++)
+	{
+		if ((queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			m_computeQueue.setFamilyIndex(i);
+			m_asyncCompute = true;
+
+			break;
+		}
+	}
+
+	if (m_asyncCompute)
+		mgp_LOG("Found async compute queue family: %d", m_computeQueue.getFamilyIndex());
+	else
+		mgp_LOG("No async compute queue family, compute work will run on the graphics queue.");
+
+	// transfer-only families are the dma engines, copies on them don't take any time away from rendering
+	for (int i = 0; i < queueFamilyCount; i++)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT))
+		{
+			m_transferQueue.setFamilyIndex(i);
+			m_dedicatedTransfer = true;
+
+			break;
+		}
+	}
+
+	if (m_dedicatedTransfer)
+		mgp_LOG("Found dedicated transfer queue family: %d", m_transferQueue.getFamilyIndex());
+	else
+		mgp_LOG("No dedicated transfer queue family, uploads will go through the graphics queue.");
 }
 
 void GraphicsCore::createVmaAllocator()
@@ -603,16 +1037,6 @@ void GraphicsCore::waitIdle()
 	vkDeviceWaitIdle(m_device);
 }
 
-void GraphicsCore::waitForFence(const VkFence &fence) const
-{
-	vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
-}
-
-void GraphicsCore::resetFence(const VkFence &fence) const
-{
-	vkResetFences(m_device, 1, &fence);
-}
-
 VkFormat GraphicsCore::getDepthFormat()
 {
 	return m_depthFormat;
@@ -655,10 +1079,11 @@ ImageView *GraphicsCore::createImageView(
 	Image *image,
 	int layerCount,
 	int layer,
-	int baseMipLevel
+	int baseMipLevel,
+	int mipCount
 )
 {
-	return new ImageView(this, (Image *)image, layerCount, layer, baseMipLevel);
+	return new ImageView(this, (Image *)image, layerCount, layer, baseMipLevel, mipCount);
 }
 
 Sampler *GraphicsCore::createSampler(const SamplerStyle &style)
@@ -750,7 +1175,7 @@ DescriptorPool *GraphicsCore::createDescriptorPool(uint32_t initialSets, VkDescr
 
 VkPipelineLayout GraphicsCore::createPipelineLayout(const Shader *shader)
 {
-	VkShaderStageFlags shaderStage = shader->getStages()[0]->getType() == VK_SHADER_STAGE_COMPUTE_BIT ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_ALL_GRAPHICS;
+	VkShaderStageFlags shaderStage = shader->getPushConstantStages();
 
 	auto &layouts = shader->getLayouts();
 
@@ -866,9 +1291,9 @@ VkPipeline GraphicsCore::createGraphicsPipeline(VkPipelineLayout layout, const G
 	multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
 	multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE;
 
-	std::vector<VkPipelineColorBlendAttachmentState> blendStates(renderInfo.getColourAttachments().size());
+	std::vector<VkPipelineColorBlendAttachmentState> blendStates(renderInfo.getColourAttachmentFormats().size());
 
-	for (int i = 0; i < renderInfo.getColourAttachments().size(); i++) {
+	for (int i = 0; i < renderInfo.getColourAttachmentFormats().size(); i++) {
 		blendStates[i] = definition.getColourBlendState();
 	}
 
@@ -946,7 +1371,7 @@ VkPipeline GraphicsCore::createComputePipeline(VkPipelineLayout layout, const Co
 	VkPipeline pipeline = VK_NULL_HANDLE;
 
 	mgp_VK_CHECK(
-		vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &pipeline),
+		vkCreateComputePipelines(m_device, m_pipelineProcessCache, 1, &computePipelineCreateInfo, nullptr, &pipeline),
 		"Failed to create new compute pipeline"
 	);
 
@@ -20,6 +20,8 @@
 #include "sampler.h"
 #include "descriptor.h"
 #include "pipeline.h"
+#include "uploader.h"
+#include "geometry_arena.h"
 
 namespace mgp
 {
@@ -28,6 +30,7 @@ namespace mgp
 	class Shader;
 	class ShaderStage;
 	class PlatformCore;
+	class Bitmap;
 
 	class GraphicsCore
 	{
@@ -38,9 +41,26 @@ namespace mgp
 		CommandBuffer *beginPresent();
 		void present();
 
+		// headless only, copies each presented frame into a host-visible buffer
+		void setFrameReadback(bool enabled);
+		void readbackFrame(Bitmap *bitmap);
+
 		CommandBuffer *beginInstantSubmit();
 		void submit(CommandBuffer *cmd);
 
+		// async compute, only valid while a frame is being recorded
+		// the compute queue waits on everything already submitted on the graphics queue this frame
+		CommandBuffer *beginAsyncCompute();
+		uint64_t submitAsyncCompute(CommandBuffer *cmd);
+
+		// the next graphics submission of the frame waits until the compute queue reaches value
+		void waitForAsyncCompute(uint64_t value);
+
+		// submits what's been recorded into the frame's command buffer so far and carries on in a fresh one
+		uint64_t flushFrame();
+
+		bool isFrameCommandBuffer(const CommandBuffer *cmd) const { return cmd == &m_inFlightCmd; }
+
 		void waitIdle();
 		
 		VkFormat getDepthFormat();
@@ -64,7 +84,8 @@ namespace mgp
 			Image *image,
 			int layerCount,
 			int layer,
-			int baseMipLevel
+			int baseMipLevel,
+			int mipCount = 0
 		);
 		
 		Sampler *createSampler(const SamplerStyle &style);
@@ -101,11 +122,21 @@ namespace mgp
 		VkPipeline createComputePipeline(VkPipelineLayout layout, const ComputePipelineDef &definition);
 
 	public:
-		void waitForFence(const VkFence &fence) const;
-		void resetFence(const VkFence &fence) const;
+		bool isHeadless() const { return m_headless; }
+
+		// true if the device has a compute-only queue family we can run work on alongside graphics
+		bool hasAsyncCompute() const { return m_asyncCompute; }
+
+		// VK_EXT_mesh_shader with both task and mesh stages, only then are those stages ever loaded
+		bool hasMeshShaders() const { return m_meshShaders; }
+
+		PlatformCore *getPlatform() const { return m_platform; }
 
 		int getCurrentFrameIndex() const { return m_currentFrameIndex; }
 
+		// seconds the cpu spent blocked waiting on the gpu at the start of the last frame
+		double getFrameWaitTime() const { return m_frameWaitTime; }
+
 		const VkInstance &getInstance() const { return m_instance; }
 		const VkDevice &getLogicalDevice() const { return m_device; }
 
@@ -124,6 +155,17 @@ namespace mgp
 
 		Queue& getGraphicsQueue() { return m_graphicsQueue; }
 		const Queue& getGraphicsQueue() const { return m_graphicsQueue; }
+
+		Queue& getComputeQueue() { return m_computeQueue; }
+		const Queue& getComputeQueue() const { return m_computeQueue; }
+
+		// falls back to the graphics queue if there's no dedicated transfer family
+		Queue& getTransferQueue() { return m_dedicatedTransfer ? m_transferQueue : m_graphicsQueue; }
+		const Queue& getTransferQueue() const { return m_dedicatedTransfer ? m_transferQueue : m_graphicsQueue; }
+
+		Uploader &getUploader() { return m_uploader; }
+
+		GeometryArena &getGeometryArena() { return m_geometryArena; }
 		
 		const Slang::ComPtr<slang::ISession> &getSlangSession() const { return m_slangSession; }
 
@@ -131,12 +173,24 @@ namespace mgp
 		void enumeratePhysicalDevices(VkSurfaceKHR surface);
 		void createLogicalDevice();
 		void createPipelineProcessCache();
+		void savePipelineProcessCache();
 		void createVmaAllocator();
 		void findQueueFamilies();
 		void initSlang();
 
+		void presentHeadless();
+
+		uint64_t submitFrame(bool present);
+
+		VkSemaphoreSubmitInfo flushUploads();
+
 		PlatformCore *m_platform;
 
+		bool m_headless;
+		bool m_asyncCompute;
+		bool m_dedicatedTransfer;
+		bool m_meshShaders;
+
 		VkInstance m_instance;
 		VkDevice m_device;
 
@@ -160,12 +214,25 @@ namespace mgp
 		Swapchain *m_swapchain;
 		Surface m_surface;
 		Queue m_graphicsQueue;
+		Queue m_computeQueue;
+		Queue m_transferQueue;
+
+		Uploader m_uploader;
+		GeometryArena m_geometryArena;
 
 		Slang::ComPtr<slang::IGlobalSession> m_slangGlobalSession;
 		Slang::ComPtr<slang::ISession> m_slangSession;
 
 		CommandBuffer m_inFlightCmd;
 
+		// semaphores the next submission of the frame has to wait on
+		std::vector<VkSemaphoreSubmitInfo> m_frameWaits;
+
+		double m_frameWaitTime;
+
+		GPUBuffer *m_readbackBuffer;
+		uint64_t m_lastPresentedValue;
+
 #if MGP_DEBUG
 		VkDebugUtilsMessengerEXT m_debugMessenger;
 #endif
@@ -22,6 +22,14 @@ Image::~Image()
 		m_image = VK_NULL_HANDLE;
 		m_isAllocated = false;
 	}
+	else if (m_isAliased)
+	{
+		// the memory belongs to whoever bound it
+		vkDestroyImage(m_gfx->getLogicalDevice(), m_image, nullptr);
+
+		m_image = VK_NULL_HANDLE;
+		m_isAliased = false;
+	}
 }
 
 void Image::allocate(
@@ -35,6 +43,126 @@ void Image::allocate(
 	bool transient,
 	bool storage
 )
+{
+	VkImageCreateInfo createInfo = buildCreateInfo(
+		gfx,
+		width, height, depth,
+		format,
+		type,
+		tiling,
+		mipmaps,
+		samples,
+		transient,
+		storage
+	);
+
+	VmaAllocationCreateInfo vmaAllocInfo = {};
+	vmaAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+	vmaAllocInfo.priority = 1.0f;
+
+	mgp_VK_CHECK(
+		vmaCreateImage(m_gfx->getVMAAllocator(), &createInfo, &vmaAllocInfo, &m_image, &m_allocation, &m_allocationInfo),
+		"Failed to create image"
+	);
+
+	m_isAllocated = true;
+	m_isBound = true;
+	m_generation = 0;
+}
+
+void Image::createAliased(
+	GraphicsCore *gfx,
+	unsigned width, unsigned height, unsigned depth,
+	VkFormat format,
+	VkImageViewType type,
+	VkImageTiling tiling,
+	uint32_t mipmaps,
+	VkSampleCountFlagBits samples,
+	bool storage
+)
+{
+	VkImageCreateInfo createInfo = buildCreateInfo(
+		gfx,
+		width, height, depth,
+		format,
+		type,
+		tiling,
+		mipmaps,
+		samples,
+		false,
+		storage
+	);
+
+	// other images may share the same memory, so don't let the driver assume the contents survive
+	createInfo.flags |= VK_IMAGE_CREATE_ALIAS_BIT;
+
+	mgp_VK_CHECK(
+		vkCreateImage(m_gfx->getLogicalDevice(), &createInfo, nullptr, &m_image),
+		"Failed to create aliased image"
+	);
+
+	m_allocation = nullptr;
+
+	m_isAliased = true;
+	m_isBound = false;
+	m_generation = 0;
+}
+
+void Image::resetAliased()
+{
+	mgp_ASSERT(m_isAliased, "Only aliased images can be moved to new memory.");
+
+	uint32_t generation = m_generation;
+
+	vkDestroyImage(m_gfx->getLogicalDevice(), m_image, nullptr);
+
+	createAliased(
+		m_gfx,
+		m_width, m_height, m_depth,
+		m_format,
+		m_type,
+		m_tiling,
+		m_mipmapCount,
+		m_samples,
+		isStorage()
+	);
+
+	// views made of the old handle rebuild themselves the next time they're used
+	m_generation = generation + 1;
+}
+
+void Image::bindMemory(VmaAllocation allocation, VkDeviceSize offset)
+{
+	mgp_ASSERT(m_isAliased && !m_isBound, "Only aliased images can be bound to external memory, and only once.");
+
+	mgp_VK_CHECK(
+		vmaBindImageMemory2(m_gfx->getVMAAllocator(), allocation, offset, m_image, nullptr),
+		"Failed to bind aliased image memory"
+	);
+
+	m_isBound = true;
+}
+
+VkMemoryRequirements Image::getMemoryRequirements() const
+{
+	VkMemoryRequirements requirements = {};
+	vkGetImageMemoryRequirements(m_gfx->getLogicalDevice(), m_image, &requirements);
+
+	return requirements;
+}
+
+VkImageCreateInfo Image::buildCreateInfo(
+	GraphicsCore *gfx,
+	unsigned width, unsigned height, unsigned depth,
+	VkFormat format,
+	VkImageViewType type,
+	VkImageTiling tiling,
+	uint32_t mipmaps,
+	VkSampleCountFlagBits samples,
+	bool transient,
+	bool storage
+)
 {
 	m_gfx = gfx;
 
@@ -108,6 +236,8 @@ void Image::allocate(
 	createInfo.format = m_format;
 	createInfo.tiling = m_tiling;
 	createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	m_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 	createInfo.usage = m_usage;
 	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	createInfo.samples = m_samples;
@@ -118,17 +248,7 @@ void Image::allocate(
 		createInfo.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 	}
 
-	VmaAllocationCreateInfo vmaAllocInfo = {};
-	vmaAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-	vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-	vmaAllocInfo.priority = 1.0f;
-
-	mgp_VK_CHECK(
-		vmaCreateImage(m_gfx->getVMAAllocator(), &createInfo, &vmaAllocInfo, &m_image, &m_allocation, &m_allocationInfo),
-		"Failed to create image"
-	);
-
-	m_isAllocated = true;
+	return createInfo;
 }
 
 void Image::wrapAround(
@@ -164,6 +284,9 @@ void Image::wrapAround(
 	m_usage = usage;
 
 	m_isAllocated = false;
+	m_isAliased = false;
+	m_isBound = true;
+	m_generation = 0;
 }
 
 VkImageMemoryBarrier2 Image::getBarrier(VkImageLayout newLayout) const
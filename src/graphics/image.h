@@ -11,6 +11,7 @@ namespace mgp
 	class Image
 	{
 		friend class CommandBuffer;
+		friend class RenderGraph;
 
 	public:
 		Image() = default;
@@ -28,6 +29,25 @@ namespace mgp
 			bool storage
 		);
 
+		// creates the image without any memory, bindMemory() has to be called before it can be used
+		void createAliased(
+			GraphicsCore *gfx,
+			unsigned width, unsigned height, unsigned depth,
+			VkFormat format,
+			VkImageViewType type,
+			VkImageTiling tiling,
+			uint32_t mipmaps,
+			VkSampleCountFlagBits samples,
+			bool storage
+		);
+
+		void bindMemory(VmaAllocation allocation, VkDeviceSize offset);
+
+		// memory can't be rebound, so this swaps in a fresh unbound handle with the same properties
+		void resetAliased();
+
+		VkMemoryRequirements getMemoryRequirements() const;
+
 		void wrapAround(
 			GraphicsCore *gfx,
 			VkImage image,
@@ -55,6 +75,12 @@ namespace mgp
 		bool isTransient() const;
 		bool isStorage() const;
 
+		bool isAliased() const { return m_isAliased; }
+		bool isBound() const { return m_isBound; }
+
+		// bumped whenever resetAliased() replaces the handle
+		uint32_t getGeneration() const { return m_generation; }
+
 		bool isCubemap() const;
 		bool isDepth() const;
 
@@ -69,6 +95,18 @@ namespace mgp
 		VkImageUsageFlags getUsage() const;
 
 	private:
+		VkImageCreateInfo buildCreateInfo(
+			GraphicsCore *gfx,
+			unsigned width, unsigned height, unsigned depth,
+			VkFormat format,
+			VkImageViewType type,
+			VkImageTiling tiling,
+			uint32_t mipmaps,
+			VkSampleCountFlagBits samples,
+			bool transient,
+			bool storage
+		);
+
 		GraphicsCore *m_gfx;
 
 		VkImage m_image;
@@ -77,6 +115,9 @@ namespace mgp
 		VmaAllocation m_allocation;
 		VmaAllocationInfo m_allocationInfo;
 		bool m_isAllocated;
+		bool m_isAliased;
+		bool m_isBound;
+		uint32_t m_generation;
 
 		unsigned m_width;
 		unsigned m_height;
@@ -12,15 +12,34 @@ ImageView::ImageView(
 	Image *image,
 	int layerCount,
 	int layer,
-	int baseMipLevel
+	int baseMipLevel,
+	int mipCount
 )
 	: m_gfx(gfx)
 	, m_view(VK_NULL_HANDLE)
+	, m_generation(0)
 	, m_image(image)
+	, m_layerCount(layerCount)
+	, m_layer(layer)
+	, m_baseMipLevel(baseMipLevel)
+	, m_mipCount(mipCount)
+{
+	// aliased images don't have any memory until the render graph places them, so wait until the view is actually used
+	if (m_image->isBound())
+		createView();
+}
+
+ImageView::~ImageView()
+{
+	vkDestroyImageView(m_gfx->getLogicalDevice(), m_view, nullptr);
+	m_view = VK_NULL_HANDLE;
+}
+
+void ImageView::createView() const
 {
 	VkImageViewType viewType = m_image->getType();
 
-	if (m_image->isCubemap() && layerCount == 1)
+	if (m_image->isCubemap() && m_layerCount == 1)
 		viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
 
 	VkImageViewCreateInfo viewCreateInfo = {};
@@ -30,10 +49,10 @@ ImageView::ImageView(
 	viewCreateInfo.format = m_image->getFormat();
 
 	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewCreateInfo.subresourceRange.baseMipLevel = baseMipLevel;
-	viewCreateInfo.subresourceRange.levelCount = m_image->getMipmapCount() - baseMipLevel;
-	viewCreateInfo.subresourceRange.baseArrayLayer = layer;
-	viewCreateInfo.subresourceRange.layerCount = layerCount;
+	viewCreateInfo.subresourceRange.baseMipLevel = m_baseMipLevel;
+	viewCreateInfo.subresourceRange.levelCount = m_mipCount > 0 ? m_mipCount : m_image->getMipmapCount() - m_baseMipLevel;
+	viewCreateInfo.subresourceRange.baseArrayLayer = m_layer;
+	viewCreateInfo.subresourceRange.layerCount = m_layerCount;
 
 	if (m_image->isDepth())
 	{
@@ -51,16 +70,22 @@ ImageView::ImageView(
 		vkCreateImageView(m_gfx->getLogicalDevice(), &viewCreateInfo, nullptr, &m_view),
 		"Failed to create texture image view."
 	);
-}
 
-ImageView::~ImageView()
-{
-	vkDestroyImageView(m_gfx->getLogicalDevice(), m_view, nullptr);
-	m_view = VK_NULL_HANDLE;
+	m_generation = m_image->getGeneration();
 }
 
 const VkImageView &ImageView::getHandle() const
 {
+	// the render graph moved the image to new memory, whoever still uses the old view has been waited on by now
+	if (m_view != VK_NULL_HANDLE && m_generation != m_image->getGeneration())
+	{
+		vkDestroyImageView(m_gfx->getLogicalDevice(), m_view, nullptr);
+		m_view = VK_NULL_HANDLE;
+	}
+
+	if (m_view == VK_NULL_HANDLE)
+		createView();
+
 	return m_view;
 }
 
@@ -96,7 +121,8 @@ ImageView *ImageViewCache::fetchView(
 	Image *image,
 	int layerCount,
 	int layer,
-	int baseMipLevel
+	int baseMipLevel,
+	int mipCount
 )
 {
 	uint64_t hash = 0;
@@ -105,11 +131,12 @@ ImageView *ImageViewCache::fetchView(
 	hash::combine(&hash, &layerCount);
 	hash::combine(&hash, &layer);
 	hash::combine(&hash, &baseMipLevel);
+	hash::combine(&hash, &mipCount);
 
 	if (m_viewCache.contains(hash))
 		return m_viewCache.at(hash);
 
-	ImageView *view = m_gfx->createImageView(image, layerCount, layer, baseMipLevel);
+	ImageView *view = m_gfx->createImageView(image, layerCount, layer, baseMipLevel, mipCount);
 
 	m_viewCache.insert({ hash, view });
 
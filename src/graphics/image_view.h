@@ -14,12 +14,14 @@ namespace mgp
 	class ImageView
 	{
 	public:
+		// a mip count of 0 covers every level from the base down
 		ImageView(
 			GraphicsCore *gfx,
 			Image *image,
 			int layerCount,
 			int layer,
-			int baseMipLevel
+			int baseMipLevel,
+			int mipCount = 0
 		);
 
 		~ImageView();
@@ -30,10 +32,18 @@ namespace mgp
 		const Image *getImage() const;
 
 	private:
+		void createView() const;
+
 		GraphicsCore *m_gfx;
 
-		VkImageView m_view;
+		mutable VkImageView m_view;
+		mutable uint32_t m_generation; // of the image handle the view was made from
 		Image *m_image; // todo: use a handle here instead
+
+		int m_layerCount;
+		int m_layer;
+		int m_baseMipLevel;
+		int m_mipCount;
 	};
 
 	class ImageViewCache
@@ -51,7 +61,8 @@ namespace mgp
 			Image *image,
 			int layerCount,
 			int layer,
-			int baseMipLevel
+			int baseMipLevel,
+			int mipCount = 0
 		);
 
 	private:
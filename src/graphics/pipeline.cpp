@@ -2,12 +2,66 @@
 
 #include "core/common.h"
 
+#include "io/file_stream.h"
+
+#include "math/timer.h"
+
 #include "graphics_core.h"
 #include "shader.h"
 #include "render_info.h"
+#include "vertex_format.h"
 
 using namespace mgp;
 
+static constexpr uint32_t PIPELINE_MANIFEST_MAGIC = 0x4D50474D; // "MGPM"
+static constexpr uint32_t PIPELINE_MANIFEST_VERSION = 1;
+
+static void writeString(const Stream &stream, const std::string &str)
+{
+	uint32_t length = str.size();
+
+	stream.write(&length, sizeof(uint32_t));
+	stream.write((void *)str.data(), length);
+}
+
+// the manifest can be cut short by a crash mid-save, so nothing gets read without checking it's actually there
+static bool readChecked(const Stream &stream, void *dst, uint64_t size)
+{
+	int64_t position = stream.getPosition();
+
+	if (position < 0 || size > (uint64_t)(stream.getSize() - position))
+		return false;
+
+	stream.read(dst, size);
+
+	return true;
+}
+
+static bool readString(const Stream &stream, std::string *str)
+{
+	uint32_t length = 0;
+
+	if (!readChecked(stream, &length, sizeof(uint32_t)))
+		return false;
+
+	// a garbage length would otherwise turn into a huge allocation before the read fails
+	if (length > stream.getSize() - stream.getPosition())
+		return false;
+
+	str->resize(length);
+
+	return readChecked(stream, str->data(), length);
+}
+
+static bool isValidStencilOpState(const VkStencilOpState &state)
+{
+	return
+		state.failOp <= VK_STENCIL_OP_DECREMENT_AND_WRAP &&
+		state.passOp <= VK_STENCIL_OP_DECREMENT_AND_WRAP &&
+		state.depthFailOp <= VK_STENCIL_OP_DECREMENT_AND_WRAP &&
+		state.compareOp <= VK_COMPARE_OP_ALWAYS;
+}
+
 GraphicsPipelineDef::GraphicsPipelineDef()
 	: m_shader(nullptr)
 	, m_vertexFormat(nullptr)
@@ -200,6 +254,73 @@ uint64_t GraphicsPipelineDef::getHash() const
 	return h;
 }
 
+void GraphicsPipelineDef::writeState(const Stream &stream) const
+{
+	stream.write((void *)&m_cullMode, sizeof(m_cullMode));
+	stream.write((void *)&m_frontFace, sizeof(m_frontFace));
+	stream.write((void *)&m_blendConstants, sizeof(m_blendConstants));
+	stream.write((void *)&m_colourBlendState, sizeof(m_colourBlendState));
+	stream.write((void *)&m_depthStencilState, sizeof(m_depthStencilState));
+	stream.write((void *)&m_blendStateLogicOpEnabled, sizeof(m_blendStateLogicOpEnabled));
+	stream.write((void *)&m_blendStateLogicOp, sizeof(m_blendStateLogicOp));
+	stream.write((void *)&m_sampleShadingEnabled, sizeof(m_sampleShadingEnabled));
+	stream.write((void *)&m_minSampleShading, sizeof(m_minSampleShading));
+}
+
+bool GraphicsPipelineDef::readState(const Stream &stream)
+{
+	// read as bytes first, anything other than 0 or 1 in a bool is undefined
+	uint8_t blendStateLogicOpEnabled = 0;
+	uint8_t sampleShadingEnabled = 0;
+
+	if (!readChecked(stream, &m_cullMode, sizeof(m_cullMode)) ||
+		!readChecked(stream, &m_frontFace, sizeof(m_frontFace)) ||
+		!readChecked(stream, &m_blendConstants, sizeof(m_blendConstants)) ||
+		!readChecked(stream, &m_colourBlendState, sizeof(m_colourBlendState)) ||
+		!readChecked(stream, &m_depthStencilState, sizeof(m_depthStencilState)) ||
+		!readChecked(stream, &blendStateLogicOpEnabled, sizeof(m_blendStateLogicOpEnabled)) ||
+		!readChecked(stream, &m_blendStateLogicOp, sizeof(m_blendStateLogicOp)) ||
+		!readChecked(stream, &sampleShadingEnabled, sizeof(m_sampleShadingEnabled)) ||
+		!readChecked(stream, &m_minSampleShading, sizeof(m_minSampleShading)))
+	{
+		return false;
+	}
+
+	// the pointer from the last run means nothing now
+	m_depthStencilState.pNext = nullptr;
+
+	// we only ever write core state, so anything outside of it means the file is garbage
+	bool valid =
+		(m_cullMode & ~VK_CULL_MODE_FRONT_AND_BACK) == 0 &&
+		m_frontFace <= VK_FRONT_FACE_CLOCKWISE &&
+		m_colourBlendState.blendEnable <= VK_TRUE &&
+		m_colourBlendState.srcColorBlendFactor <= VK_BLEND_FACTOR_ONE_MINUS_SRC1_ALPHA &&
+		m_colourBlendState.dstColorBlendFactor <= VK_BLEND_FACTOR_ONE_MINUS_SRC1_ALPHA &&
+		m_colourBlendState.srcAlphaBlendFactor <= VK_BLEND_FACTOR_ONE_MINUS_SRC1_ALPHA &&
+		m_colourBlendState.dstAlphaBlendFactor <= VK_BLEND_FACTOR_ONE_MINUS_SRC1_ALPHA &&
+		m_colourBlendState.colorBlendOp <= VK_BLEND_OP_MAX &&
+		m_colourBlendState.alphaBlendOp <= VK_BLEND_OP_MAX &&
+		(m_colourBlendState.colorWriteMask & ~(VkColorComponentFlags)0xF) == 0 &&
+		m_depthStencilState.sType == VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO &&
+		m_depthStencilState.flags == 0 &&
+		m_depthStencilState.depthTestEnable <= VK_TRUE &&
+		m_depthStencilState.depthWriteEnable <= VK_TRUE &&
+		m_depthStencilState.depthBoundsTestEnable <= VK_TRUE &&
+		m_depthStencilState.stencilTestEnable <= VK_TRUE &&
+		m_depthStencilState.depthCompareOp <= VK_COMPARE_OP_ALWAYS &&
+		isValidStencilOpState(m_depthStencilState.front) &&
+		isValidStencilOpState(m_depthStencilState.back) &&
+		blendStateLogicOpEnabled <= 1 &&
+		m_blendStateLogicOp <= VK_LOGIC_OP_SET &&
+		sampleShadingEnabled <= 1 &&
+		m_minSampleShading >= 0.0f && m_minSampleShading <= 1.0f;
+
+	m_blendStateLogicOpEnabled = blendStateLogicOpEnabled;
+	m_sampleShadingEnabled = sampleShadingEnabled;
+
+	return valid;
+}
+
 ComputePipelineDef::ComputePipelineDef()
 	: m_shader(nullptr)
 {
@@ -227,10 +348,19 @@ uint64_t ComputePipelineDef::getHash() const
 void PipelineCache::init(GraphicsCore *gfx)
 {
 	m_gfx = gfx;
+
+	m_stopWorkers = false;
+
+	m_compiledCount = 0;
+
+	for (auto &count : m_compileTimeHistogram)
+		count = 0;
 }
 
 void PipelineCache::destroy()
 {
+	stopCompileWorkers();
+
 	for (auto &[id, pipeline] : m_pipelines)
 	{
 		vkDestroyPipeline(m_gfx->getLogicalDevice(), pipeline, nullptr);
@@ -243,17 +373,15 @@ void PipelineCache::destroy()
 	
 	m_pipelines.clear();
 	m_layouts.clear();
+
+	m_manifest.clear();
 }
 
 PipelineState PipelineCache::fetchGraphicsPipeline(const GraphicsPipelineDef &definition, const RenderInfo &renderInfo)
 {
-	uint32_t h1 = definition.getHash();
-	uint32_t h2 = renderInfo.getHash();
-	
-	uint64_t createdPipelineHash = 0;
+	publishCompiledPipelines();
 
-	hash::combine(&createdPipelineHash, &h1);
-	hash::combine(&createdPipelineHash, &h2);
+	uint64_t createdPipelineHash = getGraphicsPipelineHash(definition, renderInfo);
 
 	VkPipelineLayout layout = fetchPipelineLayout(definition.getShader());
 
@@ -266,13 +394,15 @@ PipelineState PipelineCache::fetchGraphicsPipeline(const GraphicsPipelineDef &de
 		return st;
 	}
 
-	VkPipeline pipeline = m_gfx->createGraphicsPipeline(layout, definition, renderInfo);
+	VkPipeline pipeline = compileGraphicsPipeline(layout, definition, renderInfo);
 	
 	m_pipelines.insert({
 		createdPipelineHash,
 		pipeline
 	});
 
+	addManifestEntry(definition, renderInfo.getMSAA(), renderInfo.getColourAttachmentFormats());
+
 	PipelineState st = {};
 	st.pipeline = pipeline;
 	st.layout = layout;
@@ -280,6 +410,224 @@ PipelineState PipelineCache::fetchGraphicsPipeline(const GraphicsPipelineDef &de
 	return st;
 }
 
+PipelineState PipelineCache::tryFetchGraphicsPipeline(const GraphicsPipelineDef &definition, const RenderInfo &renderInfo)
+{
+	if (m_workers.empty())
+		return fetchGraphicsPipeline(definition, renderInfo);
+
+	publishCompiledPipelines();
+
+	uint64_t createdPipelineHash = getGraphicsPipelineHash(definition, renderInfo);
+
+	PipelineState st = {};
+	st.pipeline = VK_NULL_HANDLE;
+	st.layout = fetchPipelineLayout(definition.getShader());
+
+	if (m_pipelines.contains(createdPipelineHash))
+	{
+		st.pipeline = m_pipelines[createdPipelineHash];
+		return st;
+	}
+
+	// already on its way
+	if (m_pending.contains(createdPipelineHash))
+		return st;
+
+	m_pending.insert(createdPipelineHash);
+
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+
+		m_jobs.push_back({
+			createdPipelineHash,
+			st.layout,
+			definition,
+			renderInfo.getMSAA(),
+			renderInfo.getColourAttachmentFormats()
+		});
+	}
+
+	m_jobCondition.notify_one();
+
+	return st;
+}
+
+void PipelineCache::startCompileWorkers(unsigned workerCount)
+{
+	if (!m_workers.empty())
+		return;
+
+	m_stopWorkers = false;
+
+	for (unsigned i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&PipelineCache::workerLoop, this);
+
+	mgp_LOG("Started %u pipeline compile workers.", workerCount);
+}
+
+void PipelineCache::stopCompileWorkers()
+{
+	if (m_workers.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+
+		m_stopWorkers = true;
+		m_jobs.clear();
+	}
+
+	m_jobCondition.notify_all();
+
+	for (auto &worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+
+	// nothing is left running so just take whatever they finished
+	for (auto &result : m_results)
+	{
+		if (m_pipelines.contains(result.job.hash))
+		{
+			vkDestroyPipeline(m_gfx->getLogicalDevice(), result.pipeline, nullptr);
+			continue;
+		}
+
+		m_pipelines.insert({ result.job.hash, result.pipeline });
+
+		addManifestEntry(result.job.definition, result.job.samples, result.job.colourFormats);
+	}
+
+	m_results.clear();
+	m_pending.clear();
+}
+
+void PipelineCache::publishCompiledPipelines()
+{
+	std::vector<CompileResult> results;
+
+	{
+		// if a worker is mid-push we'll just pick it up next time
+		std::unique_lock<std::mutex> lock(m_resultMutex, std::try_to_lock);
+
+		if (!lock.owns_lock() || m_results.empty())
+			return;
+
+		results.swap(m_results);
+	}
+
+	for (auto &result : results)
+	{
+		m_pending.erase(result.job.hash);
+
+		// fetchGraphicsPipeline got there first
+		if (m_pipelines.contains(result.job.hash))
+		{
+			vkDestroyPipeline(m_gfx->getLogicalDevice(), result.pipeline, nullptr);
+			continue;
+		}
+
+		m_pipelines.insert({ result.job.hash, result.pipeline });
+
+		addManifestEntry(result.job.definition, result.job.samples, result.job.colourFormats);
+	}
+}
+
+std::array<uint32_t, PIPELINE_COMPILE_TIME_BUCKET_COUNT> PipelineCache::getCompileTimeHistogram() const
+{
+	std::array<uint32_t, PIPELINE_COMPILE_TIME_BUCKET_COUNT> histogram = {};
+
+	for (int i = 0; i < PIPELINE_COMPILE_TIME_BUCKET_COUNT; i++)
+		histogram[i] = m_compileTimeHistogram[i];
+
+	return histogram;
+}
+
+uint64_t PipelineCache::getGraphicsPipelineHash(const GraphicsPipelineDef &definition, const RenderInfo &renderInfo) const
+{
+	uint64_t h1 = definition.getHash();
+	uint64_t h2 = renderInfo.getPipelineHash();
+	
+	uint64_t result = 0;
+
+	hash::combine(&result, &h1);
+	hash::combine(&result, &h2);
+
+	return result;
+}
+
+VkPipeline PipelineCache::compileGraphicsPipeline(VkPipelineLayout layout, const GraphicsPipelineDef &definition, const RenderInfo &renderInfo)
+{
+	Timer timer(m_gfx->getPlatform());
+	timer.start();
+
+	VkPipeline pipeline = m_gfx->createGraphicsPipeline(layout, definition, renderInfo);
+
+	float elapsedMs = timer.getElapsedSeconds() * 1000.0;
+
+	int bucket = 0;
+
+	while (bucket < PIPELINE_COMPILE_TIME_BUCKET_COUNT - 1 && elapsedMs > PIPELINE_COMPILE_TIME_BUCKETS[bucket])
+		bucket++;
+
+	m_compileTimeHistogram[bucket]++;
+	m_compiledCount++;
+
+	return pipeline;
+}
+
+void PipelineCache::addManifestEntry(const GraphicsPipelineDef &definition, VkSampleCountFlagBits samples, const std::vector<VkFormat> &colourFormats)
+{
+	// only named resources can be found again on the next run
+	bool hasNamedShader = !definition.getShader()->getName().empty();
+	bool hasNamedVertexFormat = !definition.getVertexFormat() || !definition.getVertexFormat()->getName().empty();
+
+	if (!hasNamedShader || !hasNamedVertexFormat)
+		return;
+
+	m_manifest.push_back({
+		definition,
+		samples,
+		colourFormats
+	});
+}
+
+void PipelineCache::workerLoop()
+{
+	while (true)
+	{
+		CompileJob job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+
+			m_jobCondition.wait(lock, [&]() -> bool { return m_stopWorkers || !m_jobs.empty(); });
+
+			if (m_stopWorkers)
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		RenderInfo renderInfo;
+		renderInfo.setMSAA(job.samples);
+		renderInfo.setColourAttachmentFormats(job.colourFormats);
+
+		// the process cache is internally synchronised so the workers can all share it
+		VkPipeline pipeline = compileGraphicsPipeline(job.layout, job.definition, renderInfo);
+
+		{
+			std::lock_guard<std::mutex> lock(m_resultMutex);
+
+			m_results.push_back({
+				std::move(job),
+				pipeline
+			});
+		}
+	}
+}
+
 PipelineState PipelineCache::fetchComputePipeline(const ComputePipelineDef &definition)
 {
 	uint64_t createdPipelineHash = definition.getHash();
@@ -309,9 +657,139 @@ PipelineState PipelineCache::fetchComputePipeline(const ComputePipelineDef &defi
 	return st;
 }
 
+void PipelineCache::prewarm(const char *manifestPath, const FindShaderFn &findShader, const FindVertexFormatFn &findVertexFormat)
+{
+	FileStream fs(m_gfx->getPlatform(), manifestPath, "rb");
+
+	if (!fs.getStream())
+		return;
+
+	uint32_t magic = 0, version = 0, entryCount = 0;
+
+	fs.read(&magic, sizeof(uint32_t));
+	fs.read(&version, sizeof(uint32_t));
+	fs.read(&entryCount, sizeof(uint32_t));
+
+	if (magic != PIPELINE_MANIFEST_MAGIC || version != PIPELINE_MANIFEST_VERSION)
+	{
+		mgp_LOG("Pipeline manifest is out of date, ignoring it.");
+		return;
+	}
+
+	cauto &limits = m_gfx->getPhysicalDeviceProperties().properties.limits;
+
+	int compiled = 0;
+
+	for (int i = 0; i < entryCount; i++)
+	{
+		std::string shaderName;
+		std::string vertexFormatName;
+
+		GraphicsPipelineDef definition;
+
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		uint32_t colourFormatCount = 0;
+
+		std::vector<VkFormat> colourFormats;
+
+		// everything after a bad entry is just as suspect, so stop rather than feed garbage to the driver
+		bool valid =
+			readString(fs, &shaderName) &&
+			readString(fs, &vertexFormatName) &&
+			definition.readState(fs) &&
+			readChecked(fs, &samples, sizeof(VkSampleCountFlagBits)) &&
+			readChecked(fs, &colourFormatCount, sizeof(uint32_t)) &&
+			(samples & (samples - 1)) == 0 &&
+			(samples & limits.framebufferColorSampleCounts) != 0 &&
+			colourFormatCount <= limits.maxColorAttachments;
+
+		if (valid)
+		{
+			colourFormats.resize(colourFormatCount);
+			valid = readChecked(fs, colourFormats.data(), sizeof(VkFormat) * colourFormatCount);
+		}
+
+		for (int j = 0; valid && j < colourFormats.size(); j++)
+		{
+			// only core formats get written, and querying anything else isn't allowed
+			if (colourFormats[j] <= VK_FORMAT_UNDEFINED || colourFormats[j] > VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+			{
+				valid = false;
+				break;
+			}
+
+			VkFormatProperties properties = {};
+			vkGetPhysicalDeviceFormatProperties(m_gfx->getPhysicalDevice(), colourFormats[j], &properties);
+
+			valid = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) != 0;
+		}
+
+		if (!valid)
+		{
+			mgp_LOG("Pipeline manifest is corrupt at entry %d, stopping there.", i);
+			break;
+		}
+
+		const Shader *shader = findShader(shaderName);
+		const VertexFormat *vertexFormat = vertexFormatName.empty() ? nullptr : findVertexFormat(vertexFormatName);
+
+		// the shader or vertex format doesn't exist anymore, drop it
+		if (!shader || (!vertexFormatName.empty() && !vertexFormat))
+			continue;
+
+		definition.setShader(shader);
+		definition.setVertexFormat(vertexFormat);
+
+		RenderInfo renderInfo;
+		renderInfo.setMSAA(samples);
+		renderInfo.setColourAttachmentFormats(colourFormats);
+
+		fetchGraphicsPipeline(definition, renderInfo);
+
+		compiled++;
+	}
+
+	mgp_LOG("Pre-warmed %d/%u pipelines from the manifest.", compiled, entryCount);
+}
+
+void PipelineCache::saveManifest(const char *manifestPath) const
+{
+	FileStream fs(m_gfx->getPlatform(), manifestPath, "wb");
+
+	if (!fs.getStream())
+	{
+		mgp_LOG("Failed to open pipeline manifest for writing.");
+		return;
+	}
+
+	uint32_t magic = PIPELINE_MANIFEST_MAGIC;
+	uint32_t version = PIPELINE_MANIFEST_VERSION;
+	uint32_t entryCount = m_manifest.size();
+
+	fs.write(&magic, sizeof(uint32_t));
+	fs.write(&version, sizeof(uint32_t));
+	fs.write(&entryCount, sizeof(uint32_t));
+
+	for (cauto &entry : m_manifest)
+	{
+		writeString(fs, entry.definition.getShader()->getName());
+		writeString(fs, entry.definition.getVertexFormat() ? entry.definition.getVertexFormat()->getName() : "");
+
+		entry.definition.writeState(fs);
+
+		uint32_t colourFormatCount = entry.colourFormats.size();
+
+		fs.write((void *)&entry.samples, sizeof(VkSampleCountFlagBits));
+		fs.write(&colourFormatCount, sizeof(uint32_t));
+		fs.write((void *)entry.colourFormats.data(), sizeof(VkFormat) * colourFormatCount);
+	}
+
+	mgp_LOG("Saved %u pipelines to the manifest.", entryCount);
+}
+
 VkPipelineLayout PipelineCache::fetchPipelineLayout(const Shader *shader)
 {
-	VkShaderStageFlags shaderStage = shader->getStages()[0]->getType() == VK_SHADER_STAGE_COMPUTE_BIT ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_ALL_GRAPHICS;
+	VkShaderStageFlags shaderStage = shader->getPushConstantStages();
 	uint64_t pcSize = shader->getPushConstantSize();
 
 	cauto &setLayouts = shader->getLayouts();
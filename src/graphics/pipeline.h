@@ -2,6 +2,15 @@
 
 #include <array>
 #include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include <Volk/volk.h>
 
@@ -14,6 +23,7 @@ namespace mgp
 
 	class Shader;
 	class GraphicsCore;
+	class Stream;
 
 	class GraphicsPipelineDef
 	{
@@ -57,6 +67,11 @@ namespace mgp
 
 		uint64_t getHash() const;
 
+		// fixed-function state only, the shader and vertex format are up to the caller
+		// reading fails if the stream runs out or holds anything that isn't valid state
+		void writeState(const Stream &stream) const;
+		bool readState(const Stream &stream);
+
 	private:
 		const Shader *m_shader;
 
@@ -103,9 +118,16 @@ namespace mgp
 		VkPipelineLayout layout;
 	};
 
+	// upper bounds (in ms) of each compile time bucket, anything slower goes in the last one
+	static constexpr float PIPELINE_COMPILE_TIME_BUCKETS[] = { 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f, 128.0f };
+	static constexpr int PIPELINE_COMPILE_TIME_BUCKET_COUNT = std::size(PIPELINE_COMPILE_TIME_BUCKETS) + 1;
+
 	class PipelineCache
 	{
 	public:
+		using FindShaderFn = std::function<const Shader *(const std::string &)>;
+		using FindVertexFormatFn = std::function<const VertexFormat *(const std::string &)>;
+
 		PipelineCache() = default;
 		~PipelineCache() = default;
 
@@ -115,11 +137,79 @@ namespace mgp
 		PipelineState fetchGraphicsPipeline(const GraphicsPipelineDef &definition, const RenderInfo &renderInfo);
 		PipelineState fetchComputePipeline(const ComputePipelineDef &definition);
 
+		// like fetchGraphicsPipeline but misses get compiled on the workers instead
+		// returns a null pipeline until it's ready, so the caller should skip the draw
+		// without any workers running this just compiles synchronously
+		PipelineState tryFetchGraphicsPipeline(const GraphicsPipelineDef &definition, const RenderInfo &renderInfo);
+
+		void startCompileWorkers(unsigned workerCount);
+		void stopCompileWorkers();
+
+		// moves finished pipelines from the workers into the cache, never blocks
+		void publishCompiledPipelines();
+
+		uint32_t getPendingCount() const { return m_pending.size(); }
+		uint32_t getCompiledCount() const { return m_compiledCount; }
+
+		std::array<uint32_t, PIPELINE_COMPILE_TIME_BUCKET_COUNT> getCompileTimeHistogram() const;
+
+		// compiles every graphics pipeline a previous run wrote to the manifest
+		void prewarm(const char *manifestPath, const FindShaderFn &findShader, const FindVertexFormatFn &findVertexFormat);
+		void saveManifest(const char *manifestPath) const;
+
 	private:
+		// everything needed to rebuild a graphics pipeline on the next run
+		struct ManifestEntry
+		{
+			GraphicsPipelineDef definition;
+			VkSampleCountFlagBits samples;
+			std::vector<VkFormat> colourFormats;
+		};
+
+		struct CompileJob
+		{
+			uint64_t hash;
+			VkPipelineLayout layout;
+			GraphicsPipelineDef definition;
+			VkSampleCountFlagBits samples;
+			std::vector<VkFormat> colourFormats;
+		};
+
+		struct CompileResult
+		{
+			CompileJob job;
+			VkPipeline pipeline;
+		};
+
 		GraphicsCore *m_gfx;
 		
 		VkPipelineLayout fetchPipelineLayout(const Shader *shader);
 
+		uint64_t getGraphicsPipelineHash(const GraphicsPipelineDef &definition, const RenderInfo &renderInfo) const;
+		VkPipeline compileGraphicsPipeline(VkPipelineLayout layout, const GraphicsPipelineDef &definition, const RenderInfo &renderInfo);
+
+		void addManifestEntry(const GraphicsPipelineDef &definition, VkSampleCountFlagBits samples, const std::vector<VkFormat> &colourFormats);
+
+		void workerLoop();
+
+		std::vector<ManifestEntry> m_manifest;
+
+		std::vector<std::thread> m_workers;
+		bool m_stopWorkers;
+
+		std::mutex m_jobMutex;
+		std::condition_variable m_jobCondition;
+		std::deque<CompileJob> m_jobs;
+
+		std::mutex m_resultMutex;
+		std::vector<CompileResult> m_results;
+
+		// only touched by the render thread
+		std::unordered_set<uint64_t> m_pending;
+
+		std::atomic<uint32_t> m_compiledCount;
+		std::array<std::atomic<uint32_t>, PIPELINE_COMPILE_TIME_BUCKET_COUNT> m_compileTimeHistogram;
+
 		std::unordered_map<uint64_t, VkPipeline> m_pipelines;
 		std::unordered_map<uint64_t, VkPipelineLayout> m_layouts;
 	};
@@ -13,58 +13,28 @@ void Queue::FrameData::create(GraphicsCore *gfx, int queueFamilyIndex)
 	// create dynamic pool
 	pool.create(m_gfx, queueFamilyIndex);
 
-	// create in flight fence
-	{
-		VkFenceCreateInfo inFlightFenceCreateInfo = {};
-		inFlightFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		inFlightFenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		mgp_VK_CHECK(
-			vkCreateFence(
-				m_gfx->getLogicalDevice(),
-				&inFlightFenceCreateInfo,
-				nullptr,
-				&this->inFlightFence
-			),
-			"Failed to create queue frame in flight fence"
-		);
-	}
-
-	// create in instant submit fence
-	{
-		VkFenceCreateInfo instantSubmitFenceCreateInfo = {};
-		instantSubmitFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		instantSubmitFenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		mgp_VK_CHECK(
-			vkCreateFence(
-				m_gfx->getLogicalDevice(),
-				&instantSubmitFenceCreateInfo,
-				nullptr,
-				&this->instantSubmitFence
-			),
-			"Failed to create queue frame instant submit fence"
-		);
-	}
+	timelineValue = 0;
 }
 
 void Queue::FrameData::destroy() const
 {
 	pool.destroy();
-
-	vkDestroyFence(m_gfx->getLogicalDevice(), inFlightFence, nullptr);
-	vkDestroyFence(m_gfx->getLogicalDevice(), instantSubmitFence, nullptr);
 }
 
 Queue::Queue()
-	: m_queue(VK_NULL_HANDLE)
+	: m_gfx(nullptr)
+	, m_queue(VK_NULL_HANDLE)
 	, m_familyIndex(0)
+	, m_timelineSemaphore(VK_NULL_HANDLE)
+	, m_timelineValue(0)
 	, m_frames()
 {
 }
 
 void Queue::create(GraphicsCore *gfx, uint32_t index)
 {
+	m_gfx = gfx;
+
 	vkGetDeviceQueue(
 		gfx->getLogicalDevice(),
 		m_familyIndex,
@@ -72,6 +42,27 @@ void Queue::create(GraphicsCore *gfx, uint32_t index)
 		&m_queue
 	);
 
+	VkSemaphoreTypeCreateInfo timelineCreateInfo = {};
+	timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &timelineCreateInfo;
+
+	mgp_VK_CHECK(
+		vkCreateSemaphore(
+			gfx->getLogicalDevice(),
+			&semaphoreCreateInfo,
+			nullptr,
+			&m_timelineSemaphore
+		),
+		"Failed to create queue timeline semaphore"
+	);
+
+	m_timelineValue = 0;
+
 	for (auto &f : m_frames)
 		f.create(gfx, m_familyIndex);
 }
@@ -80,6 +71,8 @@ void Queue::destroy()
 {
 	for (cauto &f : m_frames)
 		f.destroy();
+
+	vkDestroySemaphore(m_gfx->getLogicalDevice(), m_timelineSemaphore, nullptr);
 }
 
 VkDeviceQueueCreateInfo Queue::getCreateInfo(const std::vector<float> &priorities)
@@ -117,3 +110,48 @@ const Queue::FrameData &Queue::getFrame(int frame) const
 {
 	return m_frames[frame];
 }
+
+const VkSemaphore &Queue::getTimelineSemaphore() const
+{
+	return m_timelineSemaphore;
+}
+
+uint64_t Queue::nextTimelineValue()
+{
+	return ++m_timelineValue;
+}
+
+uint64_t Queue::getLatestTimelineValue() const
+{
+	return m_timelineValue;
+}
+
+uint64_t Queue::getCompletedTimelineValue() const
+{
+	uint64_t value = 0;
+
+	mgp_VK_CHECK(
+		vkGetSemaphoreCounterValue(m_gfx->getLogicalDevice(), m_timelineSemaphore, &value),
+		"Failed to get queue timeline semaphore value"
+	);
+
+	return value;
+}
+
+void Queue::waitForTimelineValue(uint64_t value) const
+{
+	// nothing has been submitted yet or it has already finished
+	if (value == 0 || getCompletedTimelineValue() >= value)
+		return;
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_timelineSemaphore;
+	waitInfo.pValues = &value;
+
+	mgp_VK_CHECK(
+		vkWaitSemaphores(m_gfx->getLogicalDevice(), &waitInfo, UINT64_MAX),
+		"Failed to wait on queue timeline semaphore"
+	);
+}
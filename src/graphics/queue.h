@@ -24,8 +24,9 @@ namespace mgp
 
 			CommandPoolDynamic pool;
 
-			VkFence inFlightFence;
-			VkFence instantSubmitFence;
+			// the timeline value of the last submission recorded with this frame's pool
+			// once the queue's timeline reaches it the frame's resources can be recycled
+			uint64_t timelineValue;
 
 		private:
 			GraphicsCore *m_gfx;
@@ -47,10 +48,23 @@ namespace mgp
 		FrameData &getFrame(int frame);
 		const FrameData &getFrame(int frame) const;
 
+		const VkSemaphore &getTimelineSemaphore() const;
+
+		uint64_t nextTimelineValue();
+		uint64_t getLatestTimelineValue() const; // last value handed out, not necessarily reached yet
+		uint64_t getCompletedTimelineValue() const;
+
+		void waitForTimelineValue(uint64_t value) const;
+
 	private:
+		GraphicsCore *m_gfx;
+
 		VkQueue m_queue;
 		uint32_t m_familyIndex;
 
+		VkSemaphore m_timelineSemaphore;
+		uint64_t m_timelineValue;
+
 		std::array<FrameData, gfx_constants::FRAMES_IN_FLIGHT> m_frames;
 	};
 }
@@ -1,105 +1,1176 @@
 #include "render_graph.h"
 
+#include <algorithm>
+#include <numeric>
+
+#include "core/common.h"
+
+#include "graphics_core.h"
 #include "command_buffer.h"
 #include "swapchain.h"
+#include "gpu_buffer.h"
+#include "image.h"
 
 /*
 	Implementation based on https://themaister.net/blog/2017/08/15/render-graphs-and-vulkan-a-deep-dive/, but somewhat simplified for now
-	For instance, it's automatically assumed that all passes are already in order as they are pushed. That is, if we iterate through the m_passes
-	list, we can be certain whatever pass we reach will not be dependent on passes in front of it.
-*/
-
-/* Current Todo:
-	- proper actual dependency system
-	- have an intermediary "GraphResource" components that can have writers, from which we can then flatten the graph and proceed as normal
-	- getImageViewResource(<view>), getBufferResource(<buffer>), etc...
+	Passes are still expected to be pushed in a valid execution order, the graph doesn't reorder anything. What it does do is work out
+	which passes actually contribute to an output (and cull the rest) and then batch all of the transitions needed at the start of each
+	pass into a single barrier with the exact stages and access masks involved.
 */
 
 using namespace mgp;
 
 RenderGraph::RenderGraph(GraphicsCore *gfx)
 	: m_gfx(gfx)
+	, m_passes()
+	, m_renderPasses()
+	, m_computeTasks()
+	, m_compiledPasses()
+	, m_compiled(false)
+	, m_resources()
+	, m_resourceStates()
+	, m_imageResources()
+	, m_bufferResources()
+	, m_swapchainResource(-1)
+	, m_asyncBatch(-1)
+	, m_asyncBatchValue(0)
+	, m_passesSinceAsyncBatch(0)
+	, m_swapchainRecorded(false)
+	, m_imageBarriers()
+	, m_bufferBarriers()
+	, m_transients()
+	, m_transientAllocations()
+	, m_transientsAllocated(false)
+	, m_transientPlacement(0)
+	, m_transientMemoryAliased(0)
+	, m_transientMemoryUnaliased(0)
+	, m_stats()
 {
 }
 
+RenderGraph::~RenderGraph()
+{
+	for (auto &transient : m_transients)
+		delete transient.image;
+
+	for (auto &allocation : m_transientAllocations)
+		vmaFreeMemory(m_gfx->getVMAAllocator(), allocation);
+
+	m_transients.clear();
+	m_transientAllocations.clear();
+}
+
 void RenderGraph::recordTo(CommandBuffer *cmd, Swapchain *swapchain)
 {
-	if (!validate())
+	if (!m_compiled)
 	{
-		mgp_ERROR("Invalid render graph.");
-		return;
+		if (!validate())
+		{
+			mgp_ERROR("Invalid render graph.");
+			return;
+		}
+
+		compile(swapchain);
+
+		m_compiled = true;
 	}
 
-//	std::vector<PassHandle> passStack = flattenGraphRecursive(m_passes[m_passes.size() - 1]);
+	if (m_swapchainResource != -1)
+		m_resources[m_swapchainResource].image = swapchain->getCurrentSwapchainImage();
+
+	resetResourceStates();
+
+	m_stats = {};
+	m_stats.passCount = m_compiledPasses.size();
+	m_stats.transientMemoryAliased = m_transientMemoryAliased;
+	m_stats.transientMemoryUnaliased = m_transientMemoryUnaliased;
 
-//	std::reverse(passStack.begin(), passStack.end());
+	// splitting the frame into several submissions only works for the frame's own command buffer
+	bool asyncCompute = m_gfx->hasAsyncCompute() && m_gfx->isFrameCommandBuffer(cmd);
 
-//	std::vector<PassHandle> leanPassStack;
+	CommandBuffer *computeCmd = nullptr;
 
-	/*
-	for (auto &p1 : passStack)
+	m_asyncBatch = -1;
+	m_swapchainRecorded = false;
+
+	for (int i = 0; i < m_compiledPasses.size(); i++)
 	{
-		bool seen = false;
+		auto &pass = m_compiledPasses[i];
 
-		for (auto &p2 : leanPassStack)
+		if (pass.culled)
 		{
-			if (p1 == p2)
-			{
-				seen = true;
-				break;
-			}
+			m_stats.culledPassCount++;
+			continue;
 		}
 
-		if (!seen)
+		if (asyncCompute && pass.async && !m_swapchainRecorded)
 		{
-			leanPassStack.push_back(p1);
+			if (!computeCmd)
+				computeCmd = beginAsyncBatch(cmd, i);
+
+			flushBarriers(computeCmd, pass.accesses);
+			handleComputeTask(computeCmd, swapchain, pass);
+
+			continue;
 		}
-	}
-	*/
 
-	for (cauto &p : m_passes /*leanPassStack*/)
-	{
-		// very scuffed right now just to get the ball rolling i guess
-		// JIT transitions
-		// yes, not the best
-		// yes, i'll make it better... at some point... (tbd)
+		if (computeCmd)
+		{
+			endAsyncBatch(computeCmd);
+			computeCmd = nullptr;
+		}
+
+		if (m_asyncBatch != -1 && dependsOnAsyncBatch(pass))
+			joinAsyncBatch(cmd);
+
+		flushBarriers(cmd, pass.accesses);
 
-		switch (p.type)
+		switch (pass.handle.type)
 		{
 			case PassHandle::PASS_TYPE_RENDER:
 			{
-				handleRenderPass(cmd, swapchain, p);
+				handleRenderPass(cmd, swapchain, pass);
 				break;
 			}
 
 			case PassHandle::PASS_TYPE_COMPUTE:
 			{
-				handleComputeTask(cmd, swapchain, p);
+				handleComputeTask(cmd, swapchain, pass);
 				break;
 			}
 		}
+
+		m_passesSinceAsyncBatch++;
+
+		if (pass.swapchainAttachment != -1)
+			m_swapchainRecorded = true;
 	}
 
+	if (computeCmd)
+		endAsyncBatch(computeCmd);
+
+	// everything has to be back on the graphics queue by the end of the frame
+	if (m_asyncBatch != -1)
+		joinAsyncBatch(cmd);
+
+	flushFinalBarriers(cmd);
+}
+
+void RenderGraph::invalidate()
+{
+	m_compiled = false;
+
 	m_passes.clear();
 
 	m_renderPasses.clear();
 	m_computeTasks.clear();
+
+	m_compiledPasses.clear();
+
+	m_resources.clear();
+	m_resourceStates.clear();
+
+	m_imageResources.clear();
+	m_bufferResources.clear();
+
+	m_swapchainResource = -1;
+
+	for (auto &transient : m_transients)
+		transient.resource = -1;
 }
 
 bool RenderGraph::validate() const
 {
+	for (cauto &pass : m_renderPasses)
+	{
+		if (pass.getAttachments().empty())
+			return false;
+
+		if (!pass.getRecordFn())
+			return false;
+	}
+
+	for (cauto &task : m_computeTasks)
+	{
+		if (!task.getRecordFn())
+			return false;
+	}
+
 	return true;
 }
 
-void RenderGraph::handleRenderPass(CommandBuffer *cmd, Swapchain *swapchain, const PassHandle &handle)
+void RenderGraph::compile(Swapchain *swapchain)
+{
+	m_compiledPasses.resize(m_passes.size());
+
+	for (int i = 0; i < m_passes.size(); i++)
+	{
+		CompiledPass &pass = m_compiledPasses[i];
+		pass.handle = m_passes[i];
+		pass.accesses.clear();
+		pass.dependencies.clear();
+		pass.culled = false;
+		pass.async = false;
+		pass.batchResources.clear();
+		pass.renderInfo = RenderInfo();
+		pass.swapchainAttachment = -1;
+
+		switch (pass.handle.type)
+		{
+			case PassHandle::PASS_TYPE_RENDER:
+				gatherRenderPassAccesses(pass);
+				break;
+
+			case PassHandle::PASS_TYPE_COMPUTE:
+				gatherComputeTaskAccesses(pass);
+				pass.async = m_gfx->hasAsyncCompute() && m_computeTasks[pass.handle.index].isAsyncCompute();
+				break;
+		}
+	}
+
+	buildDependencies();
+	cullPasses();
+
+	computeAsyncBatches();
+
+	computeTransientLifetimes();
+
+	if (!m_transientsAllocated)
+	{
+		allocateTransients();
+	}
+	else
+	{
+		// the old placement was picked for the old lifetimes, so if the passes have been rearranged redo it
+		bool moved = false;
+
+		for (cauto &transient : m_transients)
+		{
+			if (transient.firstPass != transient.placedFirstPass || transient.lastPass != transient.placedLastPass)
+			{
+				moved = true;
+				break;
+			}
+		}
+
+		if (moved)
+		{
+			freeTransients();
+			allocateTransients();
+		}
+	}
+
+	m_resourceStates.resize(m_resources.size());
+
+	// views of transients only exist now that they have memory
+	for (auto &pass : m_compiledPasses)
+	{
+		if (!pass.culled && pass.handle.type == PassHandle::PASS_TYPE_RENDER)
+			buildRenderInfo(pass, swapchain);
+	}
+}
+
+void RenderGraph::resetResourceStates()
+{
+	// images keep their layout between frames, but we don't know what touched them last so the first barrier waits on everything
+	// the same goes for buffers, plenty of them are written by the gpu in one frame and read back in the next
+	for (int i = 0; i < m_resources.size(); i++)
+	{
+		auto &state = m_resourceStates[i];
+
+		state.aliasResolved = true;
+
+		if (m_resources[i].transient != -1)
+		{
+			// whatever was in the memory before is garbage now
+			state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			state.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			state.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+			state.aliasResolved = false;
+		}
+		else
+		{
+			state.layout = m_resources[i].image ? m_resources[i].image->getLayout() : VK_IMAGE_LAYOUT_UNDEFINED;
+			state.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			state.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+		}
+
+		state.readStages = VK_PIPELINE_STAGE_2_NONE;
+	}
+}
+
+int RenderGraph::getImageResource(Image *image)
 {
-	cauto &pass = m_renderPasses[handle.index];
+	if (m_imageResources.contains(image))
+		return m_imageResources.at(image);
+
+	Resource resource = {};
+	resource.image = image;
+	resource.transient = -1;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-	RenderInfo info;
+	int index = m_resources.size();
 
-	for (auto &attachment : pass.getAttachments())
+	for (int i = 0; i < m_transients.size(); i++)
 	{
-		const Image *image = attachment.view->getImage();
+		if (m_transients[i].image == image)
+		{
+			resource.transient = i;
+			m_transients[i].resource = index;
+			break;
+		}
+	}
+
+	m_resources.push_back(resource);
+	m_imageResources.insert({ image, index });
+
+	return index;
+}
+
+int RenderGraph::getSwapchainResource()
+{
+	if (m_swapchainResource != -1)
+		return m_swapchainResource;
+
+	// the image itself gets filled in every frame, and whatever ends up on screen is always needed
+	Resource resource = {};
+	resource.image = nullptr;
+	resource.transient = -1;
+	resource.isOutput = true;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	m_swapchainResource = m_resources.size();
+	m_resources.push_back(resource);
+
+	return m_swapchainResource;
+}
+
+int RenderGraph::getBufferResource(GPUBuffer *buffer)
+{
+	if (m_bufferResources.contains(buffer))
+		return m_bufferResources.at(buffer);
+
+	Resource resource = {};
+	resource.buffer = buffer;
+	resource.transient = -1;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	int index = m_resources.size();
+
+	m_resources.push_back(resource);
+	m_bufferResources.insert({ buffer, index });
+
+	return index;
+}
+
+void RenderGraph::gatherRenderPassAccesses(CompiledPass &pass)
+{
+	cauto &def = m_renderPasses[pass.handle.index];
+
+	for (cauto &attachment : def.getAttachments())
+	{
+		bool isDepth = !attachment.swapchain && attachment.view->getImage()->isDepth();
+		bool loads = attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+
+		ResourceAccess access = {};
+		access.write = true;
+		access.readsPrevious = loads;
+
+		if (isDepth)
+		{
+			access.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			access.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+			access.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		}
+		else
+		{
+			access.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			access.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			access.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+
+			if (loads)
+				access.access |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+		}
+
+		access.resource = attachment.swapchain ? getSwapchainResource() : getImageResource(attachment.view->getImage());
+		addAccess(pass, access);
+
+		// resolves happen in the attachment output stage too and overwrite the whole image
+		if (attachment.resolve)
+		{
+			access.resource = getImageResource(attachment.resolve->getImage());
+			access.readsPrevious = false;
+
+			addAccess(pass, access);
+		}
+	}
+
+	for (cauto &view : def.getInputViews())
+	{
+		ResourceAccess access = {};
+		access.resource = getImageResource(view->getImage());
+		access.layout = view->getImage()->isDepth() ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		access.stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		access.write = false;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+
+	for (cauto &buffer : def.getInputBuffers())
+	{
+		ResourceAccess access = {};
+		access.resource = getBufferResource(buffer);
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_READ_BIT;
+		access.write = false;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+
+	for (cauto &buffer : def.getStorageBuffers())
+	{
+		ResourceAccess access = {};
+		access.resource = getBufferResource(buffer);
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+		access.write = true;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+
+	for (cauto &buffer : def.getIndirectBuffers())
+	{
+		ResourceAccess access = {};
+		access.resource = getBufferResource(buffer);
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+		access.access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+		access.write = false;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+}
+
+void RenderGraph::gatherComputeTaskAccesses(CompiledPass &pass)
+{
+	cauto &def = m_computeTasks[pass.handle.index];
+
+	for (cauto &view : def.getStorageViews())
+	{
+		ResourceAccess access = {};
+		access.resource = getImageResource(view->getImage());
+		access.layout = VK_IMAGE_LAYOUT_GENERAL;
+		access.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		access.write = true;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+
+	for (cauto &view : def.getInputViews())
+	{
+		ResourceAccess access = {};
+		access.resource = getImageResource(view->getImage());
+		access.layout = view->getImage()->isDepth() ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		access.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		access.write = false;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+
+	for (cauto &buffer : def.getInputBuffers())
+	{
+		ResourceAccess access = {};
+		access.resource = getBufferResource(buffer);
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_READ_BIT;
+		access.write = false;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+
+	for (cauto &buffer : def.getStorageBuffers())
+	{
+		ResourceAccess access = {};
+		access.resource = getBufferResource(buffer);
+		access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		access.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		access.access = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+		access.write = true;
+		access.readsPrevious = true;
+
+		addAccess(pass, access);
+	}
+}
+
+void RenderGraph::addAccess(CompiledPass &pass, const ResourceAccess &access)
+{
+	// the same resource used twice in one pass gets folded into a single access
+	for (auto &other : pass.accesses)
+	{
+		if (other.resource != access.resource)
+			continue;
+
+		// attachments come first so their layout wins
+		mgp_ASSERT(other.layout == access.layout || other.write, "Resource used with two different layouts in the same pass.");
+
+		other.stages |= access.stages;
+		other.access |= access.access;
+		other.write |= access.write;
+		other.readsPrevious |= access.readsPrevious;
+
+		return;
+	}
+
+	pass.accesses.push_back(access);
+}
+
+void RenderGraph::buildDependencies()
+{
+	std::vector<int> lastWriter(m_resources.size(), -1);
+
+	for (int i = 0; i < m_compiledPasses.size(); i++)
+	{
+		auto &pass = m_compiledPasses[i];
+
+		for (cauto &access : pass.accesses)
+		{
+			int writer = lastWriter[access.resource];
+
+			if (access.readsPrevious && writer != -1)
+				pass.dependencies.push_back(writer);
+
+			if (access.write)
+				lastWriter[access.resource] = i;
+		}
+	}
+}
+
+void RenderGraph::cullPasses()
+{
+	std::vector<bool> live(m_compiledPasses.size(), false);
+	std::vector<int> stack;
+
+	std::vector<int> lastWriter(m_resources.size(), -1);
+
+	for (int i = 0; i < m_compiledPasses.size(); i++)
+	{
+		for (cauto &access : m_compiledPasses[i].accesses)
+		{
+			if (access.write)
+				lastWriter[access.resource] = i;
+		}
+	}
+
+	// the final writer of each output is where culling starts from
+	for (int i = 0; i < m_resources.size(); i++)
+	{
+		if (m_resources[i].isOutput && lastWriter[i] != -1)
+			stack.push_back(lastWriter[i]);
+	}
+
+	// walk back up from the outputs, anything we don't reach has no effect on them
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		if (live[index])
+			continue;
+
+		live[index] = true;
+
+		for (int dependency : m_compiledPasses[index].dependencies)
+			stack.push_back(dependency);
+	}
+
+	for (int i = 0; i < m_compiledPasses.size(); i++)
+		m_compiledPasses[i].culled = !live[i];
+}
+
+void RenderGraph::computeTransientLifetimes()
+{
+	for (auto &transient : m_transients)
+	{
+		transient.firstPass = -1;
+		transient.lastPass = -1;
+	}
+
+	for (int i = 0; i < m_compiledPasses.size(); i++)
+	{
+		cauto &pass = m_compiledPasses[i];
+
+		if (pass.culled)
+			continue;
+
+		for (cauto &access : pass.accesses)
+		{
+			int t = m_resources[access.resource].transient;
+
+			if (t == -1)
+				continue;
+
+			auto &transient = m_transients[t];
+
+			if (transient.firstPass == -1)
+				transient.firstPass = i;
+
+			transient.lastPass = i;
+		}
+	}
+
+	// anything still at -1 is never alive, so it can sit on top of whatever
+}
+
+void RenderGraph::allocateTransients()
+{
+	m_transientsAllocated = true;
+
+	if (m_transients.empty())
+		return;
+
+	// place the biggest images first, each one goes at the lowest offset that doesn't collide with anything alive at the same time
+	std::vector<int> order(m_transients.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	std::sort(order.begin(), order.end(), [&](int a, int b) -> bool {
+		return m_transients[a].requirements.size > m_transients[b].requirements.size;
+	});
+
+	m_transientPlacement++;
+
+	for (auto &transient : m_transients)
+	{
+		transient.placedFirstPass = transient.firstPass;
+		transient.placedLastPass = transient.lastPass;
+	}
+
+	std::vector<int> placed;
+
+	VkMemoryRequirements combined = {};
+	combined.alignment = 1;
+	combined.memoryTypeBits = ~0u;
+
+	m_transientMemoryUnaliased = 0;
+
+	for (int index : order)
+	{
+		auto &transient = m_transients[index];
+		cauto &requirements = transient.requirements;
+
+		std::vector<VkDeviceSize> candidates = { 0 };
+
+		for (int other : placed)
+		{
+			cauto &o = m_transients[other];
+			VkDeviceSize end = o.offset + o.requirements.size;
+
+			candidates.push_back((end + requirements.alignment - 1) / requirements.alignment * requirements.alignment);
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+
+		for (VkDeviceSize candidate : candidates)
+		{
+			transient.offset = candidate;
+
+			bool fits = true;
+
+			for (int other : placed)
+			{
+				if (transientsConflict(transient, m_transients[other]))
+				{
+					fits = false;
+					break;
+				}
+			}
+
+			if (fits)
+				break;
+		}
+
+		placed.push_back(index);
+
+		combined.size = std::max<VkDeviceSize>(combined.size, transient.offset + requirements.size);
+		combined.alignment = std::max<VkDeviceSize>(combined.alignment, requirements.alignment);
+		combined.memoryTypeBits &= requirements.memoryTypeBits;
+
+		m_transientMemoryUnaliased += requirements.size;
+	}
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+	allocInfo.priority = 1.0f;
+
+	if (combined.memoryTypeBits == 0)
+	{
+		// no memory type works for all of them (can happen with depth on some hardware) so give up on aliasing
+		mgp_LOG("Transient images have no common memory type, not aliasing them.");
+
+		for (auto &transient : m_transients)
+		{
+			VmaAllocation allocation = VK_NULL_HANDLE;
+
+			mgp_VK_CHECK(
+				vmaAllocateMemory(m_gfx->getVMAAllocator(), &transient.requirements, &allocInfo, &allocation, nullptr),
+				"Failed to allocate transient image memory"
+			);
+
+			transient.offset = 0;
+			transient.image->bindMemory(allocation, 0);
+
+			m_transientAllocations.push_back(allocation);
+		}
+
+		m_transientMemoryAliased = m_transientMemoryUnaliased;
+
+		return;
+	}
+
+	VmaAllocation allocation = VK_NULL_HANDLE;
+
+	mgp_VK_CHECK(
+		vmaAllocateMemory(m_gfx->getVMAAllocator(), &combined, &allocInfo, &allocation, nullptr),
+		"Failed to allocate transient image memory"
+	);
+
+	for (auto &transient : m_transients)
+		transient.image->bindMemory(allocation, transient.offset);
+
+	m_transientAllocations.push_back(allocation);
+
+	m_transientMemoryAliased = combined.size;
+
+	mgp_LOG("Placed %d transient images in %.2fMB (%.2fMB unaliased).", (int)m_transients.size(), m_transientMemoryAliased / (1024.0 * 1024.0), m_transientMemoryUnaliased / (1024.0 * 1024.0));
+}
+
+void RenderGraph::freeTransients()
+{
+	// images can't be bound to new memory, so they get fresh handles and whatever was in flight has to finish with the old ones first
+	m_gfx->waitIdle();
+
+	for (auto &allocation : m_transientAllocations)
+		vmaFreeMemory(m_gfx->getVMAAllocator(), allocation);
+
+	m_transientAllocations.clear();
+
+	for (auto &transient : m_transients)
+	{
+		transient.image->resetAliased();
+		transient.requirements = transient.image->getMemoryRequirements();
+	}
+
+	m_transientMemoryAliased = 0;
+	m_transientMemoryUnaliased = 0;
+}
+
+bool RenderGraph::transientsConflict(const TransientImage &a, const TransientImage &b) const
+{
+	if (a.firstPass == -1 || b.firstPass == -1)
+		return false;
+
+	bool aliveTogether = a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+
+	return aliveTogether && transientsShareMemory(a, b);
+}
+
+bool RenderGraph::transientsShareMemory(const TransientImage &a, const TransientImage &b) const
+{
+	return a.offset < b.offset + b.requirements.size && b.offset < a.offset + a.requirements.size;
+}
+
+void RenderGraph::computeAsyncBatches()
+{
+	int batch = -1;
+
+	// consecutive async tasks go to the compute queue together, anything in between splits them up
+	for (int i = 0; i < m_compiledPasses.size(); i++)
+	{
+		auto &pass = m_compiledPasses[i];
+
+		if (pass.culled)
+			continue;
+
+		if (!pass.async)
+		{
+			batch = -1;
+			continue;
+		}
+
+		if (batch == -1)
+			batch = i;
+
+		auto &resources = m_compiledPasses[batch].batchResources;
+
+		for (cauto &access : pass.accesses)
+		{
+			mgp_ASSERT(access.resource != m_swapchainResource, "The swapchain can't be used on the compute queue.");
+
+			if (std::find(resources.begin(), resources.end(), access.resource) == resources.end())
+				resources.push_back(access.resource);
+		}
+	}
+}
+
+CommandBuffer *RenderGraph::beginAsyncBatch(CommandBuffer *cmd, int index)
+{
+	// keep it to one batch on the compute queue at a time
+	if (m_asyncBatch != -1)
+		joinAsyncBatch(cmd);
+
+	cauto &resources = m_compiledPasses[index].batchResources;
+
+	uint32_t graphicsFamily = m_gfx->getGraphicsQueue().getFamilyIndex();
+	uint32_t computeFamily = m_gfx->getComputeQueue().getFamilyIndex();
+
+	// whatever had the memory of a transient before is covered by the semaphore, so there's nothing left to wait on
+	for (int r : resources)
+		m_resourceStates[r].aliasResolved = true;
+
+	transferOwnership(cmd, resources, graphicsFamily, computeFamily, false);
+
+	m_gfx->flushFrame();
+
+	CommandBuffer *computeCmd = m_gfx->beginAsyncCompute();
+
+	transferOwnership(computeCmd, resources, graphicsFamily, computeFamily, true);
+	resetBorrowedStates(resources);
+
+	m_asyncBatch = index;
+	m_stats.asyncBatchCount++;
+
+	return computeCmd;
+}
+
+void RenderGraph::endAsyncBatch(CommandBuffer *computeCmd)
+{
+	cauto &resources = m_compiledPasses[m_asyncBatch].batchResources;
+
+	// hand everything straight back, the graphics side picks it up again in joinAsyncBatch()
+	transferOwnership(computeCmd, resources, m_gfx->getComputeQueue().getFamilyIndex(), m_gfx->getGraphicsQueue().getFamilyIndex(), false);
+
+	m_asyncBatchValue = m_gfx->submitAsyncCompute(computeCmd);
+	m_passesSinceAsyncBatch = 0;
+}
+
+void RenderGraph::joinAsyncBatch(CommandBuffer *cmd)
+{
+	cauto &resources = m_compiledPasses[m_asyncBatch].batchResources;
+
+	// graphics work recorded since the batch went off doesn't need it, so let that run without waiting
+	if (m_passesSinceAsyncBatch > 0 && !m_swapchainRecorded)
+		m_gfx->flushFrame();
+
+	m_gfx->waitForAsyncCompute(m_asyncBatchValue);
+
+	transferOwnership(cmd, resources, m_gfx->getComputeQueue().getFamilyIndex(), m_gfx->getGraphicsQueue().getFamilyIndex(), true);
+	resetBorrowedStates(resources);
+
+	m_asyncBatch = -1;
+}
+
+bool RenderGraph::dependsOnAsyncBatch(const CompiledPass &pass) const
+{
+	cauto &resources = m_compiledPasses[m_asyncBatch].batchResources;
+
+	for (cauto &access : pass.accesses)
+	{
+		int transient = m_resources[access.resource].transient;
+
+		for (int r : resources)
+		{
+			if (r == access.resource)
+				return true;
+
+			// reusing the memory of a transient the compute queue still has counts too
+			int other = m_resources[r].transient;
+
+			if (transient != -1 && other != -1 && transientsShareMemory(m_transients[transient], m_transients[other]))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void RenderGraph::transferOwnership(CommandBuffer *cmd, const std::vector<int> &resources, uint32_t srcFamily, uint32_t dstFamily, bool acquire)
+{
+	m_imageBarriers.clear();
+	m_bufferBarriers.clear();
+
+	for (int r : resources)
+	{
+		cauto &resource = m_resources[r];
+		cauto &state = m_resourceStates[r];
+
+		// the release waits on the last use on the old queue, the acquire makes it visible to everything on the new one
+		VkPipelineStageFlags2 srcStages = acquire ? VK_PIPELINE_STAGE_2_NONE : state.writeStages | state.readStages;
+		VkAccessFlags2 srcAccess = acquire ? VK_ACCESS_2_NONE : state.writeAccess;
+		VkPipelineStageFlags2 dstStages = acquire ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 dstAccess = acquire ? VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT : VK_ACCESS_2_NONE;
+
+		if (resource.image)
+		{
+			// no contents worth keeping, the other queue can just take it
+			if (state.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+				continue;
+
+			// the layout stays the same, any transition happens afterwards in flushBarriers()
+			VkImageMemoryBarrier2 barrier = resource.image->getBarrier(state.layout);
+			barrier.oldLayout = state.layout;
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dstStages;
+			barrier.dstAccessMask = dstAccess;
+
+			m_imageBarriers.push_back(barrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier2 barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dstStages;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.buffer = resource.buffer->getHandle();
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+
+			m_bufferBarriers.push_back(barrier);
+		}
+	}
+
+	if (m_imageBarriers.empty() && m_bufferBarriers.empty())
+		return;
+
+	cmd->pipelineBarrier(0, {}, m_bufferBarriers, m_imageBarriers);
+
+	m_stats.barrierBatchCount++;
+	m_stats.imageBarrierCount += m_imageBarriers.size();
+	m_stats.bufferBarrierCount += m_bufferBarriers.size();
+
+	if (!acquire)
+		m_stats.queueTransferCount += m_imageBarriers.size() + m_bufferBarriers.size();
+}
+
+void RenderGraph::resetBorrowedStates(const std::vector<int> &resources)
+{
+	// the semaphore between the queues already waited on everything, there's nothing left for later barriers to chain off
+	for (int r : resources)
+	{
+		auto &state = m_resourceStates[r];
+
+		state.writeStages = VK_PIPELINE_STAGE_2_NONE;
+		state.writeAccess = VK_ACCESS_2_NONE;
+		state.readStages = VK_PIPELINE_STAGE_2_NONE;
+	}
+}
+
+void RenderGraph::flushBarriers(CommandBuffer *cmd, const std::vector<ResourceAccess> &accesses)
+{
+	m_imageBarriers.clear();
+	m_bufferBarriers.clear();
+
+	for (cauto &access : accesses)
+	{
+		cauto &resource = m_resources[access.resource];
+		auto &state = m_resourceStates[access.resource];
+
+		if (!state.aliasResolved)
+		{
+			cauto &transient = m_transients[resource.transient];
+
+			VkPipelineStageFlags2 previousStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 previousAccess = VK_ACCESS_2_NONE;
+
+			// find the images that had this memory earlier in the frame and wait on their last use instead of everything
+			for (cauto &other : m_transients)
+			{
+				if (&other == &transient || other.resource == -1 || other.firstPass == -1 || other.lastPass >= transient.firstPass)
+					continue;
+
+				bool sharesMemory = other.offset < transient.offset + transient.requirements.size && transient.offset < other.offset + other.requirements.size;
+
+				if (!sharesMemory)
+					continue;
+
+				cauto &otherState = m_resourceStates[other.resource];
+
+				previousStages |= otherState.writeStages | otherState.readStages;
+				previousAccess |= otherState.writeAccess;
+			}
+
+			if (previousStages != VK_PIPELINE_STAGE_2_NONE)
+			{
+				state.writeStages = previousStages;
+				state.writeAccess = previousAccess;
+			}
+
+			state.aliasResolved = true;
+		}
+
+		VkImageLayout oldLayout = state.layout;
+
+		bool layoutChange = resource.image && state.layout != access.layout;
+
+		VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+
+		if (layoutChange || access.write)
+		{
+			// layout transitions and writes have to wait for everything before them
+			// though write-after-read only needs an execution dependency
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+		}
+		else if ((state.readStages & access.stages) != access.stages)
+		{
+			// read-after-write, and this stage hasn't waited on the write yet
+			srcStages = state.writeStages;
+			srcAccess = state.writeAccess;
+		}
+
+		if (access.write)
+		{
+			state.writeStages = access.stages;
+			state.writeAccess = access.access;
+			state.readStages = VK_PIPELINE_STAGE_2_NONE;
+		}
+		else if (layoutChange)
+		{
+			// the transition itself counts as the last write, later readers can chain off it
+			state.writeStages = access.stages;
+			state.writeAccess = VK_ACCESS_2_NONE;
+			state.readStages = access.stages;
+		}
+		else
+		{
+			state.readStages |= access.stages;
+		}
+
+		state.layout = access.layout;
+
+		// read-after-read or nothing has touched it on the gpu yet
+		if (!layoutChange && srcStages == VK_PIPELINE_STAGE_2_NONE)
+			continue;
+
+		if (resource.image)
+		{
+			VkImageMemoryBarrier2 barrier = resource.image->getBarrier(access.layout);
+			barrier.oldLayout = oldLayout;
+
+			// the old contents are about to be cleared anyway
+			if (!access.readsPrevious)
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = access.stages;
+			barrier.dstAccessMask = access.access;
+
+			m_imageBarriers.push_back(barrier);
+
+			resource.image->m_layout = access.layout;
+		}
+		else
+		{
+			VkBufferMemoryBarrier2 barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = access.stages;
+			barrier.dstAccessMask = access.access;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = resource.buffer->getHandle();
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+
+			m_bufferBarriers.push_back(barrier);
+		}
+	}
+
+	if (m_imageBarriers.empty() && m_bufferBarriers.empty())
+		return;
+
+	cmd->pipelineBarrier(0, {}, m_bufferBarriers, m_imageBarriers);
+
+	m_stats.barrierBatchCount++;
+	m_stats.imageBarrierCount += m_imageBarriers.size();
+	m_stats.bufferBarrierCount += m_bufferBarriers.size();
+}
+
+void RenderGraph::flushFinalBarriers(CommandBuffer *cmd)
+{
+	m_imageBarriers.clear();
+
+	for (int i = 0; i < m_resources.size(); i++)
+	{
+		cauto &resource = m_resources[i];
+		cauto &state = m_resourceStates[i];
+
+		if (!resource.image || !resource.isOutput)
+			continue;
+
+		if (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout)
+			continue;
+
+		// we don't know who reads it next so this one has to be conservative
+		VkImageMemoryBarrier2 barrier = resource.image->getBarrier(resource.finalLayout);
+		barrier.srcStageMask = state.writeStages | state.readStages;
+		barrier.srcAccessMask = state.writeAccess;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+		m_imageBarriers.push_back(barrier);
+
+		resource.image->m_layout = resource.finalLayout;
+	}
+
+	if (m_imageBarriers.empty())
+		return;
+
+	cmd->pipelineBarrier(0, {}, {}, m_imageBarriers);
+
+	m_stats.barrierBatchCount++;
+	m_stats.imageBarrierCount += m_imageBarriers.size();
+}
+
+void RenderGraph::buildRenderInfo(CompiledPass &pass, Swapchain *swapchain)
+{
+	cauto &def = m_renderPasses[pass.handle.index];
+
+	RenderInfo &info = pass.renderInfo;
+
+	for (auto &attachment : def.getAttachments())
+	{
+		ImageView *view = attachment.view;
+
+		if (attachment.swapchain)
+		{
+			view = swapchain->getCurrentView();
+			pass.swapchainAttachment = info.getColourAttachments().size();
+		}
+
+		const Image *image = view->getImage();
 
 		// currently we assume all attachments have the same size and MSAA sample count
 		// however, in the future, we could try to automatically resize all attachments
@@ -112,67 +1183,40 @@ void RenderGraph::handleRenderPass(CommandBuffer *cmd, Swapchain *swapchain, con
 		{
 			info.addDepthAttachment(
 				attachment.loadOp,
-				attachment.view,
+				view,
 				attachment.resolve,
 				attachment.depthClear,
 				attachment.stencilClear
 			);
-
-			cmd->transitionLayout(
-				attachment.view->getImage(),
-				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-			);
 		}
 		else
 		{
 			info.addColourAttachment(
 				attachment.loadOp,
-				attachment.view,
+				view,
 				attachment.resolve,
 				attachment.colourClear
 			);
-
-			cmd->transitionLayout(
-				attachment.view->getImage(),
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-			);
 		}
 	}
 
-	for (cauto &view : pass.getInputViews())
-	{
-		if (view->getImage()->isDepth())
-		{
-			cmd->transitionLayout(
-				view->getImage(),
-				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
-			);
-		}
-		else
-		{
-			cmd->transitionLayout(
-				view->getImage(),
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			);
-		}
-	}
+}
 
-	cmd->beginRendering(info);
-	pass.getRecordFn()(cmd, info);
+void RenderGraph::handleRenderPass(CommandBuffer *cmd, Swapchain *swapchain, CompiledPass &pass)
+{
+	cauto &def = m_renderPasses[pass.handle.index];
+
+	if (pass.swapchainAttachment != -1)
+		pass.renderInfo.setColourAttachmentView(pass.swapchainAttachment, swapchain->getCurrentView());
+
+	cmd->beginRendering(pass.renderInfo);
+	def.getRecordFn()(cmd, pass.renderInfo);
 	cmd->endRendering();
 }
 
-void RenderGraph::handleComputeTask(CommandBuffer *cmd, Swapchain *swapchain, const PassHandle &handle)
+void RenderGraph::handleComputeTask(CommandBuffer *cmd, Swapchain *swapchain, const CompiledPass &pass)
 {
-	cauto &task = m_computeTasks[handle.index];
-
-	for (cauto &view : task.getStorageViews())
-	{
-		cmd->transitionLayout(
-			view->getImage(),
-			VK_IMAGE_LAYOUT_GENERAL
-		);
-	}
+	cauto &task = m_computeTasks[pass.handle.index];
 
 	task.getRecordFn()(cmd);
 }
@@ -197,6 +1241,53 @@ void RenderGraph::addTask(const ComputeTaskDef &taskDef)
 	m_passes.push_back(handle);
 }
 
+void RenderGraph::addOutput(Image *image, VkImageLayout finalLayout)
+{
+	int index = getImageResource(image);
+
+	m_resources[index].isOutput = true;
+	m_resources[index].finalLayout = finalLayout;
+}
+
+void RenderGraph::addOutput(GPUBuffer *buffer)
+{
+	int index = getBufferResource(buffer);
+
+	m_resources[index].isOutput = true;
+}
+
+Image *RenderGraph::createTransientImage(uint32_t width, uint32_t height, VkFormat format, VkSampleCountFlagBits samples, bool storage)
+{
+	mgp_ASSERT(!m_transientsAllocated, "Transient images have to be created before the graph is first recorded.");
+
+	Image *image = new Image();
+
+	image->createAliased(
+		m_gfx,
+		width, height, 1,
+		format,
+		VK_IMAGE_VIEW_TYPE_2D,
+		VK_IMAGE_TILING_OPTIMAL,
+		1,
+		samples,
+		storage
+	);
+
+	TransientImage transient = {};
+	transient.image = image;
+	transient.requirements = image->getMemoryRequirements();
+	transient.offset = 0;
+	transient.firstPass = -1;
+	transient.lastPass = -1;
+	transient.placedFirstPass = -1;
+	transient.placedLastPass = -1;
+	transient.resource = -1;
+
+	m_transients.push_back(transient);
+
+	return image;
+}
+
 /*
 std::vector<RenderGraph::PassHandle> RenderGraph::flattenGraphRecursive(const PassHandle &handle)
 {
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 #include <functional>
 
 #include <Volk/volk.h>
+#include <vma/vk_mem_alloc.h>
 
 #include "render_info.h"
 
@@ -11,12 +13,15 @@ namespace mgp
 {
 	class GraphicsCore;
 	class Swapchain;
+	class GPUBuffer;
 
 	struct RenderGraphAttachment
 	{
 		ImageView *view;
 		ImageView *resolve;
 
+		bool swapchain; // view is whichever swapchain image is current when the graph is recorded
+
 		VkResolveModeFlagBits resolveMode;
 
 		VkAttachmentLoadOp loadOp;
@@ -53,6 +58,14 @@ namespace mgp
 
 			return attachment;
 		}
+
+		static RenderGraphAttachment getSwapchain(VkAttachmentLoadOp loadOp, const Colour &colourClear = Colour::black())
+		{
+			RenderGraphAttachment attachment = getColour(loadOp, nullptr, nullptr, colourClear);
+			attachment.swapchain = true;
+
+			return attachment;
+		}
 	};
 
 	class RenderPassDef
@@ -73,6 +86,27 @@ namespace mgp
 			return *this;
 		}
 
+		// buffers read by the vertex / fragment shaders
+		RenderPassDef &setInputBuffers(const std::vector<GPUBuffer *> &buffers)
+		{
+			m_inputBuffers = buffers;
+			return *this;
+		}
+
+		// buffers written by the vertex / fragment shaders
+		RenderPassDef &setStorageBuffers(const std::vector<GPUBuffer *> &buffers)
+		{
+			m_storageBuffers = buffers;
+			return *this;
+		}
+
+		// buffers the draw calls themselves read their arguments / counts from
+		RenderPassDef &setIndirectBuffers(const std::vector<GPUBuffer *> &buffers)
+		{
+			m_indirectBuffers = buffers;
+			return *this;
+		}
+
 		RenderPassDef &setRecordFn(const std::function<void(CommandBuffer *, const RenderInfo &)> &fn)
 		{
 			m_recordFn = fn;
@@ -89,6 +123,21 @@ namespace mgp
 			return m_views;
 		}
 
+		const std::vector<GPUBuffer *> &getInputBuffers() const
+		{
+			return m_inputBuffers;
+		}
+
+		const std::vector<GPUBuffer *> &getStorageBuffers() const
+		{
+			return m_storageBuffers;
+		}
+
+		const std::vector<GPUBuffer *> &getIndirectBuffers() const
+		{
+			return m_indirectBuffers;
+		}
+
 		const std::function<void(CommandBuffer *, const RenderInfo &)> &getRecordFn() const
 		{
 			return m_recordFn;
@@ -97,6 +146,9 @@ namespace mgp
 	private:
 		std::vector<RenderGraphAttachment> m_attachments;
 		std::vector<ImageView *> m_views;
+		std::vector<GPUBuffer *> m_inputBuffers;
+		std::vector<GPUBuffer *> m_storageBuffers;
+		std::vector<GPUBuffer *> m_indirectBuffers;
 		std::function<void(CommandBuffer *, const RenderInfo &)> m_recordFn = nullptr;
 	};
 
@@ -106,31 +158,98 @@ namespace mgp
 		ComputeTaskDef() = default;
 		~ComputeTaskDef() = default;
 			
+		// read-write images
 		ComputeTaskDef &setStorageViews(const std::vector<ImageView *> &views)
 		{
 			m_storageViews = views;
 			return *this;
 		}
 
+		// sampled images
+		ComputeTaskDef &setInputViews(const std::vector<ImageView *> &views)
+		{
+			m_inputViews = views;
+			return *this;
+		}
+
+		ComputeTaskDef &setInputBuffers(const std::vector<GPUBuffer *> &buffers)
+		{
+			m_inputBuffers = buffers;
+			return *this;
+		}
+
+		ComputeTaskDef &setStorageBuffers(const std::vector<GPUBuffer *> &buffers)
+		{
+			m_storageBuffers = buffers;
+			return *this;
+		}
+
 		ComputeTaskDef &setRecordFn(const std::function<void(CommandBuffer *)> &fn)
 		{
 			m_recordFn = fn;
 			return *this;
 		}
 
+		// run on the dedicated compute queue if there is one, graphics work that doesn't depend on it keeps going meanwhile
+		ComputeTaskDef &setAsyncCompute(bool async)
+		{
+			m_async = async;
+			return *this;
+		}
+
 		const std::vector<ImageView *> &getStorageViews() const
 		{
 			return m_storageViews;
 		}
 
+		const std::vector<ImageView *> &getInputViews() const
+		{
+			return m_inputViews;
+		}
+
+		const std::vector<GPUBuffer *> &getInputBuffers() const
+		{
+			return m_inputBuffers;
+		}
+
+		const std::vector<GPUBuffer *> &getStorageBuffers() const
+		{
+			return m_storageBuffers;
+		}
+
 		const std::function<void(CommandBuffer *)> &getRecordFn() const
 		{
 			return m_recordFn;
 		}
 
+		bool isAsyncCompute() const
+		{
+			return m_async;
+		}
+
 	private:
 		std::vector<ImageView *> m_storageViews;
+		std::vector<ImageView *> m_inputViews;
+		std::vector<GPUBuffer *> m_inputBuffers;
+		std::vector<GPUBuffer *> m_storageBuffers;
 		std::function<void(CommandBuffer *)> m_recordFn = nullptr;
+		bool m_async = false;
+	};
+
+	struct RenderGraphStats
+	{
+		uint32_t passCount;
+		uint32_t culledPassCount;
+
+		uint32_t barrierBatchCount;
+		uint32_t imageBarrierCount;
+		uint32_t bufferBarrierCount;
+
+		uint64_t transientMemoryAliased;
+		uint64_t transientMemoryUnaliased;
+
+		uint32_t asyncBatchCount;
+		uint32_t queueTransferCount;
 	};
 
 	class RenderGraph
@@ -156,26 +275,192 @@ namespace mgp
 			bool operator != (const PassHandle &other) { return this->type != other.type || this->index != other.index; }
 		};
 
+		// a single use of a resource by a pass
+		struct ResourceAccess
+		{
+			int resource;
+
+			VkImageLayout layout;
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+
+			bool write;
+			bool readsPrevious; // false if the previous contents get cleared / discarded
+		};
+
+		struct Resource
+		{
+			Image *image;
+			GPUBuffer *buffer;
+
+			int transient; // index into m_transients, or -1
+
+			bool isOutput;
+			VkImageLayout finalLayout;
+		};
+
+		// where a resource was last left on the gpu while recording
+		struct ResourceState
+		{
+			VkImageLayout layout;
+
+			// the last write still in flight
+			VkPipelineStageFlags2 writeStages;
+			VkAccessFlags2 writeAccess;
+
+			// stages that have already waited on that write
+			VkPipelineStageFlags2 readStages;
+
+			// transient images first have to wait on whatever used their memory before them
+			bool aliasResolved;
+		};
+
+		struct TransientImage
+		{
+			Image *image;
+			VkMemoryRequirements requirements;
+			VkDeviceSize offset;
+
+			// first and last (unculled) pass using it this frame, -1 if nothing uses it
+			int firstPass;
+			int lastPass;
+
+			// the lifetime its offset was picked for
+			int placedFirstPass;
+			int placedLastPass;
+
+			int resource;
+		};
+
+		struct CompiledPass
+		{
+			PassHandle handle;
+
+			std::vector<ResourceAccess> accesses;
+			std::vector<int> dependencies;
+
+			bool culled;
+
+			bool async;
+
+			// only filled on the first pass of each run of async compute tasks, every resource the run touches
+			std::vector<int> batchResources;
+
+			// built once at compile time, only the swapchain view gets patched each frame
+			RenderInfo renderInfo;
+			int swapchainAttachment;
+		};
+
 	public:
 		RenderGraph(GraphicsCore *gfx);
-		~RenderGraph() = default;
+		~RenderGraph();
 
+		// compiles the graph the first time round, after that the compiled result is reused every frame
+		// until invalidate() is called, so record functions should read anything that changes per-frame themselves
 		void recordTo(CommandBuffer *cmd, Swapchain *swapchain);
 
+		// throws away all passes, call this whenever the structure of the graph changes and then add them again
+		void invalidate();
+
+		bool isCompiled() const { return m_compiled; }
+
 		void addPass(const RenderPassDef &passDef);
 		void addTask(const ComputeTaskDef &taskDef);
 
+		// marks an image as used outside of the graph so passes writing to it don't get culled
+		// it's left in finalLayout once the graph is done
+		void addOutput(Image *image, VkImageLayout finalLayout);
+		void addOutput(GPUBuffer *buffer);
+
+		// an image that's only needed for part of the frame, owned by the graph
+		// once the graph has seen which passes use it, transients that are never alive at the same time share memory
+		Image *createTransientImage(uint32_t width, uint32_t height, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, bool storage = false);
+
+		const RenderGraphStats &getStats() const { return m_stats; }
+
+		// bumped every time transients get placed, their images (and so their views) are new after that
+		uint32_t getTransientPlacement() const { return m_transientPlacement; }
+
 	private:
 		GraphicsCore *m_gfx;
 
 		bool validate() const;
 
-		void handleRenderPass(CommandBuffer *cmd, Swapchain *swapchain, const PassHandle &handle);
-		void handleComputeTask(CommandBuffer *cmd, Swapchain *swapchain, const PassHandle &handle);
+		void compile(Swapchain *swapchain);
+		void resetResourceStates();
+
+		int getImageResource(Image *image);
+		int getBufferResource(GPUBuffer *buffer);
+		int getSwapchainResource();
+
+		void gatherRenderPassAccesses(CompiledPass &pass);
+		void gatherComputeTaskAccesses(CompiledPass &pass);
+
+		void addAccess(CompiledPass &pass, const ResourceAccess &access);
+
+		void buildDependencies();
+		void cullPasses();
+
+		void computeTransientLifetimes();
+		void allocateTransients();
+		void freeTransients();
+		bool transientsConflict(const TransientImage &a, const TransientImage &b) const;
+		bool transientsShareMemory(const TransientImage &a, const TransientImage &b) const;
+
+		void computeAsyncBatches();
+
+		CommandBuffer *beginAsyncBatch(CommandBuffer *cmd, int index);
+		void endAsyncBatch(CommandBuffer *computeCmd);
+		void joinAsyncBatch(CommandBuffer *cmd);
+		bool dependsOnAsyncBatch(const CompiledPass &pass) const;
+
+		void transferOwnership(CommandBuffer *cmd, const std::vector<int> &resources, uint32_t srcFamily, uint32_t dstFamily, bool acquire);
+		void resetBorrowedStates(const std::vector<int> &resources);
+
+		void flushBarriers(CommandBuffer *cmd, const std::vector<ResourceAccess> &accesses);
+		void flushFinalBarriers(CommandBuffer *cmd);
+
+		void buildRenderInfo(CompiledPass &pass, Swapchain *swapchain);
+
+		void handleRenderPass(CommandBuffer *cmd, Swapchain *swapchain, CompiledPass &pass);
+		void handleComputeTask(CommandBuffer *cmd, Swapchain *swapchain, const CompiledPass &pass);
 		
 		std::vector<PassHandle> m_passes;
 
 		std::vector<RenderPassDef> m_renderPasses;
 		std::vector<ComputeTaskDef> m_computeTasks;
+
+		std::vector<CompiledPass> m_compiledPasses;
+		bool m_compiled;
+
+		std::vector<Resource> m_resources;
+		std::vector<ResourceState> m_resourceStates;
+
+		std::unordered_map<Image *, int> m_imageResources;
+		std::unordered_map<GPUBuffer *, int> m_bufferResources;
+
+		int m_swapchainResource;
+
+		// the batch currently running on the compute queue (index of its first pass) and the value it signals when done
+		int m_asyncBatch;
+		uint64_t m_asyncBatchValue;
+		int m_passesSinceAsyncBatch;
+
+		// once something's drawn to the swapchain the rest of the frame has to stay in the presenting submission
+		bool m_swapchainRecorded;
+
+		// kept around so recording doesn't allocate
+		std::vector<VkImageMemoryBarrier2> m_imageBarriers;
+		std::vector<VkBufferMemoryBarrier2> m_bufferBarriers;
+
+		std::vector<TransientImage> m_transients;
+		std::vector<VmaAllocation> m_transientAllocations;
+		bool m_transientsAllocated;
+		uint32_t m_transientPlacement;
+
+		uint64_t m_transientMemoryAliased;
+		uint64_t m_transientMemoryUnaliased;
+
+		RenderGraphStats m_stats;
 	};
 }
@@ -81,6 +81,12 @@ namespace mgp
 		}
 
 		const std::vector<VkRenderingAttachmentInfo> &getColourAttachments() const { return m_colourAttachments; }
+
+		// swaps the view without touching anything else, the format has to stay the same
+		void setColourAttachmentView(int idx, ImageView *view)
+		{
+			m_colourAttachments[idx].imageView = view->getHandle();
+		}
 		const VkRenderingAttachmentInfo &getDepthAttachment() const { return m_depthAttachment; }
 
 		void setClearColour(int idx, const Colour &colour)
@@ -107,6 +113,12 @@ namespace mgp
 			return m_colourFormats;
 		}
 
+		// only the formats, enough to build a pipeline against without any real attachments
+		void setColourAttachmentFormats(const std::vector<VkFormat> &formats)
+		{
+			m_colourFormats = formats;
+		}
+
 		void setSize(uint32_t width, uint32_t height)
 		{
 			m_width = width;
@@ -146,6 +158,19 @@ namespace mgp
 			return h;
 		}
 
+		// only what a pipeline actually depends on, so the same pipeline gets reused across different attachments
+		uint64_t getPipelineHash() const
+		{
+			uint64_t h = 0;
+
+			hash::combine(&h, &m_samples);
+
+			for (auto &f : m_colourFormats)
+				hash::combine(&h, &f);
+
+			return h;
+		}
+
 	private:
 		uint32_t m_width;
 		uint32_t m_height;
@@ -15,6 +15,8 @@ using namespace mgp;
 const char *VERTEX_ENTRY_POINT = "vertexMain";
 const char *FRAGMENT_ENTRY_POINT = "fragmentMain";
 const char *COMPUTE_ENTRY_POINT = "computeMain";
+const char *TASK_ENTRY_POINT = "taskMain";
+const char *MESH_ENTRY_POINT = "meshMain";
 
 const char *getShaderStageName(VkShaderStageFlagBits stage)
 {
@@ -29,6 +31,12 @@ const char *getShaderStageName(VkShaderStageFlagBits stage)
 		case VK_SHADER_STAGE_COMPUTE_BIT:
 			return COMPUTE_ENTRY_POINT;
 
+		case VK_SHADER_STAGE_TASK_BIT_EXT:
+			return TASK_ENTRY_POINT;
+
+		case VK_SHADER_STAGE_MESH_BIT_EXT:
+			return MESH_ENTRY_POINT;
+
 		default:
 			mgp_ERROR("Unsupported shader stage: %d", stage);
 			break;
@@ -139,6 +147,7 @@ void ShaderStage::compileFromSource(const std::string &path)
 
 Shader::Shader(GraphicsCore *gfx, uint64_t pushConstantSize, const std::vector<DescriptorLayout *> &layouts, const std::vector<ShaderStage *> &stages)
 	: m_gfx(gfx)
+	, m_name()
 	, m_pushConstantSize(pushConstantSize)
 	, m_layouts(layouts)
 	, m_stages(stages)
@@ -216,7 +225,32 @@ uint64_t Shader::getPushConstantSize() const
 	return m_pushConstantSize;
 }
 
+VkShaderStageFlags Shader::getPushConstantStages() const
+{
+	if (m_stages[0]->getType() == VK_SHADER_STAGE_COMPUTE_BIT)
+		return VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// ALL_GRAPHICS doesn't include the mesh stages, and they can't be named at all on devices without them
+	for (cauto &stage : m_stages)
+	{
+		if (stage->getType() == VK_SHADER_STAGE_TASK_BIT_EXT || stage->getType() == VK_SHADER_STAGE_MESH_BIT_EXT)
+			return VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
+
+	return VK_SHADER_STAGE_ALL_GRAPHICS;
+}
+
 const std::vector<DescriptorLayout *> &Shader::getLayouts() const
 {
 	return m_layouts;
 }
+
+void Shader::setName(const std::string &name)
+{
+	m_name = name;
+}
+
+const std::string &Shader::getName() const
+{
+	return m_name;
+}
@@ -45,11 +45,19 @@ namespace mgp
 
 		const std::vector<ShaderStage *> &getStages() const;
 		uint64_t getPushConstantSize() const;
+
+		// what the push constant range covers, anything pushing to a pipeline made from this shader has to match it exactly
+		VkShaderStageFlags getPushConstantStages() const;
 		const std::vector<DescriptorLayout *> &getLayouts() const;
 
+		void setName(const std::string &name);
+		const std::string &getName() const;
+
 	private:
 		GraphicsCore *m_gfx;
 
+		std::string m_name;
+
 		std::vector<ShaderStage *> m_stages;
 
 		uint64_t m_pushConstantSize;
@@ -2,6 +2,8 @@
 
 #include "core/common.h"
 
+#include "platform/platform_core.h"
+
 #include "graphics_core.h"
 #include "toolbox.h"
 #include "command_buffer.h"
@@ -38,9 +40,24 @@ void Swapchain::destroy()
 		delete i;
 	}
 
+	m_swapchainImageViews.clear();
+
+	// the offscreen ring owns its images and has nothing else to clean up
+	if (m_gfx->isHeadless())
+	{
+		m_swapchainImages.clear();
+		return;
+	}
+
+	for (auto &s : m_renderFinishedSemaphores)
+	{
+		vkDestroySemaphore(m_gfx->getLogicalDevice(), s, nullptr);
+	}
+
+	m_renderFinishedSemaphores.clear();
+
 	for (int i = 0; i < gfx_constants::FRAMES_IN_FLIGHT; i++)
 	{
-		vkDestroySemaphore(m_gfx->getLogicalDevice(), m_renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(m_gfx->getLogicalDevice(), m_imageAvailableSemaphores[i], nullptr);
 	}
 
@@ -49,6 +66,13 @@ void Swapchain::destroy()
 
 void Swapchain::acquireNextImage()
 {
+	// the ring is indexed by frame so the image is already free once the frame has been waited on
+	if (m_gfx->isHeadless())
+	{
+		m_currSwapchainImageIdx = m_gfx->getCurrentFrameIndex();
+		return;
+	}
+
 	// try to get the next image
 	// if it is deemed out of date then rebuild the swap chain
 	// otherwise this is an unknown issue and throw an error
@@ -88,6 +112,12 @@ unsigned Swapchain::getCurrentSwapchainImageIndex() const
 
 void Swapchain::createSwapchain()
 {
+	if (m_gfx->isHeadless())
+	{
+		createOffscreenImages();
+		return;
+	}
+
 	SwapchainSupportDetails details = vk_toolbox::querySwapChainSupport(m_gfx->getPhysicalDevice(), m_gfx->getSurface().getHandle());
 
 	// get the surface settings
@@ -174,6 +204,40 @@ void Swapchain::createSwapchain()
 	mgp_LOG("Created the swap chain!");
 }
 
+void Swapchain::createOffscreenImages()
+{
+	glm::ivec2 size = m_platform->getWindowSizeInPixels();
+
+	m_width = size.x;
+	m_height = size.y;
+
+	// rgba so that readback can go straight into a bitmap
+	m_swapchainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+	m_swapchainImages.resize(gfx_constants::FRAMES_IN_FLIGHT);
+
+	for (int i = 0; i < m_swapchainImages.size(); i++)
+	{
+		Image &image = m_swapchainImages[i];
+
+		image.allocate(
+			m_gfx,
+			m_width, m_height, 1,
+			m_swapchainImageFormat,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			false,
+			false
+		);
+
+		m_swapchainImageViews.push_back(m_gfx->createImageView(&image, image.getLayerCount(), 0, 0));
+	}
+
+	mgp_LOG("Created the offscreen image ring!");
+}
+
 void Swapchain::createSwapchainSyncObjects()
 {
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
@@ -186,7 +250,14 @@ void Swapchain::createSwapchainSyncObjects()
 			vkCreateSemaphore(m_gfx->getLogicalDevice(), &semaphoreCreateInfo, nullptr, &m_imageAvailableSemaphores[i]),
 			"Failed to create image available semaphore"
 		);
+	}
 
+	// the presentation engine waits on these outside of the frame timeline
+	// so they have to belong to the swapchain image rather than the frame
+	m_renderFinishedSemaphores.resize(m_swapchainImages.size());
+
+	for (int i = 0; i < m_renderFinishedSemaphores.size(); i++)
+	{
 		mgp_VK_CHECK(
 			vkCreateSemaphore(m_gfx->getLogicalDevice(), &semaphoreCreateInfo, nullptr, &m_renderFinishedSemaphores[i]),
 			"Failed to create render finished semaphore"
@@ -233,7 +304,7 @@ VkSemaphoreSubmitInfo Swapchain::getRenderFinishedSemaphoreSubmitInfo() const
 {
 	VkSemaphoreSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-	submitInfo.semaphore = m_renderFinishedSemaphores[m_gfx->getCurrentFrameIndex()];
+	submitInfo.semaphore = m_renderFinishedSemaphores[m_currSwapchainImageIdx];
 	submitInfo.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 
 	return submitInfo;
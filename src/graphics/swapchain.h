@@ -48,9 +48,10 @@ namespace mgp
 		void destroy();
 
 		void createSwapchain();
+		void createOffscreenImages();
 		void createSwapchainSyncObjects();
 
-		std::array<VkSemaphore, gfx_constants::FRAMES_IN_FLIGHT> m_renderFinishedSemaphores;
+		std::vector<VkSemaphore> m_renderFinishedSemaphores;
 		std::array<VkSemaphore, gfx_constants::FRAMES_IN_FLIGHT> m_imageAvailableSemaphores;
 
 		VkSwapchainKHR m_swapchain;
@@ -144,7 +144,7 @@ SwapchainSupportDetails vk_toolbox::querySwapChainSupport(VkPhysicalDevice physi
 	return result;
 }
 
-bool vk_toolbox::checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice)
+bool vk_toolbox::checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice, const std::vector<const char *> &extensions)
 {
 	uint32_t extensionCount = 0;
 	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
@@ -156,13 +156,21 @@ bool vk_toolbox::checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice)
 	std::vector<VkExtensionProperties> availableExts(extensionCount);
 	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExts.data());
 
-	for (cauto &availableExtension : availableExts)
+	for (cauto &required : extensions)
 	{
-		for (cauto &required : DEVICE_EXTENSIONS)
+		bool found = false;
+
+		for (cauto &availableExtension : availableExts)
 		{
-			if (!cstr::compare(availableExtension.extensionName, required))
-				return false;
+			if (cstr::compare(availableExtension.extensionName, required) == 0)
+			{
+				found = true;
+				break;
+			}
 		}
+
+		if (!found)
+			return false;
 	}
 
 	return true;
@@ -173,13 +181,14 @@ uint32_t vk_toolbox::assignPhysicalDeviceUsability(
 	VkPhysicalDevice physicalDevice,
 	VkPhysicalDeviceProperties2 properties,
 	VkPhysicalDeviceFeatures2 features,
+	const std::vector<const char *> &extensions,
 	bool *hasEssentials
 )
 {
 	uint32_t resultUsability = 0;
 
 	bool adequateSwapChain = false;
-	bool hasRequiredExtensions = checkDeviceExtensionSupport(physicalDevice);
+	bool hasRequiredExtensions = checkDeviceExtensionSupport(physicalDevice, extensions);
 
 	bool hasAnisotropy = features.features.samplerAnisotropy;
 
@@ -200,9 +209,17 @@ uint32_t vk_toolbox::assignPhysicalDeviceUsability(
 	// it must have the required extensions
 	if (hasRequiredExtensions)
 	{
-		SwapchainSupportDetails details = querySwapChainSupport(physicalDevice, surface);
+		// headless, there's nothing to present to so any device will do
+		if (surface == VK_NULL_HANDLE)
+		{
+			adequateSwapChain = true;
+		}
+		else
+		{
+			SwapchainSupportDetails details = querySwapChainSupport(physicalDevice, surface);
+			adequateSwapChain = (details.surfaceFormats.size() > 0) && (details.presentModes.size() > 0);
+		}
 
-		adequateSwapChain = (details.surfaceFormats.size() > 0) && (details.presentModes.size() > 0);
 		resultUsability += 1;
 	}
 
@@ -18,13 +18,17 @@ namespace mgp
 	namespace vk_toolbox
 	{
 		static constexpr const char *DEVICE_EXTENSIONS[] = {
-			VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 			VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME,
 #ifdef MGP_MAC_SUPPORT
 			"VK_KHR_portability_subset"
 #endif
 		};
 
+		// only required when we actually have a surface to present to
+		static constexpr const char *PRESENT_DEVICE_EXTENSIONS[] = {
+			VK_KHR_SWAPCHAIN_EXTENSION_NAME
+		};
+
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableSurfaceFormats);
 		VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes, bool enableVsync);
 		VkExtent2D chooseSwapExtent(const PlatformCore *platform, const VkSurfaceCapabilitiesKHR &capabilities);
@@ -39,8 +43,8 @@ namespace mgp
 		uint64_t calcShaderBufferAlignedSize(const VkPhysicalDeviceProperties2 &properties, uint64_t size);
 
 		SwapchainSupportDetails querySwapChainSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
-		bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice);
-		uint32_t assignPhysicalDeviceUsability(VkSurfaceKHR surface, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2 properties, VkPhysicalDeviceFeatures2 features, bool *hasEssentials);
+		bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice, const std::vector<const char *> &extensions);
+		uint32_t assignPhysicalDeviceUsability(VkSurfaceKHR surface, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2 properties, VkPhysicalDeviceFeatures2 features, const std::vector<const char *> &extensions, bool *hasEssentials);
 
 		VkSampleCountFlagBits getMaxUsableSampleCount(const VkPhysicalDeviceProperties2 &properties);
 	}
@@ -0,0 +1,479 @@
+#include "uploader.h"
+
+#include "core/common.h"
+
+#include "graphics_core.h"
+#include "gpu_buffer.h"
+#include "image.h"
+
+using namespace mgp;
+
+Uploader::Uploader()
+	: m_gfx(nullptr)
+	, m_ring(nullptr)
+	, m_ringHead(0)
+	, m_ringUsed(0)
+	, m_batches()
+	, m_batchIndex(0)
+	, m_completionValue(0)
+{
+}
+
+void Uploader::init(GraphicsCore *gfx)
+{
+	m_gfx = gfx;
+
+	m_ring = m_gfx->createGPUBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+		gfx_constants::UPLOAD_RING_SIZE
+	);
+
+	m_ringHead = 0;
+	m_ringUsed = 0;
+
+	for (auto &batch : m_batches)
+	{
+		batch.transferPool.create(m_gfx, m_gfx->getTransferQueue().getFamilyIndex());
+		batch.graphicsPool.create(m_gfx, m_gfx->getGraphicsQueue().getFamilyIndex());
+
+		batch.recording = false;
+		batch.inFlight = false;
+		batch.transferValue = 0;
+		batch.graphicsValue = 0;
+		batch.ringBytes = 0;
+	}
+
+	m_batchIndex = 0;
+	m_completionValue = 0;
+}
+
+void Uploader::destroy()
+{
+	// the device is idle by now so everything can go
+	for (auto &batch : m_batches)
+	{
+		for (auto &buffer : batch.overflowBuffers)
+			delete buffer;
+
+		batch.overflowBuffers.clear();
+
+		batch.transferPool.destroy();
+		batch.graphicsPool.destroy();
+	}
+
+	delete m_ring;
+	m_ring = nullptr;
+}
+
+void Uploader::uploadBuffer(GPUBuffer *dst, const void *data, uint64_t size, uint64_t dstOffset)
+{
+	GPUBuffer *src = nullptr;
+	uint64_t srcOffset = 0;
+
+	stage(data, size, &src, &srcOffset);
+
+	CommandBuffer *cmd = getTransferCmd();
+
+	cmd->copyBufferToBuffer(
+		src,
+		dst,
+		{{
+			.srcOffset = srcOffset,
+			.dstOffset = dstOffset,
+			.size = size
+		}}
+	);
+
+	if (!needsOwnershipTransfer())
+		return;
+
+	VkBufferMemoryBarrier2 barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	barrier.srcQueueFamilyIndex = m_gfx->getTransferQueue().getFamilyIndex();
+	barrier.dstQueueFamilyIndex = m_gfx->getGraphicsQueue().getFamilyIndex();
+	barrier.buffer = dst->getHandle();
+	barrier.offset = dstOffset;
+	barrier.size = size;
+
+	m_batches[m_batchIndex].bufferTransfers.push_back(barrier);
+}
+
+void Uploader::uploadImage(Image *dst, const void *data, uint64_t size, bool generateMipmaps)
+{
+	GPUBuffer *src = nullptr;
+	uint64_t srcOffset = 0;
+
+	stage(data, size, &src, &srcOffset);
+
+	CommandBuffer *cmd = getTransferCmd();
+
+	cmd->transitionLayout(dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = srcOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { dst->getWidth(), dst->getHeight(), (dst->getType() == VK_IMAGE_VIEW_TYPE_3D) ? dst->getDepth() : 1 };
+
+	cmd->copyBufferToImage(src, dst, { region });
+
+	auto &batch = m_batches[m_batchIndex];
+
+	batch.pendingImages.push_back(dst);
+	batch.pendingMipmaps.push_back(generateMipmaps);
+
+	if (!needsOwnershipTransfer())
+		return;
+
+	// layout stays as transfer dst across the handover, the graphics side moves it on from there
+	VkImageMemoryBarrier2 barrier = dst->getBarrier(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = m_gfx->getTransferQueue().getFamilyIndex();
+	barrier.dstQueueFamilyIndex = m_gfx->getGraphicsQueue().getFamilyIndex();
+
+	batch.imageTransfers.push_back(barrier);
+}
+
+uint64_t Uploader::flush()
+{
+	auto &batch = m_batches[m_batchIndex];
+
+	if (!batch.recording)
+		return m_completionValue;
+
+	Queue &transferQueue = m_gfx->getTransferQueue();
+	Queue &graphicsQueue = m_gfx->getGraphicsQueue();
+
+	// release everything from the transfer queue
+	if (!batch.bufferTransfers.empty() || !batch.imageTransfers.empty())
+	{
+		for (auto &barrier : batch.bufferTransfers)
+		{
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.dstAccessMask = VK_ACCESS_2_NONE;
+		}
+
+		for (auto &barrier : batch.imageTransfers)
+		{
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.dstAccessMask = VK_ACCESS_2_NONE;
+		}
+
+		batch.transferCmd.pipelineBarrier(0, {}, batch.bufferTransfers, batch.imageTransfers);
+	}
+
+	batch.transferCmd.end();
+
+	batch.transferValue = transferQueue.nextTimelineValue();
+
+	{
+		VkCommandBufferSubmitInfo bufferInfo = batch.transferCmd.getSubmitInfo();
+
+		VkSemaphoreSubmitInfo signalSemaphore = {};
+		signalSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		signalSemaphore.semaphore = transferQueue.getTimelineSemaphore();
+		signalSemaphore.value = batch.transferValue;
+		signalSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		signalSemaphore.deviceIndex = 0;
+
+		VkSubmitInfo2 submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		submitInfo.flags = 0;
+
+		submitInfo.commandBufferInfoCount = 1;
+		submitInfo.pCommandBufferInfos = &bufferInfo;
+
+		submitInfo.signalSemaphoreInfoCount = 1;
+		submitInfo.pSignalSemaphoreInfos = &signalSemaphore;
+
+		submitInfo.waitSemaphoreInfoCount = 0;
+
+		mgp_VK_CHECK(
+			vkQueueSubmit2(transferQueue.getHandle(), 1, &submitInfo, VK_NULL_HANDLE),
+			"Failed to submit upload transfer command buffer"
+		);
+	}
+
+	// then pick it up on the graphics queue, finish off the images and get them ready for sampling
+	CommandBuffer graphicsCmd(batch.graphicsPool.getFreeBuffer());
+	graphicsCmd.begin();
+
+	if (!batch.bufferTransfers.empty() || !batch.imageTransfers.empty())
+	{
+		for (auto &barrier : batch.bufferTransfers)
+		{
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+		}
+
+		// mipmap generation picks up straight from the transfer stage
+		for (auto &barrier : batch.imageTransfers)
+		{
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		}
+
+		graphicsCmd.pipelineBarrier(0, {}, batch.bufferTransfers, batch.imageTransfers);
+	}
+
+	for (int i = 0; i < batch.pendingImages.size(); i++)
+	{
+		if (batch.pendingMipmaps[i])
+			graphicsCmd.generateMipmaps(batch.pendingImages[i]);
+		else
+			graphicsCmd.transitionLayout(batch.pendingImages[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	graphicsCmd.end();
+
+	batch.graphicsValue = graphicsQueue.nextTimelineValue();
+
+	{
+		VkCommandBufferSubmitInfo bufferInfo = graphicsCmd.getSubmitInfo();
+
+		VkSemaphoreSubmitInfo waitSemaphore = {};
+		waitSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		waitSemaphore.semaphore = transferQueue.getTimelineSemaphore();
+		waitSemaphore.value = batch.transferValue;
+		waitSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		waitSemaphore.deviceIndex = 0;
+
+		VkSemaphoreSubmitInfo signalSemaphore = {};
+		signalSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		signalSemaphore.semaphore = graphicsQueue.getTimelineSemaphore();
+		signalSemaphore.value = batch.graphicsValue;
+		signalSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		signalSemaphore.deviceIndex = 0;
+
+		VkSubmitInfo2 submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		submitInfo.flags = 0;
+
+		submitInfo.commandBufferInfoCount = 1;
+		submitInfo.pCommandBufferInfos = &bufferInfo;
+
+		submitInfo.signalSemaphoreInfoCount = 1;
+		submitInfo.pSignalSemaphoreInfos = &signalSemaphore;
+
+		submitInfo.waitSemaphoreInfoCount = 1;
+		submitInfo.pWaitSemaphoreInfos = &waitSemaphore;
+
+		mgp_VK_CHECK(
+			vkQueueSubmit2(graphicsQueue.getHandle(), 1, &submitInfo, VK_NULL_HANDLE),
+			"Failed to submit upload graphics command buffer"
+		);
+	}
+
+	batch.recording = false;
+	batch.inFlight = true;
+
+	batch.bufferTransfers.clear();
+	batch.imageTransfers.clear();
+	batch.pendingImages.clear();
+	batch.pendingMipmaps.clear();
+
+	m_completionValue = batch.graphicsValue;
+
+	// move onto the next batch, if it's still in flight it's the oldest one so waiting on it keeps the ring in order
+	m_batchIndex = (m_batchIndex + 1) % BATCH_COUNT;
+
+	auto &next = m_batches[m_batchIndex];
+
+	if (next.inFlight)
+	{
+		graphicsQueue.waitForTimelineValue(next.graphicsValue);
+		retireBatch(next);
+	}
+
+	return m_completionValue;
+}
+
+bool Uploader::hasPendingUploads() const
+{
+	return m_batches[m_batchIndex].recording;
+}
+
+void Uploader::stage(const void *data, uint64_t size, GPUBuffer **buffer, uint64_t *offset)
+{
+	// way too big for the ring, just give it its own buffer
+	if (size > gfx_constants::UPLOAD_RING_SIZE)
+	{
+		GPUBuffer *overflow = m_gfx->createGPUBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			size
+		);
+
+		overflow->write(data, size, 0);
+
+		// make sure the batch it goes into is the one that owns it
+		getTransferCmd();
+		m_batches[m_batchIndex].overflowBuffers.push_back(overflow);
+
+		(*buffer) = overflow;
+		(*offset) = 0;
+
+		return;
+	}
+
+	retireBatches();
+
+	uint64_t ringOffset = 0;
+
+	while (!allocateRing(size, &ringOffset))
+	{
+		// out of room, push what we have out and wait for the oldest batch to give some back
+		flush();
+
+		if (!waitForOldestBatch())
+			mgp_ERROR("Upload ring is full but nothing is in flight.");
+	}
+
+	// the ring allocation belongs to the batch now
+	getTransferCmd();
+
+	m_ring->write(data, size, ringOffset);
+
+	(*buffer) = m_ring;
+	(*offset) = ringOffset;
+}
+
+bool Uploader::allocateRing(uint64_t size, uint64_t *offset)
+{
+	const uint64_t RING_SIZE = gfx_constants::UPLOAD_RING_SIZE;
+
+	// empty, so start again from the beginning to keep it from fragmenting
+	if (m_ringUsed == 0)
+		m_ringHead = 0;
+
+	uint64_t tail = (m_ringHead + RING_SIZE - m_ringUsed) % RING_SIZE;
+	uint64_t start = (m_ringHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+	uint64_t consumed = 0;
+
+	if (m_ringUsed == RING_SIZE)
+	{
+		return false;
+	}
+	else if (m_ringHead >= tail)
+	{
+		// free space is [head, end) and then [0, tail)
+		if (start + size <= RING_SIZE)
+		{
+			consumed = start + size - m_ringHead;
+		}
+		else if (size <= tail)
+		{
+			consumed = (RING_SIZE - m_ringHead) + size;
+			start = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// free space is [head, tail)
+		if (start + size > tail)
+			return false;
+
+		consumed = start + size - m_ringHead;
+	}
+
+	m_ringHead = (start + size) % RING_SIZE;
+	m_ringUsed += consumed;
+
+	m_batches[m_batchIndex].ringBytes += consumed;
+
+	(*offset) = start;
+
+	return true;
+}
+
+CommandBuffer *Uploader::getTransferCmd()
+{
+	auto &batch = m_batches[m_batchIndex];
+
+	if (!batch.recording)
+	{
+		batch.transferPool.reset();
+		batch.graphicsPool.reset();
+
+		batch.transferCmd = CommandBuffer(batch.transferPool.getFreeBuffer());
+		batch.transferCmd.begin();
+
+		batch.recording = true;
+	}
+
+	return &batch.transferCmd;
+}
+
+void Uploader::retireBatches()
+{
+	uint64_t completed = m_gfx->getGraphicsQueue().getCompletedTimelineValue();
+
+	// oldest first, the ring gets handed back in the order it was given out
+	for (int i = 1; i < BATCH_COUNT; i++)
+	{
+		auto &batch = m_batches[(m_batchIndex + i) % BATCH_COUNT];
+
+		if (!batch.inFlight)
+			continue;
+
+		if (batch.graphicsValue > completed)
+			break;
+
+		retireBatch(batch);
+	}
+}
+
+void Uploader::retireBatch(Batch &batch)
+{
+	m_ringUsed -= batch.ringBytes;
+
+	batch.ringBytes = 0;
+	batch.inFlight = false;
+
+	for (auto &buffer : batch.overflowBuffers)
+		delete buffer;
+
+	batch.overflowBuffers.clear();
+}
+
+bool Uploader::waitForOldestBatch()
+{
+	for (int i = 1; i < BATCH_COUNT; i++)
+	{
+		auto &batch = m_batches[(m_batchIndex + i) % BATCH_COUNT];
+
+		if (!batch.inFlight)
+			continue;
+
+		m_gfx->getGraphicsQueue().waitForTimelineValue(batch.graphicsValue);
+		retireBatch(batch);
+
+		return true;
+	}
+
+	return false;
+}
+
+bool Uploader::needsOwnershipTransfer() const
+{
+	return m_gfx->getTransferQueue().getFamilyIndex() != m_gfx->getGraphicsQueue().getFamilyIndex();
+}
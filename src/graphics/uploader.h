@@ -0,0 +1,101 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <vector>
+#include <array>
+
+#include <Volk/volk.h>
+
+#include "command_pool.h"
+#include "command_buffer.h"
+
+namespace mgp
+{
+	class GraphicsCore;
+	class GPUBuffer;
+	class Image;
+
+	/*
+		Streams data up to device-local buffers and images through one big persistently mapped staging ring.
+		Copies are recorded on the transfer queue as they come in and only go to the gpu in a single batch once
+		flush() is called (GraphicsCore does this before every graphics submission), ring regions get handed back
+		once the transfer queue's timeline has passed them rather than waiting for the whole device to go idle.
+	*/
+	class Uploader
+	{
+		constexpr static uint32_t BATCH_COUNT = 4;
+		constexpr static uint64_t STAGING_ALIGNMENT = 16; // big enough for any texel size we upload
+
+		struct Batch
+		{
+			CommandPoolDynamic transferPool;
+			CommandPoolDynamic graphicsPool;
+
+			CommandBuffer transferCmd;
+
+			bool recording;
+			bool inFlight;
+
+			uint64_t transferValue;
+			uint64_t graphicsValue;
+
+			// bytes of the ring this batch holds on to, padding included
+			uint64_t ringBytes;
+
+			// anything too big for the ring gets its own staging buffer which lives as long as the batch
+			std::vector<GPUBuffer *> overflowBuffers;
+
+			// ownership transfers from the transfer queue, recorded as releases there and acquires on the graphics queue
+			std::vector<VkBufferMemoryBarrier2> bufferTransfers;
+			std::vector<VkImageMemoryBarrier2> imageTransfers;
+
+			// blits can't run on the transfer queue so the graphics side finishes these off
+			std::vector<Image *> pendingImages;
+			std::vector<bool> pendingMipmaps;
+		};
+
+	public:
+		Uploader();
+		~Uploader() = default;
+
+		void init(GraphicsCore *gfx);
+		void destroy();
+
+		void uploadBuffer(GPUBuffer *dst, const void *data, uint64_t size, uint64_t dstOffset = 0);
+
+		// fills the first mip of the image and leaves it in shader read only layout, optionally generating the rest of the mip chain
+		void uploadImage(Image *dst, const void *data, uint64_t size, bool generateMipmaps);
+
+		// submits everything queued so far and returns the graphics timeline value that marks it as usable
+		uint64_t flush();
+
+		bool hasPendingUploads() const;
+
+		// graphics timeline value of the last flushed batch, anything submitted after waiting on it can use the uploads
+		uint64_t getCompletionValue() const { return m_completionValue; }
+
+	private:
+		void stage(const void *data, uint64_t size, GPUBuffer **buffer, uint64_t *offset);
+		bool allocateRing(uint64_t size, uint64_t *offset);
+
+		CommandBuffer *getTransferCmd();
+
+		void retireBatches();
+		void retireBatch(Batch &batch);
+		bool waitForOldestBatch();
+
+		bool needsOwnershipTransfer() const;
+
+		GraphicsCore *m_gfx;
+
+		GPUBuffer *m_ring;
+		uint64_t m_ringHead;
+		uint64_t m_ringUsed;
+
+		std::array<Batch, BATCH_COUNT> m_batches;
+		uint32_t m_batchIndex;
+
+		uint64_t m_completionValue;
+	};
+}
@@ -47,3 +47,13 @@ uint64_t VertexFormat::getInstanceSize() const
 {
 	return m_instanceSize;
 }
+
+void VertexFormat::setName(const std::string &name)
+{
+	m_name = name;
+}
+
+const std::string &VertexFormat::getName() const
+{
+	return m_name;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <string>
 
 #include <Volk/volk.h>
 
@@ -52,7 +53,12 @@ namespace mgp
 		uint64_t getVertexSize() const;
 		uint64_t getInstanceSize() const;
 
+		void setName(const std::string &name);
+		const std::string &getName() const;
+
 	private:
+		std::string m_name;
+
 		std::vector<Attribute> m_attributes;
 		std::vector<Binding> m_bindings;
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "core/common.h"
+
+namespace mgp
+{
+	/*
+		Read-only view of a whole file mapped into the address space.
+		Pages are pulled in by the os as they're touched, so nothing gets copied until something actually reads it.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool open(const std::string &path);
+		void close();
+
+		bool isOpen() const { return m_data != nullptr; }
+
+		const byte *getData() const { return m_data; }
+		uint64_t getSize() const { return m_size; }
+
+	private:
+		const byte *m_data;
+		uint64_t m_size;
+
+		void *m_file;
+		void *m_mapping;
+	};
+}
@@ -1,8 +1,10 @@
+#include <stdlib.h>
+
 #include "core/app.h"
 
 using namespace mgp;
 
-int main(void)
+int main(int argc, char **argv)
 {
 	Config config;
 	config.windowName = "Magpie Demo";
@@ -16,8 +18,36 @@ int main(void)
 	config.windowMode = WINDOW_MODE_WINDOWED;
 	config.flags = CONFIG_FLAG_CENTRE_WINDOW_BIT | CONFIG_FLAG_RESIZABLE_BIT;
 
+	// --headless: render offscreen without a window (e.g: on ci with lavapipe)
+	// --frames <n>: exit after n frames
+	// --capture <path>: save each headless frame to a png, %d or %0Nd in the path is the frame number e.g: "frame_%04d.png"
+	// --cull-benchmark <n>: time frustum culling n synthetic objects at startup
+	for (int i = 1; i < argc; i++)
+	{
+		if (cstr::compare(argv[i], "--headless") == 0)
+		{
+			config.flags |= CONFIG_FLAG_HEADLESS_BIT;
+		}
+		else if (cstr::compare(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			config.frameCount = (unsigned)atoi(argv[++i]);
+		}
+		else if (cstr::compare(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			config.capturePath = argv[++i];
+		}
+		else if (cstr::compare(argv[i], "--cull-benchmark") == 0 && i + 1 < argc)
+		{
+			config.cullBenchmarkCount = (unsigned)atoi(argv[++i]);
+		}
+	}
+
+	// headless runs are for ci / benchmarking so they shouldn't go on forever
+	if (config.hasFlag(CONFIG_FLAG_HEADLESS_BIT) && config.frameCount == 0)
+		config.frameCount = 100;
+
 	App app;
 	app.run(config);
-	
+
 	return 0;
 }
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace mgp
+{
+	struct BoundingBox
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+
+		glm::vec3 getCentre() const { return (min + max) * 0.5f; }
+		glm::vec3 getExtents() const { return (max - min) * 0.5f; }
+	};
+
+	struct BoundingSphere
+	{
+		glm::vec3 centre;
+		float radius;
+	};
+}
@@ -0,0 +1,50 @@
+#include "frustum.h"
+
+#include "core/common.h"
+
+using namespace mgp;
+
+Frustum::Frustum(const glm::mat4 &viewProj)
+	: m_planes()
+{
+	// rows of the matrix, glm is column-major
+	glm::vec4 row0 = { viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0] };
+	glm::vec4 row1 = { viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1] };
+	glm::vec4 row2 = { viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2] };
+	glm::vec4 row3 = { viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3] };
+
+	m_planes[PLANE_LEFT]	= row3 + row0;
+	m_planes[PLANE_RIGHT]	= row3 - row0;
+	m_planes[PLANE_BOTTOM]	= row3 + row1;
+	m_planes[PLANE_TOP]		= row3 - row1;
+	m_planes[PLANE_NEAR]	= row3 + row2; // -1..1 depth, for 0..1 this is a little behind the real near plane which is fine
+	m_planes[PLANE_FAR]		= row3 - row2;
+
+	// normalised so distances come out in world units and can be compared against radii
+	for (auto &plane : m_planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::containsSphere(const glm::vec3 &centre, float radius) const
+{
+	for (cauto &plane : m_planes)
+	{
+		if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius)
+			return false;
+	}
+
+	return true;
+}
+
+bool Frustum::containsBox(const glm::vec3 &centre, const glm::vec3 &extents) const
+{
+	for (cauto &plane : m_planes)
+	{
+		float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+
+		if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace mgp
+{
+	/*
+		Six planes pulled straight out of a view-projection matrix, normals point inwards.
+		Anything with a negative distance to any one of them is outside.
+	*/
+	class Frustum
+	{
+	public:
+		enum
+		{
+			PLANE_LEFT,
+			PLANE_RIGHT,
+			PLANE_BOTTOM,
+			PLANE_TOP,
+			PLANE_NEAR,
+			PLANE_FAR,
+
+			PLANE_MAX_ENUM
+		};
+
+		Frustum() = default;
+		Frustum(const glm::mat4 &viewProj);
+
+		~Frustum() = default;
+
+		const glm::vec4 &getPlane(int index) const { return m_planes[index]; }
+
+		bool containsSphere(const glm::vec3 &centre, float radius) const;
+		bool containsBox(const glm::vec3 &centre, const glm::vec3 &extents) const;
+
+	private:
+		glm::vec4 m_planes[PLANE_MAX_ENUM];
+	};
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// x86 only for now, anything using these keeps a scalar path for everything else
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define MGP_SIMD_SSE 1
+	#include <immintrin.h>
+#else
+	#define MGP_SIMD_SSE 0
+#endif
+
+// avx has to be switched on by the compiler flags (-mavx / /arch:AVX), otherwise we stick to 4-wide sse
+#if MGP_SIMD_SSE && defined(__AVX__)
+	#define MGP_SIMD_AVX 1
+#else
+	#define MGP_SIMD_AVX 0
+#endif
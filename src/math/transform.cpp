@@ -5,6 +5,7 @@ using namespace mgp;
 Transform::Transform()
 	: m_matrix(glm::identity<glm::mat4>())
 	, m_matrixDirty(false)
+	, m_changed(true)
 	, m_position()
 	, m_origin()
 	, m_rotation()
@@ -40,22 +41,26 @@ void Transform::setPosition(const glm::vec3& position)
 {
 	m_position = position;
 	m_matrixDirty = true;
+	m_changed = true;
 }
 
 void Transform::setOrigin(const glm::vec3& origin)
 {
 	m_origin = origin;
 	m_matrixDirty = true;
+	m_changed = true;
 }
 
 void Transform::setRotation(float angle, const glm::vec3& axis)
 {
 	m_rotation = glm::angleAxis(angle, axis);
 	m_matrixDirty = true;
+	m_changed = true;
 }
 
 void Transform::setScale(const glm::vec3& scale)
 {
 	m_scale = scale;
 	m_matrixDirty = true;
+	m_changed = true;
 }
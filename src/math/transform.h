@@ -18,12 +18,17 @@ namespace mgp
 		void setRotation(float angle, const glm::vec3& axis);
 		void setScale(const glm::vec3& scale);
 
+		// set by every setter, whoever mirrors the matrix elsewhere clears it once they've picked up the change
+		bool hasChanged() const { return m_changed; }
+		void clearChanged() { m_changed = false; }
+
 	private:
 		void rebuildMatrix();
 
 		glm::mat4 m_matrix;
 
 		bool m_matrixDirty;
+		bool m_changed;
 
 		glm::vec3 m_position;
 		glm::vec3 m_origin;
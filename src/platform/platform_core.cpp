@@ -14,6 +14,18 @@ PlatformCore::PlatformCore(const Config &config)
 	, m_gamepads{}
 	, m_gamepadCount(0)
 {
+	m_config = config;
+
+	// headless only needs sdl for timing and file io
+	if (config.hasFlag(CONFIG_FLAG_HEADLESS_BIT))
+	{
+		if (SDL_Init(SDL_INIT_EVENTS) == 0)
+			mgp_ERROR("Failed to initialize: %s", SDL_GetError());
+
+		mgp_LOG("SDL Initialized (headless)!");
+		return;
+	}
+
 	uint32_t initFlags =
 		SDL_INIT_VIDEO |
 		SDL_INIT_AUDIO |
@@ -39,8 +51,6 @@ PlatformCore::PlatformCore(const Config &config)
 	if (!m_window)
 		mgp_ERROR("Failed to create window.");
 
-	m_config = config;
-
 	mgp_LOG("SDL Initialized!");
 }
 
@@ -48,7 +58,9 @@ PlatformCore::~PlatformCore()
 {
 	closeAllGamepads();
 
-	SDL_DestroyWindow(m_window);
+	if (m_window)
+		SDL_DestroyWindow(m_window);
+
 	SDL_Quit();
 
 	mgp_LOG("SDL Destroyed!");
@@ -222,6 +234,9 @@ void PlatformCore::setWindowPosition(const glm::ivec2& position)
 
 glm::ivec2 PlatformCore::getWindowSize() const
 {
+	if (isHeadless())
+		return { (int)m_config.width, (int)m_config.height };
+
 	glm::ivec2 result = { 0, 0 };
 	SDL_GetWindowSize(m_window, &result.x, &result.y);
 	return result;
@@ -234,6 +249,9 @@ void PlatformCore::setWindowSize(const glm::ivec2& size)
 
 glm::ivec2 PlatformCore::getWindowSizeInPixels() const
 {
+	if (isHeadless())
+		return { (int)m_config.width, (int)m_config.height };
+
 	glm::ivec2 result = { 0, 0 };
 	SDL_GetWindowSizeInPixels(m_window, &result.x, &result.y);
 	return result;
@@ -271,6 +289,9 @@ void PlatformCore::toggleWindowResizable(bool toggle) const
 
 float PlatformCore::getWindowRefreshRate() const
 {
+	if (isHeadless())
+		return m_config.targetFPS;
+
 	return SDL_GetCurrentDisplayMode(1)->refresh_rate;
 }
 
@@ -440,5 +461,13 @@ bool PlatformCore::vkCreateSurface(void *instance, void **surface) const
 
 void PlatformCore::initImGui()
 {
+	if (isHeadless())
+		return;
+
 	ImGui_ImplSDL3_InitForVulkan(m_window);
 }
+
+bool PlatformCore::isHeadless() const
+{
+	return m_config.hasFlag(CONFIG_FLAG_HEADLESS_BIT);
+}
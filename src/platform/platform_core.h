@@ -80,6 +80,8 @@ namespace mgp
 
 		void initImGui();
 
+		bool isHeadless() const;
+
 	private:
 		void closeAllGamepads();
 
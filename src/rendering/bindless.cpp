@@ -8,6 +8,7 @@ BindlessResources::BindlessResources(GraphicsCore *gfx)
 {
 	m_gfx = gfx;
 
+	// new slots get written while earlier frames are still in flight, which is only allowed for slots those frames never touch
 	std::vector<DescriptorLayoutBinding> bindings =
 	{
 		// samplers
@@ -15,7 +16,7 @@ BindlessResources::BindlessResources(GraphicsCore *gfx)
 			SAMPLER_BINDING,
 			VK_DESCRIPTOR_TYPE_SAMPLER,
 			getMaxDescriptorSize(VK_DESCRIPTOR_TYPE_SAMPLER),
-			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
 		},
 
 		// 2d textures
@@ -23,7 +24,7 @@ BindlessResources::BindlessResources(GraphicsCore *gfx)
 			TEXTURE_2D_BINDING,
 			VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
 			getMaxDescriptorSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE),
-			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
 		},
 		
 		// cubemaps
@@ -31,7 +32,7 @@ BindlessResources::BindlessResources(GraphicsCore *gfx)
 			CUBEMAP_BINDING,
 			VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
 			getMaxDescriptorSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE),
-			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
 		}
 	};
 
@@ -45,8 +46,14 @@ BindlessResources::BindlessResources(GraphicsCore *gfx)
 	// yes this could (should) be done using the layout cache
 	// but its minorly easier to just create it here and manage it manually
 	// since this whole thing only needs a single layout anyway
+	VkShaderStageFlags stages = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+	// the meshlet task shader samples the hi-z pyramid through here
+	if (m_gfx->hasMeshShaders())
+		stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+
 	m_bindlessLayout = m_gfx->createDescriptorLayout(
-		VK_SHADER_STAGE_ALL_GRAPHICS,
+		stages,
 		bindings,
 		VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT
 	);
@@ -123,6 +130,28 @@ BindlessHandle BindlessResources::fromCubemap(const ImageView *cubemap)
 	return BindlessHandle(index);
 }
 
+BindlessHandle BindlessResources::reserveTexture2D(const ImageView *placeholder)
+{
+	// deliberately not mapped to the placeholder, it keeps whatever slot it already has
+	uint32_t index = m_texture2Ds.reserveIndex();
+	m_bindlessDesc->writeSampledImage(TEXTURE_2D_BINDING, placeholder, index);
+
+	return BindlessHandle(index);
+}
+
+void BindlessResources::releaseTexture2D(const BindlessHandle &handle)
+{
+	m_texture2Ds.releaseIndex(handle.id);
+}
+
+void BindlessResources::refreshTexture2D(const ImageView *view)
+{
+	uint32_t index = m_texture2Ds.tryGetIndex(view);
+
+	if (index != INVALID_HANDLE)
+		m_bindlessDesc->writeSampledImage(TEXTURE_2D_BINDING, view, index);
+}
+
 Descriptor *BindlessResources::getDescriptor()
 {
 	return m_bindlessDesc;
@@ -40,6 +40,14 @@ namespace mgp
 		BindlessHandle fromTexture2D(const ImageView *view);
 		BindlessHandle fromCubemap(const ImageView *view);
 
+		// hands out a fresh texture slot that samples the placeholder, the real texture gets a slot of its own once it's loaded
+		// slots can't be rewritten while frames in flight might sample them, so release it once nothing points at it anymore
+		BindlessHandle reserveTexture2D(const ImageView *placeholder);
+		void releaseTexture2D(const BindlessHandle &handle);
+
+		// rewrites the slot a view already has after its handle changed underneath it, the gpu has to be idle
+		void refreshTexture2D(const ImageView *view);
+
 		Descriptor *getDescriptor();
 		DescriptorLayout *getLayout();
 
@@ -56,6 +64,15 @@ namespace mgp
 			}
 
 			uint32_t registerResource(const T *t)
+			{
+				uint32_t index = reserveIndex();
+
+				m_resourceToIndexMap[t] = index;
+
+				return index;
+			}
+
+			uint32_t reserveIndex()
 			{
 				uint32_t index;
 
@@ -70,11 +87,14 @@ namespace mgp
 					m_freeIndex++;
 				}
 
-				m_resourceToIndexMap[t] = index;
-
 				return index;
 			}
 
+			void releaseIndex(uint32_t index)
+			{
+				m_freeIndices.push_back(index);
+			}
+
 			void unregisterResource(const T *t)
 			{
 				uint32_t i = tryGetIndex(t);
@@ -0,0 +1,248 @@
+#include "culling.h"
+
+#include <random>
+#include <cfloat>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/common.h"
+
+#include "math/calc.h"
+#include "math/frustum.h"
+#include "math/simd.h"
+#include "math/timer.h"
+
+using namespace mgp;
+
+void CullBounds::resize(uint32_t newCount)
+{
+	count = newCount;
+
+	uint32_t paddedCount = (newCount + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+
+	sphereX.assign(paddedCount, 0.0f);
+	sphereY.assign(paddedCount, 0.0f);
+	sphereZ.assign(paddedCount, 0.0f);
+
+	// a radius of -inf puts the padding outside of every plane
+	sphereRadius.assign(paddedCount, -FLT_MAX);
+
+	boxX.assign(paddedCount, 0.0f);
+	boxY.assign(paddedCount, 0.0f);
+	boxZ.assign(paddedCount, 0.0f);
+	extentX.assign(paddedCount, 0.0f);
+	extentY.assign(paddedCount, 0.0f);
+	extentZ.assign(paddedCount, 0.0f);
+}
+
+void CullBounds::set(uint32_t index, const BoundingBox &box, const BoundingSphere &sphere, const glm::mat4 &transform)
+{
+	glm::vec3 sphereCentre = glm::vec3(transform * glm::vec4(sphere.centre, 1.0f));
+
+	float maxScale = CalcF::max(glm::length(glm::vec3(transform[0])), CalcF::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+	sphereX[index] = sphereCentre.x;
+	sphereY[index] = sphereCentre.y;
+	sphereZ[index] = sphereCentre.z;
+	sphereRadius[index] = sphere.radius * maxScale;
+
+	// arvo's trick, the new extents are the old ones through the absolute value of the rotation / scale
+	glm::vec3 boxCentre = glm::vec3(transform * glm::vec4(box.getCentre(), 1.0f));
+	glm::vec3 boxExtents = box.getExtents();
+
+	glm::mat3 absolute = glm::mat3(
+		glm::abs(glm::vec3(transform[0])),
+		glm::abs(glm::vec3(transform[1])),
+		glm::abs(glm::vec3(transform[2]))
+	);
+
+	glm::vec3 extents = absolute * boxExtents;
+
+	boxX[index] = boxCentre.x;
+	boxY[index] = boxCentre.y;
+	boxZ[index] = boxCentre.z;
+	extentX[index] = extents.x;
+	extentY[index] = extents.y;
+	extentZ[index] = extents.z;
+}
+
+void mgp::cullFrustumScalar(const Frustum &frustum, const CullBounds &bounds, std::vector<uint32_t> *visible)
+{
+	visible->clear();
+
+	for (uint32_t i = 0; i < bounds.count; i++)
+	{
+		// the sphere is the cheaper early-out, the box is the tighter fit
+		if (!frustum.containsSphere({ bounds.sphereX[i], bounds.sphereY[i], bounds.sphereZ[i] }, bounds.sphereRadius[i]))
+			continue;
+
+		if (!frustum.containsBox({ bounds.boxX[i], bounds.boxY[i], bounds.boxZ[i] }, { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] }))
+			continue;
+
+		visible->push_back(i);
+	}
+}
+
+void mgp::cullFrustum(const Frustum &frustum, const CullBounds &bounds, std::vector<uint32_t> *visible)
+{
+#if MGP_SIMD_AVX
+	visible->clear();
+
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	for (uint32_t i = 0; i < bounds.getPaddedCount(); i += 8)
+	{
+		__m256 sx = _mm256_loadu_ps(&bounds.sphereX[i]);
+		__m256 sy = _mm256_loadu_ps(&bounds.sphereY[i]);
+		__m256 sz = _mm256_loadu_ps(&bounds.sphereZ[i]);
+		__m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&bounds.sphereRadius[i]), signMask);
+
+		__m256 bx = _mm256_loadu_ps(&bounds.boxX[i]);
+		__m256 by = _mm256_loadu_ps(&bounds.boxY[i]);
+		__m256 bz = _mm256_loadu_ps(&bounds.boxZ[i]);
+		__m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int p = 0; p < Frustum::PLANE_MAX_ENUM; p++)
+		{
+			cauto &plane = frustum.getPlane(p);
+
+			__m256 nx = _mm256_set1_ps(plane.x);
+			__m256 ny = _mm256_set1_ps(plane.y);
+			__m256 nz = _mm256_set1_ps(plane.z);
+			__m256 d  = _mm256_set1_ps(plane.w);
+
+			__m256 sphereDist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, sx), _mm256_mul_ps(ny, sy)), _mm256_add_ps(_mm256_mul_ps(nz, sz), d));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(sphereDist, negRadius, _CMP_GE_OQ));
+
+			__m256 boxDist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, bx), _mm256_mul_ps(ny, by)), _mm256_add_ps(_mm256_mul_ps(nz, bz), d));
+			__m256 boxRadius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex), _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+				_mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez)
+			);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(boxDist, _mm256_xor_ps(boxRadius, signMask), _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+
+		for (int k = 0; mask != 0; k++, mask >>= 1)
+		{
+			if (mask & 1)
+				visible->push_back(i + k);
+		}
+	}
+#elif MGP_SIMD_SSE
+	visible->clear();
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (uint32_t i = 0; i < bounds.getPaddedCount(); i += 4)
+	{
+		__m128 sx = _mm_loadu_ps(&bounds.sphereX[i]);
+		__m128 sy = _mm_loadu_ps(&bounds.sphereY[i]);
+		__m128 sz = _mm_loadu_ps(&bounds.sphereZ[i]);
+		__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&bounds.sphereRadius[i]), signMask);
+
+		__m128 bx = _mm_loadu_ps(&bounds.boxX[i]);
+		__m128 by = _mm_loadu_ps(&bounds.boxY[i]);
+		__m128 bz = _mm_loadu_ps(&bounds.boxZ[i]);
+		__m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+		__m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+		__m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int p = 0; p < Frustum::PLANE_MAX_ENUM; p++)
+		{
+			cauto &plane = frustum.getPlane(p);
+
+			__m128 nx = _mm_set1_ps(plane.x);
+			__m128 ny = _mm_set1_ps(plane.y);
+			__m128 nz = _mm_set1_ps(plane.z);
+			__m128 d  = _mm_set1_ps(plane.w);
+
+			__m128 sphereDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)), _mm_add_ps(_mm_mul_ps(nz, sz), d));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(sphereDist, negRadius));
+
+			__m128 boxDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, bx), _mm_mul_ps(ny, by)), _mm_add_ps(_mm_mul_ps(nz, bz), d));
+			__m128 boxRadius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+				_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez)
+			);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(boxDist, _mm_xor_ps(boxRadius, signMask)));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+
+		for (int k = 0; mask != 0; k++, mask >>= 1)
+		{
+			if (mask & 1)
+				visible->push_back(i + k);
+		}
+	}
+#else
+	cullFrustumScalar(frustum, bounds, visible);
+#endif
+}
+
+void mgp::runCullingBenchmark(PlatformCore *platform, uint32_t objectCount)
+{
+	constexpr int ITERATIONS = 100;
+
+	// fixed seed so runs are comparable
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> positionDist(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> sizeDist(0.5f, 5.0f);
+
+	CullBounds bounds;
+	bounds.resize(objectCount);
+
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		glm::vec3 size = { sizeDist(rng), sizeDist(rng), sizeDist(rng) };
+
+		BoundingBox box = { -size, size };
+		BoundingSphere sphere = { glm::vec3(0.0f), glm::length(size) };
+
+		glm::mat4 transform = glm::translate(glm::identity<glm::mat4>(), { positionDist(rng), positionDist(rng), positionDist(rng) });
+
+		bounds.set(i, box, sphere, transform);
+	}
+
+	glm::mat4 proj = glm::perspective(glm::radians(75.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f });
+
+	Frustum frustum(proj * view);
+
+	std::vector<uint32_t> scalarVisible;
+	std::vector<uint32_t> simdVisible;
+
+	scalarVisible.reserve(objectCount);
+	simdVisible.reserve(objectCount);
+
+	Timer timer(platform);
+
+	timer.start();
+
+	for (int i = 0; i < ITERATIONS; i++)
+		cullFrustumScalar(frustum, bounds, &scalarVisible);
+
+	double scalarTime = timer.reset() / ITERATIONS;
+
+	for (int i = 0; i < ITERATIONS; i++)
+		cullFrustum(frustum, bounds, &simdVisible);
+
+	double simdTime = timer.getElapsedSeconds() / ITERATIONS;
+
+	const char *simdName = MGP_SIMD_AVX ? "avx" : (MGP_SIMD_SSE ? "sse" : "scalar");
+
+	mgp_LOG("Culling benchmark: %u objects, %zu visible.", objectCount, simdVisible.size());
+	mgp_LOG("	scalar: %.3fms", scalarTime * 1000.0);
+	mgp_LOG("	%s: %.3fms (%.2fx)", simdName, simdTime * 1000.0, scalarTime / simdTime);
+
+	if (scalarVisible != simdVisible)
+		mgp_LOG("	results differ between the scalar and %s paths (%zu vs %zu)!", simdName, scalarVisible.size(), simdVisible.size());
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "math/bounds.h"
+
+namespace mgp
+{
+	class Frustum;
+	class PlatformCore;
+
+	/*
+		World space bounds laid out structure-of-arrays so the culler can test a whole register's worth at once.
+		Storage is padded out to a multiple of the widest batch with entries that can never be visible, so there's no scalar tail.
+	*/
+	struct CullBounds
+	{
+		constexpr static uint32_t BATCH_SIZE = 8;
+
+		void resize(uint32_t count);
+
+		// moves the model space bounds into world space
+		void set(uint32_t index, const BoundingBox &box, const BoundingSphere &sphere, const glm::mat4 &transform);
+
+		uint32_t getPaddedCount() const { return sphereX.size(); }
+
+		uint32_t count = 0;
+
+		std::vector<float> sphereX;
+		std::vector<float> sphereY;
+		std::vector<float> sphereZ;
+		std::vector<float> sphereRadius;
+
+		std::vector<float> boxX;
+		std::vector<float> boxY;
+		std::vector<float> boxZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+	};
+
+	// fills visible with the index of every bound that intersects the frustum, in order
+	// uses avx / sse when they're available
+	void cullFrustum(const Frustum &frustum, const CullBounds &bounds, std::vector<uint32_t> *visible);
+	void cullFrustumScalar(const Frustum &frustum, const CullBounds &bounds, std::vector<uint32_t> *visible);
+
+	// culls a synthetic scene of objectCount random boxes and logs how long each path takes
+	void runCullingBenchmark(PlatformCore *platform, uint32_t objectCount);
+}
@@ -7,8 +7,6 @@
 
 namespace mgp
 {
-	constexpr static unsigned MAX_POINT_LIGHTS = 16;
-
 	using LightId = unsigned;
 
 	class Light
@@ -21,6 +21,10 @@ namespace mgp
 	enum ShaderPassType
 	{
 		SHADER_PASS_DEFERRED,
+		SHADER_PASS_DEFERRED_COMPACT,
+		SHADER_PASS_VISIBILITY,
+		SHADER_PASS_DEFERRED_MESHLET, // task + mesh shaders, no vertex input
+		SHADER_PASS_DEFERRED_COMPACT_MESHLET,
 		SHADER_PASS_FORWARD,
 		SHADER_PASS_MAX_ENUM
 	};
@@ -88,6 +92,7 @@ namespace mgp
 
 		const std::vector<BindlessHandle> &getTextures() const { return m_textures; }
 		const BindlessHandle &getTexture(uint32_t index) const { return m_textures[index]; }
+		void setTexture(uint32_t index, const BindlessHandle &handle) { m_textures[index] = handle; }
 
 		const GPUBuffer *getParameterBuffer() const { return m_parameterBuffer; }
 		const GraphicsPipelineDef &getPipeline(ShaderPassType pass) const { return m_passes[pass]; }
@@ -0,0 +1,462 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <cctype>
+#include <filesystem>
+
+#include "core/common.h"
+
+#include "io/file_stream.h"
+
+using namespace mgp;
+
+constexpr static uint32_t MESH_CACHE_MAGIC = 0x4D50474D; // "MGPM"
+constexpr static uint32_t MESH_CACHE_VERSION = 5;
+
+constexpr static uint32_t MESH_CACHE_NO_TEXTURE = ~0u;
+
+// blobs start on this boundary so the mapped pointers are always suitably aligned
+constexpr static uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t vertexStride;
+	uint32_t subMeshCount;
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+};
+
+struct MeshCacheRecord
+{
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t meshletOffset;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletTriangleOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t meshletCount;
+	uint32_t meshletVertexCount;
+	BoundingBox box;
+	BoundingSphere sphere;
+	uint32_t textures[MESH_TEXTURE_SLOT_COUNT]; // offsets into the string table
+	uint32_t hasMaterial;
+	uint32_t indexSize;
+};
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+static uint64_t hashBytes(uint64_t start, const byte *data, uint64_t size)
+{
+	const uint64_t prime = 0x100000001B3;
+
+	uint64_t output = start;
+
+	for (uint64_t i = 0; i < size; i++)
+	{
+		output ^= data[i];
+		output *= prime;
+	}
+
+	return output;
+}
+
+// reads the string starting at the quote at text[i], leaves i just past the closing one
+static std::string readJSONString(const std::string &text, size_t &i)
+{
+	std::string result;
+
+	for (i++; i < text.size() && text[i] != '"'; i++)
+	{
+		if (text[i] == '\\' && i + 1 < text.size())
+			i++;
+
+		result.push_back(text[i]);
+	}
+
+	i++;
+
+	return result;
+}
+
+static std::string decodeURI(const std::string &uri)
+{
+	std::string result;
+
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(uri[i + 1]) && std::isxdigit(uri[i + 2]))
+		{
+			result.push_back((char)std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+			i += 2;
+		}
+		else
+		{
+			result.push_back(uri[i]);
+		}
+	}
+
+	return result;
+}
+
+// the .bin files a .gltf keeps its geometry in, not a real json parser, it only has to find the "uri"s in the "buffers" array
+static std::vector<std::string> findGLTFBuffers(const byte *data, uint64_t size)
+{
+	std::vector<std::string> result;
+
+	std::string text((const char *)data, size);
+
+	size_t i = text.find("\"buffers\"");
+
+	if (i == std::string::npos)
+		return result;
+
+	i = text.find('[', i);
+
+	if (i == std::string::npos)
+		return result;
+
+	int depth = 0;
+	std::string previous; // last string read, so a value can tell which key it belongs to
+
+	while (i < text.size())
+	{
+		char c = text[i];
+
+		if (c == '"')
+		{
+			std::string str = readJSONString(text, i);
+
+			if (previous == "uri" && str.compare(0, 5, "data:") != 0)
+				result.push_back(decodeURI(str));
+
+			previous = str;
+			continue;
+		}
+
+		if (c == '[' || c == '{')
+			depth++;
+		else if ((c == ']' || c == '}') && --depth == 0)
+			break;
+
+		// only "uri": "..." counts, not a string that just happens to follow one
+		if (c != ':' && c != ' ' && c != '\t' && c != '\n' && c != '\r')
+			previous.clear();
+
+		i++;
+	}
+
+	return result;
+}
+
+static bool isRangeValid(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+// the blobs are in range, this checks what's in them points where it should so nothing reads past an array on the gpu
+static bool isContentValid(const byte *data, const MeshCacheRecord &record)
+{
+	if (record.indexCount % 3 != 0)
+		return false;
+
+	for (uint32_t i = 0; i < record.indexCount; i++)
+	{
+		uint32_t index = (record.indexSize == sizeof(uint16_t))
+			? ((const uint16_t *)(data + record.indexOffset))[i]
+			: ((const uint32_t *)(data + record.indexOffset))[i];
+
+		if (index >= record.vertexCount)
+			return false;
+	}
+
+	const uint32_t *meshletVertices = (const uint32_t *)(data + record.meshletVertexOffset);
+
+	for (uint32_t i = 0; i < record.meshletVertexCount; i++)
+	{
+		if (meshletVertices[i] >= record.vertexCount)
+			return false;
+	}
+
+	const Meshlet *meshlets = (const Meshlet *)(data + record.meshletOffset);
+	const uint32_t *meshletTriangles = (const uint32_t *)(data + record.meshletTriangleOffset);
+
+	for (uint32_t i = 0; i < record.meshletCount; i++)
+	{
+		Meshlet meshlet = {};
+		mem::copy(&meshlet, &meshlets[i], sizeof(Meshlet));
+
+		bool valid =
+			meshlet.vertexCount <= mesh_optimiser::MESHLET_MAX_VERTICES &&
+			meshlet.triangleCount <= mesh_optimiser::MESHLET_MAX_TRIANGLES &&
+			meshlet.firstIndex % 3 == 0 &&
+			(uint64_t)meshlet.firstVertex + meshlet.vertexCount <= record.meshletVertexCount &&
+			(uint64_t)(meshlet.firstIndex / 3) + meshlet.triangleCount <= record.indexCount / 3;
+
+		if (!valid)
+			return false;
+
+		for (uint32_t j = 0; j < meshlet.triangleCount; j++)
+		{
+			uint32_t triangle = meshletTriangles[(meshlet.firstIndex / 3) + j];
+
+			if ((triangle & 0xFF) >= meshlet.vertexCount || ((triangle >> 8) & 0xFF) >= meshlet.vertexCount || ((triangle >> 16) & 0xFF) >= meshlet.vertexCount)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+MeshCache::MeshCache()
+	: m_file()
+	, m_subMeshCount(0)
+{
+}
+
+bool MeshCache::open(const std::string &path, uint64_t sourceHash)
+{
+	close();
+
+	if (!m_file.open(path))
+		return false;
+
+	const byte *data = m_file.getData();
+	const uint64_t size = m_file.getSize();
+
+	if (size < sizeof(MeshCacheHeader))
+	{
+		close();
+		return false;
+	}
+
+	MeshCacheHeader header = {};
+	mem::copy(&header, data, sizeof(MeshCacheHeader));
+
+	bool valid =
+		header.magic == MESH_CACHE_MAGIC &&
+		header.version == MESH_CACHE_VERSION &&
+		header.sourceHash == sourceHash &&
+		header.vertexStride == sizeof(PackedModelVertex) &&
+		isRangeValid(sizeof(MeshCacheHeader), (uint64_t)header.subMeshCount * sizeof(MeshCacheRecord), size) &&
+		isRangeValid(header.stringTableOffset, header.stringTableSize, size);
+
+	// check every blob (and what's in it) up front so getSubMesh() never has to
+	for (uint32_t i = 0; valid && i < header.subMeshCount; i++)
+	{
+		MeshCacheRecord record = {};
+		mem::copy(&record, data + sizeof(MeshCacheHeader) + (i * sizeof(MeshCacheRecord)), sizeof(MeshCacheRecord));
+
+		valid &= isRangeValid(record.vertexOffset, (uint64_t)record.vertexCount * sizeof(PackedModelVertex), size);
+		valid &= record.indexSize == sizeof(uint16_t) || record.indexSize == sizeof(uint32_t);
+		valid &= isRangeValid(record.indexOffset, (uint64_t)record.indexCount * record.indexSize, size);
+		valid &= isRangeValid(record.meshletOffset, (uint64_t)record.meshletCount * sizeof(Meshlet), size);
+		valid &= isRangeValid(record.meshletVertexOffset, (uint64_t)record.meshletVertexCount * sizeof(uint32_t), size);
+		valid &= isRangeValid(record.meshletTriangleOffset, (uint64_t)(record.indexCount / 3) * sizeof(uint32_t), size);
+
+		for (int j = 0; j < MESH_TEXTURE_SLOT_COUNT; j++)
+			valid &= record.textures[j] == MESH_CACHE_NO_TEXTURE || record.textures[j] < header.stringTableSize;
+
+		valid = valid && isContentValid(data, record);
+	}
+
+	if (!valid)
+	{
+		close();
+		return false;
+	}
+
+	m_subMeshCount = header.subMeshCount;
+
+	return true;
+}
+
+void MeshCache::close()
+{
+	m_file.close();
+	m_subMeshCount = 0;
+}
+
+BakedSubMesh MeshCache::getSubMesh(uint32_t index) const
+{
+	const byte *data = m_file.getData();
+
+	MeshCacheHeader header = {};
+	mem::copy(&header, data, sizeof(MeshCacheHeader));
+
+	MeshCacheRecord record = {};
+	mem::copy(&record, data + sizeof(MeshCacheHeader) + (index * sizeof(MeshCacheRecord)), sizeof(MeshCacheRecord));
+
+	BakedSubMesh result = {};
+	result.vertices = (const PackedModelVertex *)(data + record.vertexOffset);
+	result.vertexCount = record.vertexCount;
+	result.indices = data + record.indexOffset;
+	result.indexCount = record.indexCount;
+	result.indexSize = record.indexSize;
+	result.box = record.box;
+	result.sphere = record.sphere;
+	result.meshlets = (const Meshlet *)(data + record.meshletOffset);
+	result.meshletCount = record.meshletCount;
+	result.meshletVertices = (const uint32_t *)(data + record.meshletVertexOffset);
+	result.meshletVertexCount = record.meshletVertexCount;
+	result.meshletTriangles = (const uint32_t *)(data + record.meshletTriangleOffset);
+	result.hasMaterial = record.hasMaterial != 0;
+
+	const char *strings = (const char *)(data + header.stringTableOffset);
+
+	for (int i = 0; i < MESH_TEXTURE_SLOT_COUNT; i++)
+	{
+		if (record.textures[i] == MESH_CACHE_NO_TEXTURE)
+			continue;
+
+		// bounded in case the table is missing its last terminator
+		const char *str = strings + record.textures[i];
+		result.textures[i] = std::string(str, strnlen(str, header.stringTableSize - record.textures[i]));
+	}
+
+	return result;
+}
+
+bool MeshCache::write(PlatformCore *platform, const std::string &path, uint64_t sourceHash, const std::vector<BakedSubMesh> &subMeshes)
+{
+	std::vector<MeshCacheRecord> records(subMeshes.size());
+	std::string strings;
+
+	// lay everything out first so the file can be written front to back in one go
+	uint64_t offset = sizeof(MeshCacheHeader) + (records.size() * sizeof(MeshCacheRecord));
+
+	for (int i = 0; i < subMeshes.size(); i++)
+	{
+		cauto &subMesh = subMeshes[i];
+		auto &record = records[i];
+
+		record.vertexCount = subMesh.vertexCount;
+		record.indexCount = subMesh.indexCount;
+		record.indexSize = subMesh.indexSize;
+		record.meshletCount = subMesh.meshletCount;
+		record.meshletVertexCount = subMesh.meshletVertexCount;
+		record.box = subMesh.box;
+		record.sphere = subMesh.sphere;
+		record.hasMaterial = subMesh.hasMaterial ? 1 : 0;
+
+		offset = alignOffset(offset);
+		record.vertexOffset = offset;
+		offset += subMesh.vertexCount * sizeof(PackedModelVertex);
+
+		offset = alignOffset(offset);
+		record.indexOffset = offset;
+		offset += (uint64_t)subMesh.indexCount * subMesh.indexSize;
+
+		offset = alignOffset(offset);
+		record.meshletOffset = offset;
+		offset += (uint64_t)subMesh.meshletCount * sizeof(Meshlet);
+
+		offset = alignOffset(offset);
+		record.meshletVertexOffset = offset;
+		offset += (uint64_t)subMesh.meshletVertexCount * sizeof(uint32_t);
+
+		offset = alignOffset(offset);
+		record.meshletTriangleOffset = offset;
+		offset += (uint64_t)(subMesh.indexCount / 3) * sizeof(uint32_t);
+
+		for (int j = 0; j < MESH_TEXTURE_SLOT_COUNT; j++)
+		{
+			if (subMesh.textures[j].empty())
+			{
+				record.textures[j] = MESH_CACHE_NO_TEXTURE;
+				continue;
+			}
+
+			record.textures[j] = strings.size();
+			strings.append(subMesh.textures[j]);
+			strings.push_back('\0');
+		}
+	}
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexStride = sizeof(PackedModelVertex);
+	header.subMeshCount = records.size();
+	header.stringTableOffset = offset;
+	header.stringTableSize = strings.size();
+
+	FileStream stream(platform, path.c_str(), "wb");
+
+	if (!stream.getStream())
+		return false;
+
+	const byte padding[MESH_CACHE_ALIGNMENT] = {};
+
+	auto writePadding = [&]() -> void {
+		uint64_t position = stream.getPosition();
+		stream.write((void *)padding, alignOffset(position) - position);
+	};
+
+	stream.write(&header, sizeof(MeshCacheHeader));
+	stream.write(records.data(), records.size() * sizeof(MeshCacheRecord));
+
+	for (cauto &subMesh : subMeshes)
+	{
+		writePadding();
+		stream.write((void *)subMesh.vertices, subMesh.vertexCount * sizeof(PackedModelVertex));
+
+		writePadding();
+		stream.write((void *)subMesh.indices, (uint64_t)subMesh.indexCount * subMesh.indexSize);
+
+		writePadding();
+		stream.write((void *)subMesh.meshlets, (uint64_t)subMesh.meshletCount * sizeof(Meshlet));
+
+		writePadding();
+		stream.write((void *)subMesh.meshletVertices, (uint64_t)subMesh.meshletVertexCount * sizeof(uint32_t));
+
+		writePadding();
+		stream.write((void *)subMesh.meshletTriangles, (uint64_t)(subMesh.indexCount / 3) * sizeof(uint32_t));
+	}
+
+	stream.write(strings.data(), strings.size());
+	stream.close();
+
+	return true;
+}
+
+uint64_t MeshCache::calcSourceHash(const std::string &path, uint32_t importFlags)
+{
+	const uint64_t offset = 0xCBF29CE484222325;
+
+	MappedFile source;
+
+	if (!source.open(path))
+		return 0;
+
+	uint64_t result = hashBytes(offset, source.getData(), source.getSize());
+
+	// a .gltf only describes the mesh, the vertices themselves live in the buffers next to it
+	std::filesystem::path sourcePath(path);
+
+	if (sourcePath.extension() == ".gltf")
+	{
+		for (cauto &uri : findGLTFBuffers(source.getData(), source.getSize()))
+		{
+			MappedFile buffer;
+
+			if (!buffer.open((sourcePath.parent_path() / uri).string()))
+				return 0;
+
+			result = hashBytes(result, buffer.getData(), buffer.getSize());
+		}
+	}
+
+	// a different vertex layout or set of assimp post-process steps bakes a different file
+	uint32_t settings[] = { importFlags, MESH_CACHE_VERSION, sizeof(PackedModelVertex) };
+	result = hashBytes(result, (const byte *)settings, sizeof(settings));
+
+	return result;
+}
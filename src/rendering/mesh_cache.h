@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "math/bounds.h"
+
+#include "io/mapped_file.h"
+
+#include "rendering/vertex_types.h"
+#include "rendering/mesh_optimiser.h"
+
+namespace mgp
+{
+	class PlatformCore;
+
+	// diffuse, ambient, roughness-metallic, normals, emissive, same order the material expects them in
+	constexpr static uint32_t MESH_TEXTURE_SLOT_COUNT = 5;
+
+	/*
+		One submesh's worth of imported data, laid out the way Mesh::build wants it.
+		Coming out of the cache the pointers point straight into the mapped file, coming out of assimp they point at the loader's own arrays.
+		Texture paths are relative to the model's directory, empty means the slot uses its fallback.
+	*/
+	struct BakedSubMesh
+	{
+		const PackedModelVertex *vertices;
+		uint32_t vertexCount;
+
+		const void *indices;
+		uint32_t indexCount;
+		uint32_t indexSize; // bytes, 2 or 4
+
+		BoundingBox box;
+		BoundingSphere sphere;
+
+		// there's one local triangle per indexed triangle, in the same order
+		const Meshlet *meshlets;
+		uint32_t meshletCount;
+		const uint32_t *meshletVertices;
+		uint32_t meshletVertexCount;
+		const uint32_t *meshletTriangles;
+
+		bool hasMaterial;
+		std::string textures[MESH_TEXTURE_SLOT_COUNT];
+	};
+
+	/*
+		Flat binary dump of everything the model loader pulls out of assimp.
+		The header carries a hash of the source file and the import settings so a stale bake is just ignored and rebuilt.
+	*/
+	class MeshCache
+	{
+	public:
+		MeshCache();
+		~MeshCache() = default;
+
+		// maps the baked file, fails if it's missing, malformed or was baked from something else
+		bool open(const std::string &path, uint64_t sourceHash);
+		void close();
+
+		uint32_t getSubMeshCount() const { return m_subMeshCount; }
+		BakedSubMesh getSubMesh(uint32_t index) const;
+
+		static bool write(PlatformCore *platform, const std::string &path, uint64_t sourceHash, const std::vector<BakedSubMesh> &subMeshes);
+
+		// hash of the source file's bytes (and a .gltf's external buffers) plus whatever else changes what the bake would contain
+		static uint64_t calcSourceHash(const std::string &path, uint32_t importFlags);
+
+	private:
+		MappedFile m_file;
+		uint32_t m_subMeshCount;
+	};
+}
@@ -0,0 +1,543 @@
+#include "mesh_optimiser.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+
+#include "core/common.h"
+
+#include "math/calc.h"
+
+using namespace mgp;
+
+// forsyth's scoring constants, the cache size here is what the scoring assumes rather than what we measure against
+constexpr static uint32_t FORSYTH_CACHE_SIZE = 32;
+constexpr static float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+constexpr static float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+constexpr static float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+constexpr static float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+struct VertexHasher
+{
+	size_t operator()(const ModelVertex &vertex) const
+	{
+		return hash::calc(&vertex);
+	}
+};
+
+struct VertexEqual
+{
+	bool operator()(const ModelVertex &a, const ModelVertex &b) const
+	{
+		return mem::compare(&a, &b, sizeof(ModelVertex)) == 0;
+	}
+};
+
+struct TriangleCluster
+{
+	uint32_t firstTriangle;
+	uint32_t triangleCount;
+	float sortKey;
+};
+
+// cone wider than this (the cosine of ~84 degrees off the axis) is practically never back facing as a whole
+constexpr static float MESHLET_CONE_MIN_DOT = 0.1f;
+
+static void calcMeshletBounds(Meshlet *meshlet, const MeshletData &data, const std::vector<ModelVertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	// sphere around the box of the meshlet's vertices, loose but cheap
+	glm::vec3 min(FLT_MAX);
+	glm::vec3 max(-FLT_MAX);
+
+	for (uint32_t i = 0; i < meshlet->vertexCount; i++)
+	{
+		cauto &position = vertices[data.vertices[meshlet->firstVertex + i]].position;
+
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+
+	meshlet->centre = (min + max) * 0.5f;
+	meshlet->radius = 0.0f;
+
+	for (uint32_t i = 0; i < meshlet->vertexCount; i++)
+		meshlet->radius = CalcF::max(meshlet->radius, glm::length(vertices[data.vertices[meshlet->firstVertex + i]].position - meshlet->centre));
+
+	glm::vec3 normals[mesh_optimiser::MESHLET_MAX_TRIANGLES];
+	uint32_t normalCount = 0;
+
+	glm::vec3 axis(0.0f);
+
+	for (uint32_t i = 0; i < meshlet->triangleCount; i++)
+	{
+		cauto &a = vertices[indices[meshlet->firstIndex + (i * 3) + 0]];
+		cauto &b = vertices[indices[meshlet->firstIndex + (i * 3) + 1]];
+		cauto &c = vertices[indices[meshlet->firstIndex + (i * 3) + 2]];
+
+		glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+		float area = glm::length(normal);
+
+		// degenerate, doesn't face anywhere
+		if (area <= 0.0f)
+			continue;
+
+		normal /= area;
+
+		// the winding gets flipped on import, so let the vertex normals say which side is the front
+		if (glm::dot(normal, a.normal + b.normal + c.normal) < 0.0f)
+			normal = -normal;
+
+		normals[normalCount++] = normal;
+		axis += normal;
+	}
+
+	meshlet->coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet->coneCutoff = 1.0f;
+
+	float axisLength = glm::length(axis);
+
+	if (normalCount == 0 || axisLength <= 0.0f)
+		return;
+
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+
+	for (uint32_t i = 0; i < normalCount; i++)
+		minDot = CalcF::min(minDot, glm::dot(normals[i], axis));
+
+	meshlet->coneAxis = axis;
+
+	if (minDot <= MESHLET_CONE_MIN_DOT)
+		return;
+
+	// the normal cone's half angle is acos(minDot), widened by 90 degrees to get the cone of directions every triangle faces away from
+	meshlet->coneCutoff = CalcF::sqrt(1.0f - (minDot * minDot));
+}
+
+static float calcVertexScore(int cachePosition, uint32_t liveTriangles)
+{
+	// nothing left to draw with it so it's no use keeping around
+	if (liveTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0)
+	{
+		// the last triangle's vertices get a flat score so we don't just keep drawing strips
+		if (cachePosition < 3)
+		{
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scale = 1.0f / (float)(FORSYTH_CACHE_SIZE - 3);
+			score = CalcF::pow(1.0f - (float)(cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// vertices with only a few triangles left get finished off before they fall out of the cache
+	score += FORSYTH_VALENCE_BOOST_SCALE * CalcF::pow((float)liveTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+void mesh_optimiser::optimise(std::vector<ModelVertex> &vertices, std::vector<uint32_t> &indices, MeshOptimiserStats *stats)
+{
+	stats->vertexCountBefore = vertices.size();
+	stats->cacheMissesBefore = calcCacheMisses(indices, vertices.size(), VERTEX_CACHE_SIZE);
+	stats->triangleCount = indices.size() / 3;
+
+	// anything that isn't a plain triangle list (points, lines) gets left alone
+	if (indices.size() % 3 == 0)
+	{
+		weldVertices(vertices, indices);
+		optimiseVertexCache(indices, vertices.size());
+		optimiseOverdraw(indices, vertices);
+		optimiseVertexFetch(vertices, indices);
+	}
+
+	stats->vertexCountAfter = vertices.size();
+	stats->cacheMissesAfter = calcCacheMisses(indices, vertices.size(), VERTEX_CACHE_SIZE);
+}
+
+void mesh_optimiser::weldVertices(std::vector<ModelVertex> &vertices, std::vector<uint32_t> &indices)
+{
+	std::unordered_map<ModelVertex, uint32_t, VertexHasher, VertexEqual> lookup;
+	lookup.reserve(vertices.size());
+
+	std::vector<uint32_t> remap(vertices.size());
+	uint32_t uniqueCount = 0;
+
+	for (uint32_t i = 0; i < vertices.size(); i++)
+	{
+		auto result = lookup.insert({ vertices[i], uniqueCount });
+
+		if (result.second)
+		{
+			vertices[uniqueCount] = vertices[i];
+			uniqueCount++;
+		}
+
+		remap[i] = result.first->second;
+	}
+
+	vertices.resize(uniqueCount);
+
+	for (auto &index : indices)
+		index = remap[index];
+}
+
+void mesh_optimiser::optimiseVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount)
+{
+	uint32_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+
+	for (uint32_t index : indices)
+		liveTriangles[index]++;
+
+	// every vertex's triangles packed into one array, the live ones are kept at the front of each vertex's range
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+
+	for (uint32_t i = 0; i < vertexCount; i++)
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> adjacencyCursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+	for (uint32_t i = 0; i < indices.size(); i++)
+		adjacency[adjacencyCursors[indices[i]]++] = i / 3;
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+
+	for (uint32_t i = 0; i < vertexCount; i++)
+		vertexScores[i] = calcVertexScore(-1, liveTriangles[i]);
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	uint32_t inputCursor = 0;
+	int bestTriangle = -1;
+
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// nothing in the cache touches a triangle that's left, carry on from wherever we got to in the input
+		if (bestTriangle < 0)
+		{
+			while (emitted[inputCursor])
+				inputCursor++;
+
+			bestTriangle = inputCursor;
+		}
+
+		uint32_t triangle = bestTriangle;
+
+		emitted[triangle] = true;
+		nextCache.clear();
+
+		for (int i = 0; i < 3; i++)
+		{
+			uint32_t vertex = indices[triangle*3 + i];
+			result.push_back(vertex);
+
+			// swap the triangle out of the vertex's live range
+			uint32_t begin = adjacencyOffsets[vertex];
+			uint32_t end = begin + liveTriangles[vertex];
+
+			for (uint32_t j = begin; j < end; j++)
+			{
+				if (adjacency[j] == triangle)
+				{
+					std::swap(adjacency[j], adjacency[end - 1]);
+					break;
+				}
+			}
+
+			liveTriangles[vertex]--;
+
+			if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+				nextCache.push_back(vertex);
+		}
+
+		// fewer than three if the triangle was degenerate
+		uint32_t newCount = nextCache.size();
+
+		for (uint32_t vertex : cache)
+		{
+			if (std::find(nextCache.begin(), nextCache.begin() + newCount, vertex) == nextCache.begin() + newCount)
+				nextCache.push_back(vertex);
+		}
+
+		// anything pushed past the end has fallen out of the cache
+		for (uint32_t i = 0; i < nextCache.size(); i++)
+		{
+			uint32_t vertex = nextCache[i];
+
+			cachePositions[vertex] = (i < FORSYTH_CACHE_SIZE) ? (int)i : -1;
+			vertexScores[vertex] = calcVertexScore(cachePositions[vertex], liveTriangles[vertex]);
+		}
+
+		nextCache.resize(CalcU::min((uint32_t)nextCache.size(), FORSYTH_CACHE_SIZE));
+		std::swap(cache, nextCache);
+
+		// only triangles touching the cache could have changed score so they're the only candidates worth looking at
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+
+		for (uint32_t vertex : cache)
+		{
+			uint32_t begin = adjacencyOffsets[vertex];
+			uint32_t end = begin + liveTriangles[vertex];
+
+			for (uint32_t j = begin; j < end; j++)
+			{
+				uint32_t candidate = adjacency[j];
+
+				float score =
+					vertexScores[indices[candidate*3 + 0]] +
+					vertexScores[indices[candidate*3 + 1]] +
+					vertexScores[indices[candidate*3 + 2]];
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = candidate;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void mesh_optimiser::optimiseOverdraw(std::vector<uint32_t> &indices, const std::vector<ModelVertex> &vertices)
+{
+	uint32_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	// split wherever the cache would have gone cold anyway (every vertex of the triangle misses),
+	// so shuffling the clusters around barely costs anything in cache efficiency
+	std::vector<TriangleCluster> clusters;
+
+	std::vector<uint32_t> timestamps(vertices.size(), 0);
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		uint32_t misses = 0;
+
+		for (int j = 0; j < 3; j++)
+		{
+			uint32_t vertex = indices[i*3 + j];
+
+			if (time - timestamps[vertex] > VERTEX_CACHE_SIZE)
+			{
+				timestamps[vertex] = time++;
+				misses++;
+			}
+		}
+
+		if (clusters.empty() || misses == 3)
+			clusters.push_back({ i, 0, 0.0f });
+
+		clusters.back().triangleCount++;
+	}
+
+	if (clusters.size() <= 1)
+		return;
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	std::vector<glm::vec3> clusterCentroids(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusters.size(), glm::vec3(0.0f));
+
+	for (uint32_t i = 0; i < clusters.size(); i++)
+	{
+		cauto &cluster = clusters[i];
+
+		float clusterArea = 0.0f;
+
+		for (uint32_t j = cluster.firstTriangle; j < cluster.firstTriangle + cluster.triangleCount; j++)
+		{
+			const ModelVertex &v0 = vertices[indices[j*3 + 0]];
+			const ModelVertex &v1 = vertices[indices[j*3 + 1]];
+			const ModelVertex &v2 = vertices[indices[j*3 + 2]];
+
+			const glm::vec3 &p0 = v0.position;
+			const glm::vec3 &p1 = v1.position;
+			const glm::vec3 &p2 = v2.position;
+
+			// twice the area, which is fine since everything gets the same weighting
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+
+			// the winding gets flipped on import, so let the vertex normals say which side is the front
+			if (glm::dot(normal, v0.normal + v1.normal + v2.normal) < 0.0f)
+				normal = -normal;
+
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			clusterCentroids[i] += centroid * area;
+			clusterNormals[i] += normal;
+			clusterArea += area;
+		}
+
+		meshCentroid += clusterCentroids[i];
+		meshArea += clusterArea;
+
+		if (clusterArea > 0.0f)
+			clusterCentroids[i] /= clusterArea;
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// clusters furthest out and facing away from the centre are the likeliest to cover everything else, so they go first
+	for (uint32_t i = 0; i < clusters.size(); i++)
+	{
+		float normalLength = glm::length(clusterNormals[i]);
+		glm::vec3 normal = (normalLength > 0.0f) ? clusterNormals[i] / normalLength : glm::vec3(0.0f);
+
+		clusters[i].sortKey = glm::dot(clusterCentroids[i] - meshCentroid, normal);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster &a, const TriangleCluster &b) -> bool {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	for (cauto &cluster : clusters)
+		result.insert(result.end(), indices.begin() + cluster.firstTriangle*3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount)*3);
+
+	indices.swap(result);
+}
+
+void mesh_optimiser::optimiseVertexFetch(std::vector<ModelVertex> &vertices, std::vector<uint32_t> &indices)
+{
+	const uint32_t UNUSED = ~0u;
+
+	std::vector<uint32_t> remap(vertices.size(), UNUSED);
+	std::vector<ModelVertex> result;
+	result.reserve(vertices.size());
+
+	for (auto &index : indices)
+	{
+		if (remap[index] == UNUSED)
+		{
+			remap[index] = result.size();
+			result.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
+
+uint32_t mesh_optimiser::calcCacheMisses(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	// fifo cache, a vertex is still resident if fewer than cacheSize misses have happened since it was loaded
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+
+	uint32_t misses = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (time - timestamps[index] > cacheSize)
+		{
+			timestamps[index] = time++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+void mesh_optimiser::buildMeshlets(MeshletData *result, const std::vector<ModelVertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	const uint8_t UNUSED = 0xFF;
+
+	result->meshlets.clear();
+	result->vertices.clear();
+	result->triangles.clear();
+
+	result->triangles.reserve(indices.size() / 3);
+
+	// where each vertex sits in the meshlet being built, only the ones it uses are ever set
+	std::vector<uint8_t> localIndices(vertices.size(), UNUSED);
+
+	Meshlet meshlet = {};
+
+	auto finishMeshlet = [&]() -> void {
+		if (meshlet.triangleCount == 0)
+			return;
+
+		calcMeshletBounds(&meshlet, *result, vertices, indices);
+		result->meshlets.push_back(meshlet);
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			localIndices[result->vertices[meshlet.firstVertex + i]] = UNUSED;
+
+		meshlet = {};
+	};
+
+	for (uint32_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		uint32_t newVertices = 0;
+
+		for (int j = 0; j < 3; j++)
+		{
+			if (localIndices[indices[i + j]] == UNUSED)
+				newVertices++;
+		}
+
+		// cache order already keeps neighbours together, so just cutting wherever it's full gives decent clusters
+		if (meshlet.vertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.triangleCount == MESHLET_MAX_TRIANGLES)
+			finishMeshlet();
+
+		if (meshlet.triangleCount == 0)
+		{
+			meshlet.firstIndex = i;
+			meshlet.firstVertex = result->vertices.size();
+		}
+
+		uint32_t triangle = 0;
+
+		for (int j = 0; j < 3; j++)
+		{
+			uint32_t index = indices[i + j];
+
+			if (localIndices[index] == UNUSED)
+			{
+				localIndices[index] = meshlet.vertexCount++;
+				result->vertices.push_back(index);
+			}
+
+			triangle |= (uint32_t)localIndices[index] << (j * 8);
+		}
+
+		result->triangles.push_back(triangle);
+		meshlet.triangleCount++;
+	}
+
+	finishMeshlet();
+}
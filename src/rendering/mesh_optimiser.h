@@ -0,0 +1,82 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <vector>
+
+#include "rendering/vertex_types.h"
+
+namespace mgp
+{
+	// before / after numbers for one mesh, misses are from a simulated fifo cache of VERTEX_CACHE_SIZE entries
+	struct MeshOptimiserStats
+	{
+		uint32_t vertexCountBefore;
+		uint32_t vertexCountAfter;
+
+		uint32_t cacheMissesBefore;
+		uint32_t cacheMissesAfter;
+
+		uint32_t triangleCount;
+	};
+
+	/*
+		A run of at most MESHLET_MAX_TRIANGLES triangles touching at most MESHLET_MAX_VERTICES vertices, culled as a unit on the gpu.
+		The triangles are a contiguous range of the mesh's index buffer so an indexed draw can pick them out on its own,
+		the mesh shader path instead goes through the meshlet's own vertex list and 8 bit local triangles.
+	*/
+	struct Meshlet
+	{
+		glm::vec3 centre; // bounding sphere, model space
+		float radius;
+
+		// all the triangles face away from anything for which dot(centre - eye, coneAxis) >= coneCutoff * |centre - eye| + radius
+		glm::vec3 coneAxis;
+		float coneCutoff; // 1 when the normals are too spread out for the test to ever pass
+
+		uint32_t firstIndex; // relative to the mesh's first index, also firstIndex / 3 into the local triangles
+		uint32_t triangleCount;
+		uint32_t firstVertex; // into the meshlet vertex list
+		uint32_t vertexCount;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertices; // mesh vertex indices, each meshlet's run is what its local indices point into
+		std::vector<uint32_t> triangles; // one per triangle, three 8 bit local indices in the low 24 bits
+	};
+
+	/*
+		Import-time cleanup for triangle lists, run once per mesh before it's built (or baked).
+		Identical vertices get welded, triangles are reordered for the post-transform cache (Forsyth's linear-speed algorithm)
+		and then by cluster to cut overdraw, and finally vertices are renumbered in the order they're first used so fetches walk forward through memory.
+	*/
+	namespace mesh_optimiser
+	{
+		// roughly what current hardware behaves like, only used for measuring
+		constexpr static uint32_t VERTEX_CACHE_SIZE = 16;
+
+		void optimise(std::vector<ModelVertex> &vertices, std::vector<uint32_t> &indices, MeshOptimiserStats *stats);
+
+		// collapses bitwise identical vertices, the index buffer is remapped to match
+		void weldVertices(std::vector<ModelVertex> &vertices, std::vector<uint32_t> &indices);
+
+		void optimiseVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount);
+
+		// expects a cache optimised index buffer, only moves whole runs of triangles around so the cache order mostly survives
+		void optimiseOverdraw(std::vector<uint32_t> &indices, const std::vector<ModelVertex> &vertices);
+
+		// also drops any vertex nothing references
+		void optimiseVertexFetch(std::vector<ModelVertex> &vertices, std::vector<uint32_t> &indices);
+
+		uint32_t calcCacheMisses(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize);
+
+		// mesh shader output limits, 124 rather than 128 triangles keeps the index output a multiple of 4 bytes on nvidia
+		constexpr static uint32_t MESHLET_MAX_VERTICES = 64;
+		constexpr static uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+		// splits the index buffer front to back without reordering it, so run it after everything above
+		void buildMeshlets(MeshletData *result, const std::vector<ModelVertex> &vertices, const std::vector<uint32_t> &indices);
+	}
+}
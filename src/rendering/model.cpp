@@ -37,102 +37,57 @@ Mesh::Mesh(GraphicsCore *gfx)
 	, m_parent(nullptr)
 	, m_vertexFormat(nullptr)
 	, m_material(nullptr)
-	, m_vertexBuffer(nullptr)
-	, m_indexBuffer(nullptr)
-	, m_nVertices(0)
-	, m_nIndices(0)
+	, m_geometry()
+	, m_boundingBox()
+	, m_boundingSphere()
+	, m_meshlets()
 {
 }
 
 Mesh::~Mesh()
 {
-	delete m_vertexBuffer;
-	delete m_indexBuffer;
+	if (m_vertexFormat)
+		m_gfx->getGeometryArena().free(m_geometry);
 }
 
 void Mesh::build(
 	const VertexFormat *format,
-	void *pVertices, uint32_t nVertices,
-	uint16_t *pIndices, uint32_t nIndices
+	const void *pVertices, uint32_t nVertices,
+	const uint16_t *pIndices, uint32_t nIndices
 )
 {
 	m_vertexFormat = format;
 
-	m_nVertices = nVertices;
-	m_nIndices = nIndices;
-
-	uint64_t vertexBufferSize = nVertices * m_vertexFormat->getVertexSize();
-	uint64_t indexBufferSize = nIndices * sizeof(uint16_t);
-
-	m_vertexBuffer = m_gfx->createGPUBuffer(
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		vertexBufferSize
-	);
-
-	m_indexBuffer = m_gfx->createGPUBuffer(
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		indexBufferSize
-	);
+	m_geometry = m_gfx->getGeometryArena().allocate(format, pVertices, nVertices, pIndices, nIndices, VK_INDEX_TYPE_UINT16);
+}
 
-	// read data to the stage (todo: yes, i know making a new staging buffer per submesh is idiotic, i just want to get this running quick and cba)
-	GPUBuffer *stagingBuffer = m_gfx->createGPUBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		vertexBufferSize + indexBufferSize
-	);
+void Mesh::build(
+	const VertexFormat *format,
+	const void *pVertices, uint32_t nVertices,
+	const uint32_t *pIndices, uint32_t nIndices
+)
+{
+	m_vertexFormat = format;
 
-	stagingBuffer->write(pVertices, vertexBufferSize, 0);
-	stagingBuffer->write(pIndices, indexBufferSize, vertexBufferSize);
-
-	// make the stage write that data to the gpu buffers
-	CommandBuffer *cmd = m_gfx->beginInstantSubmit();
-	{
-		cmd->copyBufferToBuffer(
-			stagingBuffer,
-			m_vertexBuffer,
-			{{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = vertexBufferSize
-			}}
-		);
-
-		cmd->copyBufferToBuffer(
-			stagingBuffer,
-			m_indexBuffer,
-			{{
-				.srcOffset = vertexBufferSize,
-				.dstOffset = 0,
-				.size = indexBufferSize
-			}}
-		);
-	}
-	m_gfx->submit(cmd);
-
-	// wait when staging buffer needs to delete
-	// todo: yes, this is terrible and there really should just
-	//       be a single staging buffer used for the whole program
-	m_gfx->waitIdle();
-
-	delete stagingBuffer;
+	m_geometry = m_gfx->getGeometryArena().allocate(format, pVertices, nVertices, pIndices, nIndices, VK_INDEX_TYPE_UINT32);
 }
 
 void Mesh::bind(CommandBuffer *cmd) const
 {
+	// the whole block gets bound and draws pick their range with firstIndex / vertexOffset,
+	// so the command buffer drops this entirely when the previous mesh lived in the same block
 	VkDeviceSize vertexBufferOffset = 0;
 
 	cmd->bindVertexBuffers(
 		m_vertexFormat->getBindings()[0].binding,
 		1,
-		&m_vertexBuffer,
+		&m_geometry.vertexBuffer,
 		&vertexBufferOffset
 	);
 
 	cmd->bindIndexBuffer(
-		m_indexBuffer,
+		m_geometry.indexBuffer,
 		0,
-		VK_INDEX_TYPE_UINT16
+		m_geometry.indexType
 	);
 }
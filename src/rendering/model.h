@@ -2,6 +2,13 @@
 
 #include <string>
 #include <vector>
+#include <utility>
+
+#include "math/bounds.h"
+
+#include "graphics/geometry_arena.h"
+
+#include "rendering/mesh_optimiser.h"
 
 namespace mgp
 {
@@ -49,8 +56,15 @@ namespace mgp
 
 		void build(
 			const VertexFormat *format,
-			void *pVertices, uint32_t nVertices,
-			uint16_t *pIndices, uint32_t nIndices
+			const void *pVertices, uint32_t nVertices,
+			const uint16_t *pIndices, uint32_t nIndices
+		);
+
+		// for anything with more vertices than 16 bit indices can reach
+		void build(
+			const VertexFormat *format,
+			const void *pVertices, uint32_t nVertices,
+			const uint32_t *pIndices, uint32_t nIndices
 		);
 
 		void bind(CommandBuffer *cmd) const;
@@ -62,11 +76,26 @@ namespace mgp
 		void setMaterial(Material *material) { m_material = material; }
 		Material *getMaterial() { return m_material; }
 
-		GPUBuffer *getVertexBuffer() { return m_vertexBuffer; }
-		GPUBuffer *getIndexBuffer() { return m_indexBuffer; }
+		// shared with every other mesh in the same geometry block
+		GPUBuffer *getVertexBuffer() { return m_geometry.vertexBuffer; }
+		GPUBuffer *getIndexBuffer() { return m_geometry.indexBuffer; }
+
+		uint32_t getFirstVertex() const { return m_geometry.firstVertex; }
+		uint32_t getFirstIndex() const { return m_geometry.firstIndex; }
+
+		uint64_t getVertexCount() const { return m_geometry.vertexCount; }
+		uint64_t getIndexCount() const { return m_geometry.indexCount; }
 
-		uint64_t getVertexCount() const { return m_nVertices; }
-		uint64_t getIndexCount() const { return m_nIndices; }
+		VkIndexType getIndexType() const { return m_geometry.indexType; }
+
+		// in model space
+		void setBounds(const BoundingBox &box, const BoundingSphere &sphere) { m_boundingBox = box; m_boundingSphere = sphere; }
+		const BoundingBox &getBoundingBox() const { return m_boundingBox; }
+		const BoundingSphere &getBoundingSphere() const { return m_boundingSphere; }
+
+		// cpu copy, the renderer packs every mesh's into shared buffers when it builds the draw records
+		void setMeshlets(MeshletData &&meshlets) { m_meshlets = std::move(meshlets); }
+		const MeshletData &getMeshlets() const { return m_meshlets; }
 
 	private:
 		GraphicsCore *m_gfx;
@@ -76,10 +105,11 @@ namespace mgp
 
 		Material *m_material;
 
-		GPUBuffer *m_vertexBuffer;
-		GPUBuffer *m_indexBuffer;
+		GeometryAllocation m_geometry;
+
+		BoundingBox m_boundingBox;
+		BoundingSphere m_boundingSphere;
 
-		uint32_t m_nVertices;
-		uint32_t m_nIndices;
+		MeshletData m_meshlets;
 	};
 }
@@ -1,10 +1,16 @@
 #include "model_loader.h"
 
 #include <filesystem>
+#include <cfloat>
+#include <thread>
+#include <atomic>
+#include <utility>
 
 #include "core/common.h"
 #include "core/app.h"
 
+#include "math/calc.h"
+
 #include "rendering/vertex_types.h"
 #include "rendering/model.h"
 #include "rendering/material.h"
@@ -17,14 +23,42 @@ ModelLoader::ModelLoader(App *app)
 {
 }
 
+// changing these changes what ends up in the bake, so they feed into the cache key too
+constexpr static uint32_t MODEL_IMPORT_FLAGS =
+	aiProcess_Triangulate |
+	aiProcess_FlipWindingOrder |
+	aiProcess_CalcTangentSpace |
+	aiProcess_FlipUVs;
+
+// the visibility buffer only has this many bits for the triangle within a draw, has to match VISIBILITY_TRIANGLE_BITS in shared/visibility.slang
+constexpr static uint32_t MAX_SUBMESH_TRIANGLES = 1u << 19;
+
 Model *ModelLoader::loadModel(const std::string &path)
 {
-	const aiScene *scene = m_importer.ReadFile(path.c_str(),
-		aiProcess_Triangulate |
-		aiProcess_FlipWindingOrder |
-		aiProcess_CalcTangentSpace |
-		aiProcess_FlipUVs
-	);
+	std::filesystem::path filePath(path);
+	std::string directory = filePath.parent_path().string() + "/";
+
+	// baked copy lives next to the source, the hash in its header says whether it's still current
+	std::string cachePath = path + ".mgpmesh";
+	uint64_t sourceHash = MeshCache::calcSourceHash(path, MODEL_IMPORT_FLAGS);
+
+	MeshCache cache;
+
+	if (sourceHash != 0 && cache.open(cachePath, sourceHash))
+	{
+		mgp_LOG("Loading model from cache: %s", cachePath.c_str());
+
+		Model *mesh = new Model(m_app->getGraphics());
+		mesh->setDirectory(directory);
+
+		// the uploader stages its own copy so the mapping can go as soon as we're done here
+		for (uint32_t i = 0; i < cache.getSubMeshCount(); i++)
+			buildSubMesh(mesh->createMesh(), cache.getSubMesh(i));
+
+		return mesh;
+	}
+
+	const aiScene *scene = m_importer.ReadFile(path.c_str(), MODEL_IMPORT_FLAGS);
 
 	if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
@@ -32,9 +66,6 @@ Model *ModelLoader::loadModel(const std::string &path)
 		return nullptr;
 	}
 
-	std::filesystem::path filePath(path);
-	std::string directory = filePath.parent_path().string() + "/";
-
 	Model *mesh = new Model(m_app->getGraphics());
 	mesh->setDirectory(directory);
 
@@ -47,33 +78,137 @@ Model *ModelLoader::loadModel(const std::string &path)
 
 	mgp_LOG("Loading model...");
 
-	processNodes(mesh, scene->mRootNode, scene, identity);
+	std::vector<SubMeshJob> jobs;
+	processNodes(jobs, scene->mRootNode, scene, identity);
+
+	// sized up front so workers can each fill in their own slot without any locking
+	std::vector<ImportedSubMesh> subMeshes(jobs.size());
+	processSubMeshes(subMeshes, jobs, scene);
+
+	std::vector<BakedSubMesh> baked(subMeshes.size());
+
+	// materials and uploads stay on this thread, the copies all get recorded into the uploader's current batch and go up together
+	for (int i = 0; i < subMeshes.size(); i++)
+	{
+		buildSubMesh(mesh->createMesh(), subMeshes[i].baked);
+		baked[i] = subMeshes[i].baked;
+	}
+
+	MeshOptimiserStats totals = {};
+
+	for (cauto &subMesh : subMeshes)
+	{
+		totals.vertexCountBefore += subMesh.stats.vertexCountBefore;
+		totals.vertexCountAfter += subMesh.stats.vertexCountAfter;
+		totals.cacheMissesBefore += subMesh.stats.cacheMissesBefore;
+		totals.cacheMissesAfter += subMesh.stats.cacheMissesAfter;
+		totals.triangleCount += subMesh.stats.triangleCount;
+	}
+
+	float triangleCount = CalcF::max(1.0f, (float)totals.triangleCount);
+
+	mgp_LOG(
+		"Optimised %s: %u -> %u vertices, ACMR %.3f -> %.3f (%u triangles, %u entry fifo).",
+		filePath.filename().string().c_str(),
+		totals.vertexCountBefore, totals.vertexCountAfter,
+		(float)totals.cacheMissesBefore / triangleCount, (float)totals.cacheMissesAfter / triangleCount,
+		totals.triangleCount, mesh_optimiser::VERTEX_CACHE_SIZE
+	);
+
+	if (sourceHash != 0 && !MeshCache::write(m_app->getPlatform(), cachePath, sourceHash, baked))
+		mgp_LOG("Failed to write mesh cache: %s", cachePath.c_str());
+
+	m_importer.FreeScene();
 
 	return mesh;
 }
 
-void ModelLoader::processNodes(Model *mesh, aiNode *node, const aiScene *scene, const aiMatrix4x4& transform)
+void ModelLoader::processNodes(std::vector<SubMeshJob> &jobs, const aiNode *node, const aiScene *scene, const aiMatrix4x4& transform)
 {
 	for(int i = 0; i < node->mNumMeshes; i++)
 	{
-		aiMesh *assimpMesh = scene->mMeshes[node->mMeshes[i]];
-		processSubMesh(mesh->createMesh(), assimpMesh, scene, node->mTransformation * transform);
+		const aiMesh *assimpMesh = scene->mMeshes[node->mMeshes[i]];
+
+		// everything's been triangulated so a face is at most a triangle, anything too big to address gets cut into several submeshes
+		for (uint32_t firstFace = 0; firstFace < assimpMesh->mNumFaces; firstFace += MAX_SUBMESH_TRIANGLES)
+		{
+			uint32_t faceCount = CalcU::min(assimpMesh->mNumFaces - firstFace, MAX_SUBMESH_TRIANGLES);
+
+			jobs.push_back({ assimpMesh, node->mTransformation * transform, firstFace, faceCount });
+		}
 	}
 
 	for(int i = 0; i < node->mNumChildren; i++)
 	{
-		processNodes(mesh, node->mChildren[i], scene, node->mTransformation * transform);
+		processNodes(jobs, node->mChildren[i], scene, node->mTransformation * transform);
 	}
 }
 
-void ModelLoader::processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScene *scene, const aiMatrix4x4& transform)
+void ModelLoader::processSubMeshes(std::vector<ImportedSubMesh> &subMeshes, const std::vector<SubMeshJob> &jobs, const aiScene *scene)
 {
-	std::vector<ModelVertex> vertices(assimpMesh->mNumVertices);
-	std::vector<uint16_t> indices;
+	std::atomic<uint32_t> nextJob = 0;
+
+	auto workerLoop = [&]() -> void {
+		for (uint32_t i = nextJob++; i < jobs.size(); i = nextJob++)
+			processSubMesh(&subMeshes[i], jobs[i], scene);
+	};
+
+	// no point spinning up more threads than there are submeshes
+	uint32_t workerCount = CalcU::min(CalcU::max(1, std::thread::hardware_concurrency()), (uint32_t)jobs.size());
+
+	std::vector<std::thread> workers;
+
+	for (uint32_t i = 1; i < workerCount; i++)
+		workers.emplace_back(workerLoop);
+
+	// this thread pitches in too rather than just sitting on the joins
+	workerLoop();
+
+	for (auto &worker : workers)
+		worker.join();
+
+	mgp_LOG("Converted %u submeshes on %u threads.", (uint32_t)jobs.size(), workerCount);
+}
+
+void ModelLoader::processSubMesh(ImportedSubMesh *result, const SubMeshJob &job, const aiScene *scene)
+{
+	const aiMesh *assimpMesh = job.assimpMesh;
+	const aiMatrix4x4 &transform = job.transform;
+
+	std::vector<ModelVertex> &vertices = result->vertices;
+	std::vector<uint32_t> &indices = result->indices;
 
-	for (int i = 0; i < assimpMesh->mNumVertices; i++)
+	const uint32_t UNUSED = ~0u;
+
+	// only the vertices this run of faces touches, numbered in the order they're first used
+	std::vector<uint32_t> remap(assimpMesh->mNumVertices, UNUSED);
+	std::vector<uint32_t> sourceVertices;
+
+	for (uint32_t i = job.firstFace; i < job.firstFace + job.faceCount; i++)
 	{
-		const aiVector3D &vtx = transform * assimpMesh->mVertices[i];
+		const aiFace &face = assimpMesh->mFaces[i];
+
+		for (int j = 0; j < face.mNumIndices; j++)
+		{
+			uint32_t source = face.mIndices[j];
+
+			if (remap[source] == UNUSED)
+			{
+				remap[source] = sourceVertices.size();
+				sourceVertices.push_back(source);
+			}
+
+			indices.push_back(remap[source]);
+		}
+	}
+
+	vertices.resize(sourceVertices.size());
+
+	for (int i = 0; i < vertices.size(); i++)
+	{
+		uint32_t source = sourceVertices[i];
+
+		const aiVector3D &vtx = transform * assimpMesh->mVertices[source];
 		
 		ModelVertex vertex = {};
 
@@ -88,7 +223,7 @@ void ModelLoader::processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScen
 
 		if (assimpMesh->HasTextureCoords(0))
 		{
-			const aiVector3D &uv = assimpMesh->mTextureCoords[0][i];
+			const aiVector3D &uv = assimpMesh->mTextureCoords[0][source];
 
 			vertex.uv = { uv.x, uv.y };
 		}
@@ -99,7 +234,7 @@ void ModelLoader::processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScen
 
 		if (assimpMesh->HasVertexColors(0))
 		{
-			const aiColor4D &col = assimpMesh->mColors[0][i];
+			const aiColor4D &col = assimpMesh->mColors[0][source];
 
 			vertex.colour = { col.r, col.g, col.b };
 		}
@@ -110,7 +245,7 @@ void ModelLoader::processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScen
 
 		if (assimpMesh->HasNormals())
 		{
-			const aiVector3D &nml = transform * assimpMesh->mNormals[i]; // this literally wont work lmao
+			const aiVector3D &nml = transform * assimpMesh->mNormals[source]; // this literally wont work lmao
 
 			vertex.normal = { nml.x, nml.y, nml.z };
 		}
@@ -121,8 +256,8 @@ void ModelLoader::processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScen
 
 		if (assimpMesh->HasTangentsAndBitangents())
 		{
-			const aiVector3D &tangent = transform * assimpMesh->mTangents[i];
-			const aiVector3D &bitangent = transform * assimpMesh->mBitangents[i];
+			const aiVector3D &tangent = transform * assimpMesh->mTangents[source];
+			const aiVector3D &bitangent = transform * assimpMesh->mBitangents[source];
 
 			vertex.tangent = { tangent.x, tangent.y, tangent.z };
 			vertex.bitangent = { bitangent.x, bitangent.y, bitangent.z };
@@ -136,70 +271,137 @@ void ModelLoader::processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScen
 		vertices[i] = vertex;
 	}
 
-	for (int i = 0; i < assimpMesh->mNumFaces; i++)
+	mesh_optimiser::optimise(vertices, indices, &result->stats);
+	mesh_optimiser::buildMeshlets(&result->meshlets, vertices, indices);
+
+	// anything 16 bits can address gets the smaller index buffer
+	bool shortIndices = vertices.size() <= 0xFFFF;
+
+	if (shortIndices)
 	{
-		const aiFace &face = assimpMesh->mFaces[i];
+		result->shortIndices.resize(indices.size());
 
-		for (int j = 0; j < face.mNumIndices; j++)
-		{
-			indices.push_back(face.mIndices[j]);
-		}
+		for (int i = 0; i < indices.size(); i++)
+			result->shortIndices[i] = indices[i];
 	}
 
-	submesh->build(
-		&vertex_types::MODEL_VERTEX_FORMAT,
-		vertices.data(), vertices.size(),
-		indices.data(), indices.size()
-	);
+	// bounds for culling, the sphere shares the box's centre which is loose but cheap
+	BoundingBox box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
 
-	if (assimpMesh->mMaterialIndex >= 0)
+	for (cauto &vertex : vertices)
 	{
-		const aiMaterial *assimpMaterial = scene->mMaterials[assimpMesh->mMaterialIndex];
+		box.min = glm::min(box.min, vertex.position);
+		box.max = glm::max(box.max, vertex.position);
+	}
 
-		MaterialData data;
-		data.technique = "texturedPBR_gbuffer_opaque"; // temporarily just the forced material type
+	if (vertices.empty())
+		box = { glm::vec3(0.0f), glm::vec3(0.0f) };
 
-		fetchMaterialBoundTextures(data.textures, submesh->getParent()->getDirectory(), assimpMaterial, aiTextureType_DIFFUSE,				m_app->getTextures().getFallbackDiffuse());
-		fetchMaterialBoundTextures(data.textures, submesh->getParent()->getDirectory(), assimpMaterial, aiTextureType_LIGHTMAP,				m_app->getTextures().getFallbackAmbient());
-		fetchMaterialBoundTextures(data.textures, submesh->getParent()->getDirectory(), assimpMaterial, aiTextureType_DIFFUSE_ROUGHNESS,	m_app->getTextures().getFallbackRoughnessMetallic());
-		fetchMaterialBoundTextures(data.textures, submesh->getParent()->getDirectory(), assimpMaterial, aiTextureType_NORMALS,				m_app->getTextures().getFallbackNormals());
-		fetchMaterialBoundTextures(data.textures, submesh->getParent()->getDirectory(), assimpMaterial, aiTextureType_EMISSIVE,				m_app->getTextures().getFallbackEmissive());
+	BoundingSphere sphere = { box.getCentre(), 0.0f };
 
-		submesh->setMaterial(m_app->getRenderer().buildMaterial(data));
+	for (cauto &vertex : vertices)
+		sphere.radius = CalcF::max(sphere.radius, glm::length(vertex.position - sphere.centre));
+
+	result->packedVertices.resize(vertices.size());
+
+	for (int i = 0; i < vertices.size(); i++)
+		result->packedVertices[i] = vertex_types::packModelVertex(vertices[i], box);
+
+	BakedSubMesh &baked = result->baked;
+	baked.vertices = result->packedVertices.data();
+	baked.vertexCount = vertices.size();
+	baked.indices = shortIndices ? (const void *)result->shortIndices.data() : (const void *)indices.data();
+	baked.indexCount = indices.size();
+	baked.indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	baked.box = box;
+	baked.sphere = sphere;
+	baked.meshlets = result->meshlets.meshlets.data();
+	baked.meshletCount = result->meshlets.meshlets.size();
+	baked.meshletVertices = result->meshlets.vertices.data();
+	baked.meshletVertexCount = result->meshlets.vertices.size();
+	baked.meshletTriangles = result->meshlets.triangles.data();
+	baked.hasMaterial = assimpMesh->mMaterialIndex >= 0;
+
+	if (baked.hasMaterial)
+	{
+		const aiMaterial *assimpMaterial = scene->mMaterials[assimpMesh->mMaterialIndex];
+
+		baked.textures[0] = fetchMaterialTexturePath(assimpMaterial, aiTextureType_DIFFUSE);
+		baked.textures[1] = fetchMaterialTexturePath(assimpMaterial, aiTextureType_LIGHTMAP);
+		baked.textures[2] = fetchMaterialTexturePath(assimpMaterial, aiTextureType_DIFFUSE_ROUGHNESS);
+		baked.textures[3] = fetchMaterialTexturePath(assimpMaterial, aiTextureType_NORMALS);
+		baked.textures[4] = fetchMaterialTexturePath(assimpMaterial, aiTextureType_EMISSIVE);
 	}
 }
 
-void ModelLoader::fetchMaterialBoundTextures(std::vector<BindlessHandle> &textures, const std::string &localPath, const aiMaterial *material, aiTextureType type, Image *fallback)
+void ModelLoader::buildSubMesh(Mesh *submesh, const BakedSubMesh &data)
 {
-	std::vector<Image *> maps = loadMaterialTextures(material, type, localPath);
+	submesh->setBounds(data.box, data.sphere);
+
+	MeshletData meshlets;
+	meshlets.meshlets.assign(data.meshlets, data.meshlets + data.meshletCount);
+	meshlets.vertices.assign(data.meshletVertices, data.meshletVertices + data.meshletVertexCount);
+	meshlets.triangles.assign(data.meshletTriangles, data.meshletTriangles + (data.indexCount / 3));
+
+	submesh->setMeshlets(std::move(meshlets));
 
-	if (maps.size() >= 1)
+	if (data.indexSize == sizeof(uint32_t))
 	{
-		textures.push_back(m_app->getBindlessResources()->fromTexture2D(m_app->getImageViews().fetchStdView(maps[0])));
+		submesh->build(
+			&vertex_types::PACKED_MODEL_VERTEX_FORMAT,
+			data.vertices, data.vertexCount,
+			(const uint32_t *)data.indices, data.indexCount
+		);
 	}
 	else
 	{
-		if (fallback)
+		submesh->build(
+			&vertex_types::PACKED_MODEL_VERTEX_FORMAT,
+			data.vertices, data.vertexCount,
+			(const uint16_t *)data.indices, data.indexCount
+		);
+	}
+
+	if (!data.hasMaterial)
+		return;
+
+	Image *fallbacks[MESH_TEXTURE_SLOT_COUNT] = {
+		m_app->getTextures().getFallbackDiffuse(),
+		m_app->getTextures().getFallbackAmbient(),
+		m_app->getTextures().getFallbackRoughnessMetallic(),
+		m_app->getTextures().getFallbackNormals(),
+		m_app->getTextures().getFallbackEmissive()
+	};
+
+	MaterialData material;
+	material.technique = "texturedPBR_gbuffer_opaque"; // temporarily just the forced material type
+
+	for (int i = 0; i < MESH_TEXTURE_SLOT_COUNT; i++)
+	{
+		if (!data.textures[i].empty())
+		{
+			std::string fullPath = submesh->getParent()->getDirectory() + data.textures[i];
+
+			// samples the fallback until the real thing has streamed in
+			material.textures.push_back(m_app->getTextures().requestTexture(fullPath, fullPath, fallbacks[i]));
+		}
+		else if (fallbacks[i])
 		{
-			textures.push_back(m_app->getBindlessResources()->fromTexture2D(m_app->getImageViews().fetchStdView(fallback)));
+			material.textures.push_back(m_app->getBindlessResources()->fromTexture2D(m_app->getImageViews().fetchStdView(fallbacks[i])));
 		}
 	}
+
+	submesh->setMaterial(m_app->getRenderer().buildMaterial(material));
 }
 
-std::vector<Image *> ModelLoader::loadMaterialTextures(const aiMaterial *material, aiTextureType type, const std::string &localPath)
+std::string ModelLoader::fetchMaterialTexturePath(const aiMaterial *material, aiTextureType type)
 {
-	std::vector<Image *> result;
-
-	for (int i = 0; i < material->GetTextureCount(type); i++)
-	{
-		aiString texturePath;
-		material->GetTexture(type, i, &texturePath);
+	// only the first texture of each type is ever used
+	if (material->GetTextureCount(type) < 1)
+		return "";
 
-		aiString basePath = aiString(localPath.c_str());
-		basePath.Append(texturePath.C_Str());
-
-		result.push_back(m_app->getTextures().loadTexture(basePath.C_Str(), basePath.C_Str()));
-	}
+	aiString texturePath;
+	material->GetTexture(type, 0, &texturePath);
 
-	return result;
+	return texturePath.C_Str();
 }
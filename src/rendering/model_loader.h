@@ -7,6 +7,8 @@
 #include <assimp/postprocess.h>
 
 #include "rendering/bindless.h"
+#include "rendering/mesh_cache.h"
+#include "rendering/mesh_optimiser.h"
 
 namespace mgp
 {
@@ -24,13 +26,38 @@ namespace mgp
 		Model *loadModel(const std::string &path);
 
 	private:
+		// owns the arrays a BakedSubMesh points at when the data came from assimp rather than the cache
+		struct ImportedSubMesh
+		{
+			std::vector<ModelVertex> vertices;
+			std::vector<PackedModelVertex> packedVertices;
+			std::vector<uint32_t> indices;
+			std::vector<uint16_t> shortIndices; // only filled in when every vertex fits in 16 bits
+			MeshletData meshlets;
+			BakedSubMesh baked;
+			MeshOptimiserStats stats;
+		};
+
+		// everything a worker needs to convert one submesh without touching the node tree
+		struct SubMeshJob
+		{
+			const aiMesh *assimpMesh;
+			aiMatrix4x4 transform;
+
+			// big meshes get split into several jobs, each converting its own run of faces
+			uint32_t firstFace;
+			uint32_t faceCount;
+		};
+
 		App *m_app;
 
-		void processNodes(Model *mesh, aiNode *node, const aiScene *scene, const aiMatrix4x4& transform);
-		void processSubMesh(Mesh *submesh, aiMesh *assimpMesh, const aiScene *scene, const aiMatrix4x4& transform);
+		void processNodes(std::vector<SubMeshJob> &jobs, const aiNode *node, const aiScene *scene, const aiMatrix4x4& transform);
+		void processSubMeshes(std::vector<ImportedSubMesh> &subMeshes, const std::vector<SubMeshJob> &jobs, const aiScene *scene);
+		void processSubMesh(ImportedSubMesh *result, const SubMeshJob &job, const aiScene *scene);
+
+		void buildSubMesh(Mesh *submesh, const BakedSubMesh &data);
 
-		void fetchMaterialBoundTextures(std::vector<BindlessHandle> &textures, const std::string &localPath, const aiMaterial *material, aiTextureType type, Image *fallback);
-		std::vector<Image *> loadMaterialTextures(const aiMaterial *material, aiTextureType type, const std::string &localPath);
+		std::string fetchMaterialTexturePath(const aiMaterial *material, aiTextureType type);
 
 		Assimp::Importer m_importer;
 	};
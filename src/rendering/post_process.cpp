@@ -0,0 +1,148 @@
+#include "post_process.h"
+
+#include <utility>
+
+#include "core/common.h"
+
+#include "math/calc.h"
+
+using namespace mgp;
+
+constexpr static float LUT_GAMMA = 2.2f;
+
+static PostProcessSettings getDefaultSettings()
+{
+	PostProcessSettings settings = {};
+	settings.bloomIntensity = 0.05f;
+	settings.bloomThreshold = 1.0f;
+	settings.vignetteIntensity = 0.35f;
+	settings.vignetteRadius = 0.9f;
+	settings.contrast = 1.0f;
+	settings.saturation = 1.0f;
+	settings.temperature = 0.0f;
+
+	return settings;
+}
+
+static float gradeChannel(float x, float contrast)
+{
+	// pivot contrast around mid grey in gamma space
+	return CalcF::clamp((x - 0.5f) * contrast + 0.5f, 0.0f, 1.0f);
+}
+
+PostProcessStack::PostProcessStack()
+	: m_effects()
+	, m_settings()
+{
+	reset();
+}
+
+void PostProcessStack::reset()
+{
+	m_effects = {
+		{ POST_EFFECT_BLOOM,			true },
+		{ POST_EFFECT_TONEMAP,			true },
+		{ POST_EFFECT_COLOUR_GRADING,	true },
+		{ POST_EFFECT_VIGNETTE,			true },
+		{ POST_EFFECT_DITHER,			true }
+	};
+
+	m_settings = getDefaultSettings();
+}
+
+PostProcessPlan PostProcessStack::compile() const
+{
+	PostProcessPlan plan = {};
+
+	for (cauto &effect : m_effects)
+	{
+		if (!effect.enabled)
+			continue;
+
+		if (plan.stageCount >= MAX_FUSED_STAGES)
+		{
+			mgp_ERROR("Too many post effects to fuse into one pass.");
+			break;
+		}
+
+		// only the bits that can't be done one pixel at a time need a pass of their own
+		if (effect.type == POST_EFFECT_BLOOM)
+			plan.bloomChain = true;
+		else if (effect.type == POST_EFFECT_TONEMAP)
+			plan.autoExposure = true;
+
+		plan.packedStages |= (uint32_t)effect.type << (plan.stageCount * 4);
+		plan.stageCount++;
+	}
+
+	return plan;
+}
+
+void PostProcessStack::moveEffect(uint32_t index, int direction)
+{
+	int other = (int)index + direction;
+
+	if (other < 0 || other >= (int)m_effects.size())
+		return;
+
+	std::swap(m_effects[index], m_effects[other]);
+}
+
+void PostProcessStack::bakeColourGradingLUT(std::vector<uint32_t> *texels) const
+{
+	const uint32_t size = COLOUR_GRADING_LUT_SIZE;
+
+	texels->resize(size * size * size);
+
+	// simple white balance, warmer pushes red up and blue down
+	float warmth = m_settings.temperature * 0.1f;
+
+	for (uint32_t b = 0; b < size; b++)
+	{
+		for (uint32_t g = 0; g < size; g++)
+		{
+			for (uint32_t r = 0; r < size; r++)
+			{
+				float colour[3] = {
+					(float)r / (float)(size - 1),
+					(float)g / (float)(size - 1),
+					(float)b / (float)(size - 1)
+				};
+
+				// white balance happens in linear space
+				for (int i = 0; i < 3; i++)
+					colour[i] = CalcF::pow(colour[i], LUT_GAMMA);
+
+				colour[0] *= 1.0f + warmth;
+				colour[2] *= 1.0f - warmth;
+
+				float luma = colour[0]*0.2126f + colour[1]*0.7152f + colour[2]*0.0722f;
+
+				uint32_t texel = 0xFF000000;
+
+				for (int i = 0; i < 3; i++)
+				{
+					float saturated = CalcF::max(CalcF::lerp(luma, colour[i], m_settings.saturation), 0.0f);
+					float graded = gradeChannel(CalcF::pow(saturated, 1.0f / LUT_GAMMA), m_settings.contrast);
+
+					texel |= (uint32_t)CalcF::round(graded * 255.0f) << (i * 8);
+				}
+
+				(*texels)[(b * size * size) + (g * size) + r] = texel;
+			}
+		}
+	}
+}
+
+const char *PostProcessStack::getEffectName(PostEffectType type)
+{
+	switch (type)
+	{
+	case POST_EFFECT_BLOOM:				return "Bloom";
+	case POST_EFFECT_TONEMAP:			return "Tonemap";
+	case POST_EFFECT_COLOUR_GRADING:	return "Colour Grading";
+	case POST_EFFECT_VIGNETTE:			return "Vignette";
+	case POST_EFFECT_DITHER:			return "Dither";
+	default:							return "Unknown";
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <vector>
+
+namespace mgp
+{
+	// the ids are what the composite shader switches on, has to match post_composite_fs.slang
+	enum PostEffectType
+	{
+		POST_EFFECT_BLOOM,
+		POST_EFFECT_TONEMAP,
+		POST_EFFECT_COLOUR_GRADING,
+		POST_EFFECT_VIGNETTE,
+		POST_EFFECT_DITHER,
+		POST_EFFECT_MAX_ENUM
+	};
+
+	struct PostEffect
+	{
+		PostEffectType type;
+		bool enabled;
+	};
+
+	struct PostProcessSettings
+	{
+		float bloomIntensity;
+		float bloomThreshold;
+
+		float vignetteIntensity;
+		float vignetteRadius;
+
+		float contrast;
+		float saturation;
+		float temperature;
+	};
+
+	/*
+		What the effect list boils down to once it's compiled.
+		Effects that need their neighbours get passes of their own ahead of time (the bloom chain, the exposure histogram),
+		then every effect's per-pixel part runs in list order in the one kernel that writes the swapchain, so the hdr target is only read once.
+	*/
+	struct PostProcessPlan
+	{
+		bool bloomChain;
+		bool autoExposure;
+
+		uint32_t stageCount;
+		uint32_t packedStages; // 4 bits per stage, the first in the low bits
+
+		bool operator == (const PostProcessPlan &other) const = default;
+	};
+
+	class PostProcessStack
+	{
+	public:
+		constexpr static uint32_t MAX_FUSED_STAGES = 8;
+
+		constexpr static uint32_t COLOUR_GRADING_LUT_SIZE = 32;
+
+		PostProcessStack();
+		~PostProcessStack() = default;
+
+		PostProcessPlan compile() const;
+
+		// swaps the effect with the one next to it, order is the order the stages run in
+		void moveEffect(uint32_t index, int direction);
+
+		// rgba8 texels, indexed by gamma-encoded colour so the darks get their fair share of the lut
+		void bakeColourGradingLUT(std::vector<uint32_t> *texels) const;
+
+		void reset();
+
+		std::vector<PostEffect> &getEffects() { return m_effects; }
+		const std::vector<PostEffect> &getEffects() const { return m_effects; }
+
+		PostProcessSettings &getSettings() { return m_settings; }
+		const PostProcessSettings &getSettings() const { return m_settings; }
+
+		static const char *getEffectName(PostEffectType type);
+
+	private:
+		std::vector<PostEffect> m_effects;
+		PostProcessSettings m_settings;
+	};
+}
@@ -14,6 +14,10 @@
 #include "core/app.h"
 #include "core/camera.h"
 
+#include "math/calc.h"
+#include "math/frustum.h"
+#include "math/timer.h"
+
 #include "vertex_types.h"
 #include "light.h"
 #include "model.h"
@@ -60,15 +64,10 @@ struct GPU_FrameData
 {
 	glm::mat4 proj;
 	glm::mat4 view;
+	glm::mat4 inverseViewProj;
 	glm::vec4 cameraPosition;
 };
 
-struct GPU_TransformData
-{
-	glm::mat4 model;
-	glm::mat4 normalMatrix;
-};
-
 struct GPU_BindlessMaterial
 {
 	uint32_t diffuse_id;
@@ -85,14 +84,116 @@ struct GPU_ModelPushConstants
 	uint32_t irradianceMap_id;
 	uint32_t prefilterMap_id;
 	uint32_t brdfLUT_id;
-	uint32_t material_id;
 	uint32_t textureSampler_id;
 	uint32_t cubemapSampler_id;
+
+	// only read by the meshlet task shader
+	uint32_t hiZ_id;
+	VkDeviceAddress tasks;
+	uint32_t taskOffset;
+	uint32_t phase;
+};
+
+struct GPU_DrawRecord
+{
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t material_id;
+	uint32_t transform_id;
+	uint32_t batch_id;
+	uint32_t batchOffset; // first command slot of the batch
+	uint32_t indexSize; // bytes, 2 or 4
+	uint32_t firstMeshlet;
+	uint32_t meshletCount; // 0 if the mesh was never split, it's drawn whole
+	uint32_t taskOffset; // first task slot of the batch
+	uint32_t _padding;
+	glm::vec4 boundingSphere;
+	glm::vec4 boundsCentre; // what the packed vertex positions decode against
+	glm::vec4 boundsExtents;
+	VkDeviceAddress vertices;
+	VkDeviceAddress indices;
+};
+
+struct GPU_Meshlet
+{
+	glm::vec4 boundingSphere;
+	glm::vec4 cone; // xyz = axis, w = cutoff
+	uint32_t firstIndex; // relative to the draw
+	uint32_t firstVertex; // into the meshlet vertex buffer
+	uint32_t firstTriangle; // into the meshlet triangle buffer
+	uint32_t counts; // vertices in the low 8 bits, triangles in the next 8
+};
+
+struct GPU_MeshTask
+{
+	uint32_t drawIndex;
+	uint32_t firstMeshlet; // relative to the draw's
+};
+
+struct GPU_CullData
+{
+	glm::vec4 frustum[Frustum::PLANE_MAX_ENUM];
+	float P00;
+	float P11;
+	float P22;
+	float P32;
+	float znear;
+	uint32_t hiZWidth;
+	uint32_t hiZHeight;
+	uint32_t hiZMipCount;
+};
+
+struct GPU_DrawCommandsPushConstants
+{
+	VkDeviceAddress draws;
+	VkDeviceAddress commands;
+	VkDeviceAddress counts;
+	VkDeviceAddress visible;
+	VkDeviceAddress visibility;
+	VkDeviceAddress frameData;
+	VkDeviceAddress transforms;
+	VkDeviceAddress cullData;
+	VkDeviceAddress tasks;
+	VkDeviceAddress taskCommands;
+	uint32_t visibleCount;
+	uint32_t phase;
+	uint32_t output;
+	uint32_t _padding;
+};
+
+struct GPU_MeshletCullPushConstants
+{
+	VkDeviceAddress draws;
+	VkDeviceAddress meshlets;
+	VkDeviceAddress tasks;
+	VkDeviceAddress commands;
+	VkDeviceAddress counts;
+	VkDeviceAddress frameData;
+	VkDeviceAddress transforms;
+	VkDeviceAddress cullData;
+	uint32_t taskOffset;
+	uint32_t phase;
+};
+
+struct GPU_HiZReducePushConstants
+{
+	uint32_t srcWidth;
+	uint32_t srcHeight;
+	uint32_t dstWidth;
+	uint32_t dstHeight;
+	uint32_t firstMip;
 };
 
 struct GPU_DeferredLightingPushConstants
 {
+	VkDeviceAddress frameData;
+	VkDeviceAddress lights;
+	VkDeviceAddress clusters;
+	VkDeviceAddress buffers;
+
 	uint32_t position_id;
+	uint32_t depth_id;
 	uint32_t albedo_id;
 	uint32_t normal_id;
 	uint32_t material_id;
@@ -105,9 +206,79 @@ struct GPU_DeferredLightingPushConstants
 	uint32_t textureSampler_id;
 	uint32_t cubemapSampler_id;
 
-	uint32_t _padding[2];
+	float znear;
+	float zfar;
 
-	glm::vec4 cameraPosition;
+	uint32_t visibility_id;
+};
+
+struct GPU_LightClustersPushConstants
+{
+	VkDeviceAddress lights;
+	VkDeviceAddress clusters;
+	VkDeviceAddress frameData;
+	uint32_t lightCount;
+	float P00;
+	float P11;
+	float znear;
+	float zfar;
+	uint32_t _padding;
+};
+
+struct GPU_LuminanceHistogramPushConstants
+{
+	VkDeviceAddress histogram;
+	uint32_t width;
+	uint32_t height;
+	float minLogLuminance;
+	float inverseLogLuminanceRange;
+};
+
+struct GPU_ExposureAdaptPushConstants
+{
+	VkDeviceAddress histogram;
+	VkDeviceAddress exposure;
+	uint32_t pixelCount;
+	float minLogLuminance;
+	float logLuminanceRange;
+	float deltaTime;
+	float adaptationRate;
+	float exposureCompensation;
+};
+
+struct GPU_BloomDownsamplePushConstants
+{
+	uint32_t srcWidth;
+	uint32_t srcHeight;
+	uint32_t dstWidth;
+	uint32_t dstHeight;
+	uint32_t firstMip;
+	float threshold;
+};
+
+struct GPU_BloomUpsamplePushConstants
+{
+	uint32_t srcWidth;
+	uint32_t srcHeight;
+	uint32_t dstWidth;
+	uint32_t dstHeight;
+};
+
+struct GPU_PostCompositePushConstants
+{
+	VkDeviceAddress exposure;
+	uint32_t stageCount;
+	uint32_t stages;
+	float bloomIntensity;
+	float vignetteIntensity;
+	float vignetteRadius;
+	uint32_t frameIndex;
+};
+
+struct GPU_ExposureData
+{
+	float averageLuminance;
+	float exposure;
 };
 
 struct GPU_PrimitiveVSPushConstants
@@ -120,53 +291,129 @@ struct GPU_ModelBuffers
 	VkDeviceAddress frameData;
 	VkDeviceAddress transforms;
 	VkDeviceAddress materials;
+	VkDeviceAddress draws;
+	VkDeviceAddress cullData;
+	VkDeviceAddress meshlets;
+	VkDeviceAddress meshletVertices;
+	VkDeviceAddress meshletTriangles;
 };
 
-struct GPU_PointLight
-{
-	glm::vec4 position; // [x,y,z]: position
-	glm::vec4 colour; // [x,y,z]: colour, [w]: intensity
-	glm::vec4 attenuation; // [x]*dist^2 + [y]*dist + [z], [w]: has shadows? 0/1
-};
+// matches shared/clusters.slang
+constexpr static uint32_t LIGHT_CLUSTER_COUNT_X = 16;
+constexpr static uint32_t LIGHT_CLUSTER_COUNT_Y = 9;
+constexpr static uint32_t LIGHT_CLUSTER_COUNT_Z = 24;
+constexpr static uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_COUNT_X * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z;
+constexpr static uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+constexpr static uint32_t LUMINANCE_HISTOGRAM_BIN_COUNT = 256;
+
+// range of log2 luminance the histogram covers, anything below the minimum lands in the black bin
+constexpr static float MIN_LOG_LUMINANCE = -10.0f;
+constexpr static float MAX_LOG_LUMINANCE = 2.0f;
+
+constexpr static uint32_t BLOOM_MIP_COUNT = 6;
+
+// has to match VISIBILITY_TRIANGLE_BITS in shared/visibility.slang
+constexpr static uint32_t VISIBILITY_TRIANGLE_BITS = 19;
+constexpr static uint32_t MAX_VISIBILITY_DRAWS = 1u << (32 - VISIBILITY_TRIANGLE_BITS);
 
-struct GPU_DeferredLightingPointLightShadingInput
+// has to match shared/culling.slang and draw_commands_cs.slang
+constexpr static uint32_t MESHLET_TASK_SIZE = 64;
+constexpr static uint32_t DRAW_OUTPUT_DRAWS = 0;
+constexpr static uint32_t DRAW_OUTPUT_MESHLETS = 1;
+
+static const char *GBUFFER_LAYOUT_NAMES[GBUFFER_LAYOUT_MAX_ENUM] = { "Full", "Compact", "Visibility" };
+
+constexpr static float DEFAULT_EXPOSURE_COMPENSATION = 0.0f;
+constexpr static float DEFAULT_EXPOSURE_ADAPTATION_RATE = 1.5f;
+
+// a light's radius is wherever its brightest channel drops below this
+constexpr static float LIGHT_RADIUS_CUTOFF = 1.0f / 256.0f;
+
+// solves a*d^2 + b*d + c = peak / cutoff for the distance d
+static float calcLightRadius(const glm::vec4 &attenuation, float peak)
 {
-    VkDeviceAddress frameData;
-    VkDeviceAddress lights;
+	if (peak <= 0.0f)
+		return 0.0f;
 
-    glm::mat4 model;
+	float a = attenuation.x;
+	float b = attenuation.y;
+	float c = attenuation.z - (peak / LIGHT_RADIUS_CUTOFF);
 
-    uint32_t position_id;
-    uint32_t albedo_id;
-    uint32_t normal_id;
-    uint32_t material_id;
-    uint32_t emissive_id;
+	if (a > 0.0f)
+		return (-b + glm::sqrt(b*b - 4.0f*a*c)) / (2.0f * a);
 
-    uint32_t irradianceMap_id;
-    uint32_t prefilterMap_id;
-    uint32_t brdfLUT_id;
+	if (b > 0.0f)
+		return -c / b;
 
-    uint32_t textureSampler_id;
-};
+	// constant attenuation never drops off, so the light would reach everything
+	return FLT_MAX;
+}
 
 Renderer::Renderer()
 	: m_app(nullptr)
 	, m_renderGraph(nullptr)
-	, m_gBuffer()
-	, m_frameConstantsBuffer(nullptr)
-	, m_transformDataBuffer(nullptr)
-	, m_bindlessMaterialTable(nullptr)
-	, m_pointLightBuffer(nullptr)
+	, m_graphWidth(0)
+	, m_graphHeight(0)
+	, m_context()
+	, m_postProcess()
+	, m_postProcessPlan()
+	, m_frameCount(0)
+	, m_exposureCompensation(DEFAULT_EXPOSURE_COMPENSATION)
+	, m_exposureAdaptationRate(DEFAULT_EXPOSURE_ADAPTATION_RATE)
+	, m_luminanceHistogram(nullptr)
+	, m_exposureData(nullptr)
+	, m_bloom(nullptr)
+	, m_bloomDownsample_descriptors()
+	, m_bloomUpsample_descriptors()
+	, m_colourGradingLUTs()
+	, m_colourGradingLUTIndex(0)
+	, m_colourGradingDirty(false)
+	, m_colourGradingUploadValue(0)
+	, m_colourGradingFramesLeft(0)
+	, m_gBuffers()
+	, m_gBufferLayout(GBUFFER_LAYOUT_COMPACT)
+	, m_frames()
+	, m_transformBuffer()
+	, m_pointLightCapacity(0)
+	, m_gpuPointLights()
+	, m_lightClusters(nullptr)
+	, m_drawRecords(nullptr)
+	, m_drawCommands(nullptr)
+	, m_drawCounts(nullptr)
+	, m_lateDrawCommands(nullptr)
+	, m_lateDrawCounts(nullptr)
+	, m_drawVisibility(nullptr)
+	, m_drawBatches()
+	, m_drawCount(0)
+	, m_drawListVersion(0)
+	, m_meshlets(nullptr)
+	, m_meshletVertices(nullptr)
+	, m_meshletTriangles(nullptr)
+	, m_meshTasks(nullptr)
+	, m_meshTaskCommands(nullptr)
+	, m_lateMeshTasks(nullptr)
+	, m_lateMeshTaskCommands(nullptr)
+	, m_meshletCount(0)
+	, m_meshletCulling(true)
+	, m_drawRecordIndices()
+	, m_visibleDraws()
+	, m_visibleDrawCount(0)
+	, m_cullTime(0.0)
+	, m_hiZ(nullptr)
+	, m_hiZReduce_descriptors()
+	, m_transientPlacement(0)
+	, m_drawCommands_descriptor(nullptr)
 	, m_descriptorPool(nullptr)
-	, m_textureUV_descriptor(nullptr)
-	, m_hdrTonemapping_descriptor(nullptr)
+	, m_postComposite_descriptors()
+	, m_luminanceHistogram_descriptor(nullptr)
 	, m_brdfLUT(nullptr)
 	, m_environmentMap(nullptr)
 	, m_environmentProbe()
 	, m_skyboxMesh(nullptr)
 	, m_skybox_descriptor(nullptr)
-	, m_sphereMesh(nullptr)
 	, m_materials()
+	, m_materialRewrites()
 	, m_techniques()
 	, m_materialFreeIndex(0)
 {
@@ -194,56 +441,114 @@ void Renderer::init(App *app)
 
 	loadTechniques();
 
-	m_frameConstantsBuffer = m_app->getGraphics()->createGPUBuffer(
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		sizeof(GPU_FrameData)
-	);
+	// each frame in flight gets its own copy so we never write over data the gpu is still reading
+	for (auto &frame : m_frames)
+	{
+		frame.frameConstants = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(GPU_FrameData)
+		);
+
+		frame.pointLights = nullptr; // sized to the scene below
+
+		frame.modelBuffers = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(GPU_ModelBuffers)
+		);
+
+		frame.visibleDraws = nullptr; // created along with the draw records
+
+		frame.cullData = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(GPU_CullData)
+		);
+
+		frame.materials = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(GPU_BindlessMaterial) * 128
+		);
+	}
 
-	m_transformDataBuffer = m_app->getGraphics()->createGPUBuffer(
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		sizeof(GPU_TransformData)
+	resizePointLightBuffers(INITIAL_POINT_LIGHT_CAPACITY);
+
+	m_lightClusters = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(uint32_t) * (1 + MAX_LIGHTS_PER_CLUSTER) * LIGHT_CLUSTER_COUNT
 	);
 
-	m_bindlessMaterialTable = m_app->getGraphics()->createGPUBuffer(
+	// both stay on the gpu, the exposure pass reads last frame's result back to adapt from it
+	m_luminanceHistogram = m_app->getGraphics()->createGPUBuffer(
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		sizeof(GPU_BindlessMaterial) * 128
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(uint32_t) * LUMINANCE_HISTOGRAM_BIN_COUNT
 	);
 
-	m_pointLightBuffer = m_app->getGraphics()->createGPUBuffer(
+	m_exposureData = m_app->getGraphics()->createGPUBuffer(
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		sizeof(GPU_PointLight) * MAX_POINT_LIGHTS
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(GPU_ExposureData)
 	);
 
+	uint32_t emptyHistogram[LUMINANCE_HISTOGRAM_BIN_COUNT] = {};
+	GPU_ExposureData initialExposure = { .averageLuminance = 1.0f, .exposure = 1.0f };
+
+	m_app->getGraphics()->getUploader().uploadBuffer(m_luminanceHistogram, emptyHistogram, sizeof(emptyHistogram));
+	m_app->getGraphics()->getUploader().uploadBuffer(m_exposureData, &initialExposure, sizeof(GPU_ExposureData));
+
+	m_transformBuffer.init(m_app->getGraphics());
+
+	writeModelBuffers();
+
 	createSkyboxResources();
 	precomputeBRDF_LUT();
 	generateEnvironmentMaps();
 
-	createUnitSphereMesh();
 	createGBuffer();
+	createPostProcessResources();
 
 	m_skybox_descriptor				= allocateDescriptor	(m_app->getShaders().getShader("skybox")				->getLayouts());
-	m_textureUV_descriptor			= allocateDescriptor	(m_app->getShaders().getShader("texture_uv")			->getLayouts());
-	m_hdrTonemapping_descriptor		= allocateDescriptor	(m_app->getShaders().getShader("hdr_tonemapping")		->getLayouts());
+	m_drawCommands_descriptor		= allocateDescriptor	(m_app->getShaders().getShader("draw_commands")			->getLayouts());
+	m_luminanceHistogram_descriptor	= allocateDescriptor	(m_app->getShaders().getShader("luminance_histogram")	->getLayouts());
 
 	m_skybox_descriptor				->writeCombinedImage	(0, stdView(m_environmentMap),										m_app->getTextures().getLinearSampler());
-	m_textureUV_descriptor			->writeCombinedImage	(0, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING]),	m_app->getTextures().getLinearSampler());
-	m_hdrTonemapping_descriptor		->writeStorageImage		(0, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING]));
+	m_drawCommands_descriptor		->writeCombinedImage	(0, stdView(m_hiZ),													m_app->getTextures().getNearestSampler());
 
-	m_modelBuffersBuffer = m_app->getGraphics()->createGPUBuffer(
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		sizeof(GPU_ModelBuffers)
-	);
+	for (int i = 0; i < m_colourGradingLUTs.size(); i++)
+	{
+		m_postComposite_descriptors[i] = allocateDescriptor(m_app->getShaders().getShader("post_composite")->getLayouts());
+		m_postComposite_descriptors[i]->writeCombinedImage(1, stdView(m_bloom), m_app->getTextures().getLinearSampler());
+		m_postComposite_descriptors[i]->writeCombinedImage(2, stdView(m_colourGradingLUTs[i]), m_app->getTextures().getLinearSampler());
+	}
 
-	m_modelBuffersBuffer->writeType<GPU_ModelBuffers>({
-		.frameData = bufAddr(m_frameConstantsBuffer),
-		.transforms = bufAddr(m_transformDataBuffer),
-		.materials = bufAddr(m_bindlessMaterialTable)
-	});
+	// the first level reads the lighting target instead, but its source still has to point at something
+	for (int i = 0; i < m_bloom->getMipmapCount(); i++)
+	{
+		Descriptor *descriptor = allocateDescriptor(m_app->getShaders().getShader("bloom_downsample")->getLayouts());
+		descriptor->writeStorageImage(1, m_app->getImageViews().fetchView(m_bloom, 1, 0, (i > 0) ? i - 1 : 0, 1));
+		descriptor->writeStorageImage(2, m_app->getImageViews().fetchView(m_bloom, 1, 0, i, 1));
+
+		m_bloomDownsample_descriptors.push_back(descriptor);
+	}
+
+	for (int i = 0; i < m_bloom->getMipmapCount() - 1; i++)
+	{
+		Descriptor *descriptor = allocateDescriptor(m_app->getShaders().getShader("bloom_upsample")->getLayouts());
+		descriptor->writeStorageImage(0, m_app->getImageViews().fetchView(m_bloom, 1, 0, i + 1, 1));
+		descriptor->writeStorageImage(1, m_app->getImageViews().fetchView(m_bloom, 1, 0, i, 1));
+
+		m_bloomUpsample_descriptors.push_back(descriptor);
+	}
+
+	writeLightingDescriptors();
+
+	// these read the depth buffer, which doesn't have any memory until the graph is first recorded
+	for (int i = 0; i < m_hiZ->getMipmapCount(); i++)
+		m_hiZReduce_descriptors.push_back(allocateDescriptor(m_app->getShaders().getShader("hiz_reduce")->getLayouts()));
 }
 
 void Renderer::destroy()
@@ -255,13 +560,44 @@ void Renderer::destroy()
 	delete m_brdfLUT;
 
 	delete m_skyboxMesh;
-	delete m_sphereMesh;
 
-	delete m_frameConstantsBuffer;
-	delete m_transformDataBuffer;
-	delete m_bindlessMaterialTable;
-	delete m_pointLightBuffer;
-	delete m_modelBuffersBuffer;
+	for (auto &frame : m_frames)
+	{
+		delete frame.frameConstants;
+		delete frame.pointLights;
+		delete frame.modelBuffers;
+		delete frame.visibleDraws;
+		delete frame.cullData;
+		delete frame.materials;
+	}
+
+	delete m_lightClusters;
+
+	delete m_luminanceHistogram;
+	delete m_exposureData;
+
+	delete m_bloom;
+	for (Image *lut : m_colourGradingLUTs)
+		delete lut;
+
+	m_transformBuffer.destroy();
+
+	delete m_drawRecords;
+	delete m_drawCommands;
+	delete m_drawCounts;
+	delete m_lateDrawCommands;
+	delete m_lateDrawCounts;
+	delete m_drawVisibility;
+
+	delete m_meshlets;
+	delete m_meshletVertices;
+	delete m_meshletTriangles;
+	delete m_meshTasks;
+	delete m_meshTaskCommands;
+	delete m_lateMeshTasks;
+	delete m_lateMeshTaskCommands;
+
+	delete m_hiZ;
 
 	for (auto &[id, material] : m_materials)
 		delete material;
@@ -271,57 +607,336 @@ void Renderer::destroy()
 	delete m_environmentProbe.irradiance;
 	delete m_environmentProbe.prefilter;
 
-	for (int i = 0; i < GBuffer::ATTACHMENT_MAX_ENUM; i++)
-		delete m_gBuffer.attachments[i];
+	// the rest are owned by the render graph, and layouts with the same lighting format share the one target
+	for (int i = 0; i < GBUFFER_LAYOUT_MAX_ENUM; i++)
+	{
+		Image *lighting = m_gBuffers[i].attachments[GBuffer::ATTACHMENT_LIGHTING];
+		bool shared = false;
+
+		for (int j = 0; j < i; j++)
+			shared |= m_gBuffers[j].attachments[GBuffer::ATTACHMENT_LIGHTING] == lighting;
+
+		if (!shared)
+			delete lighting;
+	}
 }
 
 void Renderer::render(const RenderContext &context)
 {
-	m_frameConstantsBuffer->writeType<GPU_FrameData>({
+	// the cached graph's record functions read from here, so it has to be kept up to date every frame
+	m_context = context;
+	m_frameCount++;
+
+	getFrame().frameConstants->writeType<GPU_FrameData>({
 		.proj = context.camera->getProj(),
 		.view = context.camera->getView(),
+		.inverseViewProj = glm::inverse(context.camera->getProj() * context.camera->getView()),
 		.cameraPosition = glm::vec4(context.camera->position, 1.0f)
 	});
 
-	deferredPass(context);
-	lightingPass(context);
+	// the transform buffer clears the change flags so the bounds have to pick them up first
+	context.scene->updateBounds();
+
+	uploadFrameData();
+
+	// this frame's copy of the material table is free to write now, so catch it up on any retargeted textures
+	for (auto it = m_materialRewrites.begin(); it != m_materialRewrites.end();)
+	{
+		writeMaterialRow(getFrame().materials, it->first);
+
+		if (--it->second == 0)
+			it = m_materialRewrites.erase(it);
+		else
+			it++;
+	}
+
+	ImGui::Begin("Statistics");
+	{
+		ImGui::Text("CPU Wait: %.3fms", m_app->getGraphics()->getFrameWaitTime() * 1000.0);
+
+		ImGui::Separator();
+
+		ImGui::Text("Pipelines Pending: %u", m_app->getPipelines().getPendingCount());
+		ImGui::Text("Pipelines Compiled: %u", m_app->getPipelines().getCompiledCount());
+		ImGui::Text("Textures Streaming: %u", m_app->getTextures().getStreamingCount());
+
+		cauto histogram = m_app->getPipelines().getCompileTimeHistogram();
+
+		float histogramValues[PIPELINE_COMPILE_TIME_BUCKET_COUNT];
+
+		for (int i = 0; i < PIPELINE_COMPILE_TIME_BUCKET_COUNT; i++)
+			histogramValues[i] = histogram[i];
+
+		ImGui::PlotHistogram("Compile Times", histogramValues, PIPELINE_COMPILE_TIME_BUCKET_COUNT, 0, "<1, <2, <4 ... <128, >128 ms", 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+
+		// stats from the previous frame's graph, this one hasn't been recorded yet
+		cauto &graphStats = m_renderGraph->getStats();
 
-	renderSkybox(context);
+		ImGui::Separator();
+
+		ImGui::Text("Graph Passes: %u (%u culled)", graphStats.passCount, graphStats.culledPassCount);
+		ImGui::Text("Barrier Batches: %u", graphStats.barrierBatchCount);
+		ImGui::Text("Image Barriers: %u", graphStats.imageBarrierCount);
+		ImGui::Text("Buffer Barriers: %u", graphStats.bufferBarrierCount);
+		ImGui::Text("Transient Memory: %.2fMB (%.2fMB unaliased)", graphStats.transientMemoryAliased / (1024.0 * 1024.0), graphStats.transientMemoryUnaliased / (1024.0 * 1024.0));
+		ImGui::Text("Async Compute Batches: %u (%u queue transfers)", graphStats.asyncBatchCount, graphStats.queueTransferCount);
+
+		ImGui::Separator();
+
+		ImGui::Text("Indirect Draws: %u (%zu batches)", m_drawCount, m_drawBatches.size());
+		ImGui::Text("Meshlets: %u (%s)", m_meshletCount, !usesMeshletCulling() ? "not culled" : (usesMeshShaders() ? "mesh shaders" : "compute"));
+
+		// the task buffers stay around either way, only the passes change
+		if (ImGui::Checkbox("Meshlet Culling", &m_meshletCulling))
+			m_renderGraph->invalidate();
+
+		ImGui::Text("Frustum Culling: %u / %u visible in %.3fms", m_visibleDrawCount, m_drawCount, m_cullTime * 1000.0);
+		ImGui::Text("Transforms: %u uploaded in %u ranges", m_transformBuffer.getUploadedCount(), m_transformBuffer.getUploadRangeCount());
+		ImGui::Text("Point Lights: %d (%ux%ux%u clusters)", m_context.scene->getPointLightCount(), LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y, LIGHT_CLUSTER_COUNT_Z);
+		ImGui::Text("Geometry: %.2fMB / %.2fMB (%u blocks)", m_app->getGraphics()->getGeometryArena().getUsedMemory() / (1024.0 * 1024.0), m_app->getGraphics()->getGeometryArena().getReservedMemory() / (1024.0 * 1024.0), m_app->getGraphics()->getGeometryArena().getBlockCount());
+	}
+	ImGui::End();
 	
-	// tonemapping
+	// g-buffer
+	{
+		int layoutIndex = m_gBufferLayout;
+
+		ImGui::Begin("G-Buffer");
+		{
+			if (ImGui::BeginCombo("Layout", GBUFFER_LAYOUT_NAMES[layoutIndex]))
+			{
+				for (int i = 0; i < GBUFFER_LAYOUT_MAX_ENUM; i++)
+				{
+					// too many draws and the visibility buffer would resolve pixels against the wrong one
+					bool disabled = (i == GBUFFER_LAYOUT_VISIBILITY && !canUseVisibilityLayout());
+
+					if (ImGui::Selectable(GBUFFER_LAYOUT_NAMES[i], i == layoutIndex, disabled ? ImGuiSelectableFlags_Disabled : 0))
+						layoutIndex = i;
+				}
+
+				ImGui::EndCombo();
+			}
+
+			for (int i = 0; i < GBUFFER_LAYOUT_MAX_ENUM; i++)
+			{
+				cauto &gBuffer = m_gBuffers[i];
+
+				// everything the geometry and lighting passes write, and so later read back
+				uint64_t size = 0;
+
+				for (int j = 0; j < GBuffer::ATTACHMENT_MAX_ENUM; j++)
+				{
+					if (gBuffer.attachments[j])
+						size += gBuffer.attachments[j]->getMemoryRequirements().size;
+				}
+
+				double pixelCount = (double)gBuffer.attachments[GBuffer::ATTACHMENT_DEPTH]->getWidth() * gBuffer.attachments[GBuffer::ATTACHMENT_DEPTH]->getHeight();
+
+				ImGui::Text("%s: %.2fMB (%.1f bytes / pixel)", GBUFFER_LAYOUT_NAMES[i], size / (1024.0 * 1024.0), size / pixelCount);
+			}
+		}
+		ImGui::End();
+
+		if (layoutIndex != m_gBufferLayout)
+			setGBufferLayout((GBufferLayout)layoutIndex);
+	}
+
+	// post processing
 	{
-		static bool enabled = true;
-		static float exposure = 1.12f;
+		PostProcessSettings &settings = m_postProcess.getSettings();
+		PostProcessSettings previousSettings = settings;
+
+		bool reset = false;
 
-		ImGui::Begin("Tonemapping");
+		ImGui::Begin("Post Processing");
 		{
-			ImGui::Checkbox("Enabled", &enabled);
-			ImGui::SliderFloat("Exposure", &exposure, 0.0f, 2.0f);
+			auto &effects = m_postProcess.getEffects();
+
+			for (int i = 0; i < effects.size(); i++)
+			{
+				ImGui::PushID(i);
+
+				ImGui::Checkbox(PostProcessStack::getEffectName(effects[i].type), &effects[i].enabled);
+
+				ImGui::SameLine(160.0f);
+
+				if (ImGui::ArrowButton("up", ImGuiDir_Up))
+					m_postProcess.moveEffect(i, -1);
+
+				ImGui::SameLine();
+
+				if (ImGui::ArrowButton("down", ImGuiDir_Down))
+					m_postProcess.moveEffect(i, 1);
+
+				ImGui::PopID();
+			}
+
+			ImGui::Separator();
+
+			ImGui::SliderFloat("Bloom Intensity", &settings.bloomIntensity, 0.0f, 0.5f);
+			ImGui::SliderFloat("Bloom Threshold", &settings.bloomThreshold, 0.0f, 4.0f);
+			ImGui::SliderFloat("Exposure Compensation (EV)", &m_exposureCompensation, -4.0f, 4.0f);
+			ImGui::SliderFloat("Adaptation Rate", &m_exposureAdaptationRate, 0.1f, 10.0f);
+			ImGui::SliderFloat("Contrast", &settings.contrast, 0.5f, 1.5f);
+			ImGui::SliderFloat("Saturation", &settings.saturation, 0.0f, 2.0f);
+			ImGui::SliderFloat("Temperature", &settings.temperature, -1.0f, 1.0f);
+			ImGui::SliderFloat("Vignette Intensity", &settings.vignetteIntensity, 0.0f, 1.0f);
+			ImGui::SliderFloat("Vignette Radius", &settings.vignetteRadius, 0.5f, 1.5f);
 
 			if (ImGui::Button("Reset"))
-				exposure = 1.12f;
+			{
+				m_postProcess.reset();
+				m_exposureCompensation = DEFAULT_EXPOSURE_COMPENSATION;
+				m_exposureAdaptationRate = DEFAULT_EXPOSURE_ADAPTATION_RATE;
+
+				reset = true;
+			}
 		}
 		ImGui::End();
 
-		if (enabled)
+		if (reset ||
+			settings.contrast != previousSettings.contrast ||
+			settings.saturation != previousSettings.saturation ||
+			settings.temperature != previousSettings.temperature)
 		{
-			tonemappingPass(exposure);
+			m_colourGradingDirty = true;
 		}
+
+		updateColourGradingLUT();
+
+		// reordering or toggling stages only changes push constants, the graph only cares about the extra passes
+		PostProcessPlan plan = m_postProcess.compile();
+
+		if (plan.bloomChain != m_postProcessPlan.bloomChain || plan.autoExposure != m_postProcessPlan.autoExposure)
+			m_renderGraph->invalidate();
+
+		m_postProcessPlan = plan;
 	}
-	
+
+	if (context.swapchain->getWidth() != m_graphWidth || context.swapchain->getHeight() != m_graphHeight)
+		m_renderGraph->invalidate();
+
+	// the graph holds on to the draw buffers so it has to be rebuilt along with them
+	if (context.scene->getRenderListVersion() != m_drawListVersion)
+	{
+		buildDrawRecords();
+		m_renderGraph->invalidate();
+	}
+
+	cullScene();
+
+	if (!m_renderGraph->isCompiled())
+		buildRenderGraph();
+
+	m_renderGraph->recordTo(context.cmd, context.swapchain);
+}
+
+void Renderer::buildRenderGraph()
+{
+	m_graphWidth = m_context.swapchain->getWidth();
+	m_graphHeight = m_context.swapchain->getHeight();
+
+	if (!m_drawBatches.empty())
+		drawCullPass(DRAW_CULL_PHASE_EARLY);
+
+	deferredPass(DRAW_CULL_PHASE_EARLY);
+
+	if (!m_drawBatches.empty())
+	{
+		hiZPass();
+		drawCullPass(DRAW_CULL_PHASE_LATE);
+		deferredPass(DRAW_CULL_PHASE_LATE);
+	}
+
+	lightClusterPass();
+	lightingPass();
+
+	renderSkybox();
+
+	if (m_postProcessPlan.bloomChain)
+		bloomPass();
+
+	if (m_postProcessPlan.autoExposure)
+	{
+		luminanceHistogramPass();
+		exposureAdaptPass();
+	}
+
+	compositePass();
+}
+
+void Renderer::uploadFrameData()
+{
+	// growing the transform buffer moves it, so every frame's copy of the addresses has to follow
+	if (m_transformBuffer.update(m_context.scene, m_app->getGraphics()->getCurrentFrameIndex()))
+		writeModelBuffers();
+
+	cauto &lights = m_context.scene->getPointLights();
+
+	if (lights.size() > m_pointLightCapacity)
+	{
+		uint32_t capacity = m_pointLightCapacity;
+
+		while (capacity < lights.size())
+			capacity *= 2;
+
+		// frames in flight are still reading the old copies
+		m_app->getGraphics()->waitIdle();
+
+		resizePointLightBuffers(capacity);
+	}
+
+	m_gpuPointLights.resize(lights.size());
+
+	for (int i = 0; i < lights.size(); i++)
+	{
+		cauto &light = lights[i];
+
+		glm::vec3 pos = light.getPosition();
+		glm::vec3 col = light.getColour().getDisplayColour();
+
+		GPU_PointLight &gpuLight = m_gpuPointLights[i];
+		gpuLight.colour			= { col.x, col.y, col.z, light.getIntensity() };
+		gpuLight.attenuation	= { 1.0f, 0.0f, 0.0f, 0.0f };
+		gpuLight.position		= { pos.x, pos.y, pos.z, calcLightRadius(gpuLight.attenuation, light.getIntensity() * CalcF::max(col.x, CalcF::max(col.y, col.z))) };
+	}
+
+	if (!m_gpuPointLights.empty())
+		getFrame().pointLights->write(m_gpuPointLights.data(), sizeof(GPU_PointLight) * m_gpuPointLights.size(), 0);
+}
+
+void Renderer::resizePointLightBuffers(uint32_t capacity)
+{
+	for (auto &frame : m_frames)
+	{
+		delete frame.pointLights;
+
+		frame.pointLights = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(GPU_PointLight) * capacity
+		);
+	}
+
+	m_pointLightCapacity = capacity;
+}
+
+void Renderer::compositePass()
+{
 	m_renderGraph->addPass(RenderPassDef()
-		.setAttachments({ RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, context.swapchain->getCurrentView(), nullptr, Colour::black()) })
-		.setInputViews({ stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING])})
+		.setAttachments({ RenderGraphAttachment::getSwapchain(VK_ATTACHMENT_LOAD_OP_CLEAR, Colour::black()) })
+		.setInputViews({ stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]), stdView(m_bloom) })
+		.setInputBuffers({ m_exposureData })
 		.setRecordFn([&](CommandBuffer *cmd, const RenderInfo &info) -> void
 		{
-			// render target
+			// every per-pixel post effect, fused into the blit to the swapchain
 			{
-				GraphicsPipelineDef textureUVPipeline;
-				textureUVPipeline.setShader(m_app->getShaders().getShader("texture_uv"));
-				textureUVPipeline.setDepthTest(false);
-				textureUVPipeline.setDepthWrite(false);
+				GraphicsPipelineDef postCompositePipeline;
+				postCompositePipeline.setShader(m_app->getShaders().getShader("post_composite"));
+				postCompositePipeline.setDepthTest(false);
+				postCompositePipeline.setDepthWrite(false);
 
-				PipelineState pipelineData = m_app->getPipelines().fetchGraphicsPipeline(textureUVPipeline, info);
+				PipelineState pipelineData = m_app->getPipelines().fetchGraphicsPipeline(postCompositePipeline, info);
 
 				cmd->bindPipeline(
 					VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -332,10 +947,28 @@ void Renderer::render(const RenderContext &context)
 					0,
 					VK_PIPELINE_BIND_POINT_GRAPHICS,
 					pipelineData.layout,
-					{ m_textureUV_descriptor },
+					{ m_postComposite_descriptors[m_colourGradingLUTIndex] },
 					{}
 				);
 
+				cauto &settings = m_postProcess.getSettings();
+
+				GPU_PostCompositePushConstants pc = {};
+				pc.exposure				= bufAddr(m_exposureData);
+				pc.stageCount			= m_postProcessPlan.stageCount;
+				pc.stages				= m_postProcessPlan.packedStages;
+				pc.bloomIntensity		= settings.bloomIntensity;
+				pc.vignetteIntensity	= settings.vignetteIntensity;
+				pc.vignetteRadius		= settings.vignetteRadius;
+				pc.frameIndex			= m_frameCount;
+
+				cmd->pushConstants(
+					pipelineData.layout,
+					VK_SHADER_STAGE_ALL_GRAPHICS,
+					sizeof(GPU_PostCompositePushConstants),
+					&pc
+				);
+
 				cmd->draw(3);
 			}
 
@@ -350,8 +983,6 @@ void Renderer::render(const RenderContext &context)
 			}
 		})
 	);
-
-	m_renderGraph->recordTo(context.cmd, context.swapchain);
 }
 
 void Renderer::shadowPass(const RenderContext &context)
@@ -443,261 +1074,965 @@ void Renderer::shadowPass(const RenderContext &context)
 	*/
 }
 
-void Renderer::deferredPass(const RenderContext &context)
+void Renderer::buildDrawRecords()
 {
-	glm::mat4 transformMatrix = glm::identity<glm::mat4>();//context.scene->getRenderObjects()[0].transform.getMatrix();
+	cauto &renderList = m_context.scene->getRenderList();
 
-	m_transformDataBuffer->writeType<GPU_TransformData>({
-		.model = transformMatrix,
-		.normalMatrix = glm::transpose(glm::inverse(transformMatrix))
-	});
+	m_drawListVersion = m_context.scene->getRenderListVersion();
 
-	m_renderGraph->addPass(RenderPassDef()
-		.setAttachments({
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_POSITION]), nullptr, Colour::black()),
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_ALBEDO]), nullptr, Colour::black()),
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_NORMAL]), nullptr, Colour::black()),
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_MATERIAL]), nullptr, Colour::black()),
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_EMISSIVE]), nullptr, Colour::black()),
-			RenderGraphAttachment::getDepth(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_DEPTH]), nullptr, 1.0f, 0)
-		})
-		.setRecordFn([&](CommandBuffer *cmd, const RenderInfo &info) -> void
-		{
-			uint64_t currentPipelineHash = 0;
+	// frames still in flight are reading the old buffers
+	m_app->getGraphics()->waitIdle();
 
-			context.scene->foreachMesh([&](uint32_t meshIndex, Mesh *mesh) -> bool
-			{
-				Material *mat = mesh->getMaterial();
+	delete m_drawRecords;
+	delete m_drawCommands;
+	delete m_drawCounts;
+	delete m_lateDrawCommands;
+	delete m_lateDrawCounts;
+	delete m_drawVisibility;
+	delete m_meshlets;
+	delete m_meshletVertices;
+	delete m_meshletTriangles;
+	delete m_meshTasks;
+	delete m_meshTaskCommands;
+	delete m_lateMeshTasks;
+	delete m_lateMeshTaskCommands;
+
+	m_drawRecords = nullptr;
+	m_drawCommands = nullptr;
+	m_drawCounts = nullptr;
+	m_lateDrawCommands = nullptr;
+	m_lateDrawCounts = nullptr;
+	m_drawVisibility = nullptr;
+	m_meshlets = nullptr;
+	m_meshletVertices = nullptr;
+	m_meshletTriangles = nullptr;
+	m_meshTasks = nullptr;
+	m_meshTaskCommands = nullptr;
+	m_lateMeshTasks = nullptr;
+	m_lateMeshTaskCommands = nullptr;
+
+	for (auto &frame : m_frames)
+	{
+		delete frame.visibleDraws;
+		frame.visibleDraws = nullptr;
+	}
 
-				PipelineState pipelineData = m_app->getPipelines().fetchGraphicsPipeline(mat->getPipeline(SHADER_PASS_DEFERRED), info);
+	m_drawBatches.clear();
+	m_drawCount = renderList.size();
+	m_meshletCount = 0;
 
-				if (meshIndex == 0)
-				{
-					cmd->bindDescriptors(
-						0,
-						VK_PIPELINE_BIND_POINT_GRAPHICS,
-						pipelineData.layout,
-						{ m_app->getBindlessResources()->getDescriptor() },
-						{}
-					);
-				}
+	m_drawRecordIndices.resize(renderList.size());
 
-				if (meshIndex == 0 || currentPipelineHash != mat->getHash())
-				{
-					cmd->bindPipeline(
-						VK_PIPELINE_BIND_POINT_GRAPHICS,
-						pipelineData.pipeline
-					);
+	if (renderList.empty())
+		return;
 
-					currentPipelineHash = mat->getHash();
-				}
+	// draw ids past the limit would wrap around and shade with another draw's triangles, so don't even try
+	if (m_gBufferLayout == GBUFFER_LAYOUT_VISIBILITY && !canUseVisibilityLayout())
+	{
+		mgp_LOG("More draws than the visibility buffer can address (%zu / %u), falling back to the compact layout.", renderList.size(), MAX_VISIBILITY_DRAWS);
+		setGBufferLayout(GBUFFER_LAYOUT_COMPACT);
+	}
 
-				GPU_ModelPushConstants pushConstants = {};
-				pushConstants.buffers				= bufAddr(m_modelBuffersBuffer);
-				pushConstants.irradianceMap_id		= cbmIdx(stdView(m_environmentProbe.irradiance));
-				pushConstants.prefilterMap_id		= cbmIdx(stdView(m_environmentProbe.prefilter));
-				pushConstants.brdfLUT_id			= tex2DIdx(stdView(m_brdfLUT));
-				pushConstants.material_id			= mat->getTableIndex();
-				pushConstants.cubemapSampler_id		= smpIdx(m_app->getTextures().getLinearSampler());
-				pushConstants.textureSampler_id		= smpIdx(m_app->getTextures().getLinearSampler());
+	// anything with the same pipeline and buffers can go out in the same indirect call
+	std::unordered_map<uint64_t, uint32_t> batchLookup;
+	std::vector<uint32_t> meshBatches(renderList.size());
 
-				cmd->pushConstants(
-					pipelineData.layout,
-					VK_SHADER_STAGE_ALL_GRAPHICS,
-					sizeof(GPU_ModelPushConstants),
-					&pushConstants
-				);
+	for (int i = 0; i < renderList.size(); i++)
+	{
+		Mesh *mesh = renderList[i];
 
-				mesh->bind(cmd);
+		uint64_t pipelineHash = mesh->getMaterial()->getPipeline(SHADER_PASS_DEFERRED).getHash();
+		const GPUBuffer *vertexBuffer = mesh->getVertexBuffer();
+		const GPUBuffer *indexBuffer = mesh->getIndexBuffer();
 
-				int id = 0;
+		uint64_t key = 0;
+		hash::combine(&key, &pipelineHash);
+		hash::combine(&key, &vertexBuffer);
+		hash::combine(&key, &indexBuffer);
 
-				cmd->drawIndexed(mesh->getIndexCount(), 1, 0, 0, id);
+		auto it = batchLookup.find(key);
 
-				return true; // continue
-			});
-		})
+		if (it == batchLookup.end())
+		{
+			it = batchLookup.insert({ key, m_drawBatches.size() }).first;
+			m_drawBatches.push_back({ mesh, 0, 0 });
+		}
+
+		uint32_t meshletCount = mesh->getMeshlets().meshlets.size();
+
+		meshBatches[i] = it->second;
+		m_drawBatches[it->second].drawCount++;
+		m_drawBatches[it->second].commandCount += CalcU::max(meshletCount, 1);
+		m_drawBatches[it->second].meshletDrawCount += (meshletCount > 0) ? 1 : 0;
+		m_drawBatches[it->second].taskCount += (meshletCount + MESHLET_TASK_SIZE - 1) / MESHLET_TASK_SIZE;
+	}
+
+	uint32_t firstDraw = 0;
+	uint32_t firstCommand = 0;
+	uint32_t firstTask = 0;
+
+	for (auto &batch : m_drawBatches)
+	{
+		batch.firstDraw = firstDraw;
+		batch.firstCommand = firstCommand;
+		batch.firstTask = firstTask;
+
+		firstDraw += batch.drawCount;
+		firstCommand += batch.commandCount;
+		firstTask += batch.taskCount;
+	}
+
+	// instances of the same mesh share its meshlets
+	std::unordered_map<const Mesh *, uint32_t> meshletLookup;
+	std::vector<GPU_Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint32_t> meshletTriangles;
+
+	for (cauto &mesh : renderList)
+	{
+		cauto &data = mesh->getMeshlets();
+
+		if (data.meshlets.empty() || meshletLookup.contains(mesh))
+			continue;
+
+		meshletLookup.insert({ mesh, meshlets.size() });
+
+		uint32_t firstVertex = meshletVertices.size();
+		uint32_t firstTriangle = meshletTriangles.size();
+
+		for (cauto &meshlet : data.meshlets)
+		{
+			GPU_Meshlet gpuMeshlet = {};
+			gpuMeshlet.boundingSphere = glm::vec4(meshlet.centre, meshlet.radius);
+			gpuMeshlet.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+			gpuMeshlet.firstIndex = meshlet.firstIndex;
+			gpuMeshlet.firstVertex = firstVertex + meshlet.firstVertex;
+			gpuMeshlet.firstTriangle = firstTriangle + (meshlet.firstIndex / 3);
+			gpuMeshlet.counts = meshlet.vertexCount | (meshlet.triangleCount << 8);
+
+			meshlets.push_back(gpuMeshlet);
+		}
+
+		meshletVertices.insert(meshletVertices.end(), data.vertices.begin(), data.vertices.end());
+		meshletTriangles.insert(meshletTriangles.end(), data.triangles.begin(), data.triangles.end());
+	}
+
+	m_meshletCount = meshlets.size();
+
+	// records are laid out batch by batch so each batch's commands end up contiguous
+	std::vector<GPU_DrawRecord> records(renderList.size());
+	std::vector<uint32_t> batchCursors(m_drawBatches.size(), 0);
+
+	for (int i = 0; i < renderList.size(); i++)
+	{
+		Mesh *mesh = renderList[i];
+
+		uint32_t batchIndex = meshBatches[i];
+		cauto &batch = m_drawBatches[batchIndex];
+
+		const RenderObject *owner = mesh->getParent()->getOwner();
+
+		m_drawRecordIndices[i] = batch.firstDraw + batchCursors[batchIndex];
+		batchCursors[batchIndex]++;
+
+		GPU_DrawRecord &record = records[m_drawRecordIndices[i]];
+
+		// the loader splits anything bigger, past this the visibility buffer's triangle id would spill into the draw id
+		mgp_ASSERT(mesh->getIndexCount() / 3 <= (1u << VISIBILITY_TRIANGLE_BITS), "Mesh has more triangles than the visibility buffer can address.");
+
+		record.indexCount = mesh->getIndexCount();
+		record.firstIndex = mesh->getFirstIndex();
+		record.vertexOffset = mesh->getFirstVertex();
+		record.material_id = mesh->getMaterial()->getTableIndex();
+		record.transform_id = owner ? owner->index : 0;
+		record.batch_id = batchIndex;
+		record.batchOffset = batch.firstCommand;
+		record.boundingSphere = glm::vec4(mesh->getBoundingSphere().centre, mesh->getBoundingSphere().radius);
+		record.boundsCentre = glm::vec4(mesh->getBoundingBox().getCentre(), 0.0f);
+		record.boundsExtents = glm::vec4(mesh->getBoundingBox().getExtents(), 0.0f);
+		record.vertices = bufAddr(mesh->getVertexBuffer());
+		record.indices = bufAddr(mesh->getIndexBuffer());
+		record.indexSize = GeometryArena::getIndexSize(mesh->getIndexType());
+		record.firstMeshlet = 0;
+		record.meshletCount = 0;
+		record.taskOffset = batch.firstTask;
+
+		auto meshletIt = meshletLookup.find(mesh);
+
+		if (meshletIt != meshletLookup.end())
+		{
+			record.firstMeshlet = meshletIt->second;
+			record.meshletCount = mesh->getMeshlets().meshlets.size();
+		}
+	}
+
+	m_drawRecords = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(GPU_DrawRecord) * records.size()
+	);
+
+	m_drawCommands = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(VkDrawIndexedIndirectCommand) * firstCommand
+	);
+
+	m_drawCounts = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(uint32_t) * m_drawBatches.size()
 	);
+
+	m_lateDrawCommands = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(VkDrawIndexedIndirectCommand) * firstCommand
+	);
+
+	m_lateDrawCounts = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(uint32_t) * m_drawBatches.size()
+	);
+
+	m_drawVisibility = m_app->getGraphics()->createGPUBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		(VmaAllocationCreateFlagBits)0,
+		sizeof(uint32_t) * records.size()
+	);
+
+	for (auto &frame : m_frames)
+	{
+		frame.visibleDraws = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(uint32_t) * records.size()
+		);
+	}
+
+	if (m_meshletCount > 0)
+	{
+		m_meshlets = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(GPU_Meshlet) * meshlets.size()
+		);
+
+		m_meshletVertices = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(uint32_t) * meshletVertices.size()
+		);
+
+		m_meshletTriangles = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(uint32_t) * meshletTriangles.size()
+		);
+
+		m_meshTasks = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(GPU_MeshTask) * firstTask
+		);
+
+		m_lateMeshTasks = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(GPU_MeshTask) * firstTask
+		);
+
+		// the same layout works for both the mesh tasks draw and the fallback's dispatch
+		m_meshTaskCommands = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(VkDrawMeshTasksIndirectCommandEXT) * m_drawBatches.size()
+		);
+
+		m_lateMeshTaskCommands = m_app->getGraphics()->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			(VmaAllocationCreateFlagBits)0,
+			sizeof(VkDrawMeshTasksIndirectCommandEXT) * m_drawBatches.size()
+		);
+
+		m_app->getGraphics()->getUploader().uploadBuffer(m_meshlets, meshlets.data(), sizeof(GPU_Meshlet) * meshlets.size());
+		m_app->getGraphics()->getUploader().uploadBuffer(m_meshletVertices, meshletVertices.data(), sizeof(uint32_t) * meshletVertices.size());
+		m_app->getGraphics()->getUploader().uploadBuffer(m_meshletTriangles, meshletTriangles.data(), sizeof(uint32_t) * meshletTriangles.size());
+	}
+
+	m_app->getGraphics()->getUploader().uploadBuffer(m_drawRecords, records.data(), sizeof(GPU_DrawRecord) * records.size());
+
+	// nothing counts as visible to begin with, so the first frame draws everything in the late phase
+	std::vector<uint32_t> visibility(records.size(), 0);
+	m_app->getGraphics()->getUploader().uploadBuffer(m_drawVisibility, visibility.data(), sizeof(uint32_t) * visibility.size());
+
+	writeModelBuffers();
+}
+
+void Renderer::cullScene()
+{
+	m_visibleDrawCount = 0;
+
+	if (m_drawCount == 0)
+		return;
+
+	Timer timer(m_app->getPlatform());
+	timer.start();
+
+	glm::mat4 proj = m_context.camera->getProj();
+
+	Frustum frustum(proj * m_context.camera->getView());
+
+	cullFrustum(frustum, m_context.scene->getBounds(), &m_visibleDraws);
+
+	// the gpu goes over the survivors again, this time against the hi-z pyramid as well
+	GPU_CullData cullData = {};
+
+	for (int i = 0; i < Frustum::PLANE_MAX_ENUM; i++)
+		cullData.frustum[i] = frustum.getPlane(i);
+
+	cullData.P00 = proj[0][0];
+	cullData.P11 = proj[1][1];
+	cullData.P22 = proj[2][2];
+	cullData.P32 = proj[3][2];
+	cullData.znear = m_context.camera->near;
+	cullData.hiZWidth = m_hiZ->getWidth();
+	cullData.hiZHeight = m_hiZ->getHeight();
+	cullData.hiZMipCount = m_hiZ->getMipmapCount();
+
+	getFrame().cullData->writeType(cullData);
+
+	// the gpu wants them as draw records, the draw commands pass only has to go over what's left
+	for (auto &index : m_visibleDraws)
+		index = m_drawRecordIndices[index];
+
+	m_visibleDrawCount = m_visibleDraws.size();
+
+	if (m_visibleDrawCount > 0)
+		getFrame().visibleDraws->write(m_visibleDraws.data(), sizeof(uint32_t) * m_visibleDrawCount, 0);
+
+	m_cullTime = timer.getElapsedSeconds();
+}
+
+void Renderer::writeLightingDescriptors()
+{
+	m_luminanceHistogram_descriptor	->writeCombinedImage	(0, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]),	m_app->getTextures().getNearestSampler());
+
+	for (auto &descriptor : m_postComposite_descriptors)
+		descriptor->writeCombinedImage(0, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]), m_app->getTextures().getLinearSampler());
+
+	for (auto &descriptor : m_bloomDownsample_descriptors)
+		descriptor->writeCombinedImage(0, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]), m_app->getTextures().getNearestSampler());
 }
 
-void Renderer::lightingPass(const RenderContext &context)
+void Renderer::setGBufferLayout(GBufferLayout layout)
 {
-	for (int i = 0; i < context.scene->getPointLightCount(); i++)
+	// the descriptors pointing at the lighting target can't change under frames still in flight
+	m_app->getGraphics()->waitIdle();
+
+	m_gBufferLayout = layout;
+
+	writeLightingDescriptors();
+
+	m_renderGraph->invalidate();
+}
+
+void Renderer::writeTransientDescriptors()
+{
+	// the graph has only just (re)placed its transients and waited on the gpu to do so, so rewriting in place is fine
+	if (m_transientPlacement == m_renderGraph->getTransientPlacement())
+		return;
+
+	for (int i = 0; i < m_hiZReduce_descriptors.size(); i++)
 	{
-		auto &light = context.scene->getPointLights()[i];
+		m_hiZReduce_descriptors[i]->writeCombinedImage(0, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_DEPTH]), m_app->getTextures().getNearestSampler());
+		m_hiZReduce_descriptors[i]->writeStorageImage(1, m_app->getImageViews().fetchView(m_hiZ, 1, 0, (i > 0) ? i - 1 : 0, 1));
+		m_hiZReduce_descriptors[i]->writeStorageImage(2, m_app->getImageViews().fetchView(m_hiZ, 1, 0, i, 1));
+	}
 
-		glm::vec3 pos = light.getPosition();
-		glm::vec3 col = light.getColour().getDisplayColour();
-		glm::vec3 dir = light.getDirection();
+	for (cauto &gBuffer : m_gBuffers)
+	{
+		for (int i = 0; i < GBuffer::ATTACHMENT_MAX_ENUM; i++)
+		{
+			if (i != GBuffer::ATTACHMENT_LIGHTING && gBuffer.attachments[i])
+				m_app->getBindlessResources()->refreshTexture2D(stdView(gBuffer.attachments[i]));
+		}
+	}
 
-		GPU_PointLight gpuLight = {};
-		gpuLight.position		= { pos.x, pos.y, pos.z, 0.0f };
-		gpuLight.colour			= { col.x, col.y, col.z, light.getIntensity() };
-		gpuLight.attenuation	= { 1.0f, 0.0f, 0.0f, 0.0f };
+	m_transientPlacement = m_renderGraph->getTransientPlacement();
+}
 
-		m_pointLightBuffer->writeType(gpuLight, i);
+void Renderer::writeModelBuffers()
+{
+	for (int i = 0; i < m_frames.size(); i++)
+	{
+		m_frames[i].modelBuffers->writeType<GPU_ModelBuffers>({
+			.frameData = bufAddr(m_frames[i].frameConstants),
+			.transforms = bufAddr(m_transformBuffer.getBuffer(i)),
+			.materials = bufAddr(m_frames[i].materials),
+			.draws = m_drawRecords ? bufAddr(m_drawRecords) : 0, // filled in once there's something to draw
+			.cullData = bufAddr(m_frames[i].cullData),
+			.meshlets = m_meshlets ? bufAddr(m_meshlets) : 0,
+			.meshletVertices = m_meshletVertices ? bufAddr(m_meshletVertices) : 0,
+			.meshletTriangles = m_meshletTriangles ? bufAddr(m_meshletTriangles) : 0
+		});
 	}
+}
 
-	std::vector<ImageView *> inputViews = {
-		stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_POSITION]),
-		stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_ALBEDO]),
-		stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_NORMAL]),
-		stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_MATERIAL]),
-		stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_EMISSIVE])
-	};
+void Renderer::drawCullPass(DrawCullPhase phase)
+{
+	GPUBuffer *commands = (phase == DRAW_CULL_PHASE_EARLY) ? m_drawCommands : m_lateDrawCommands;
+	GPUBuffer *counts = (phase == DRAW_CULL_PHASE_EARLY) ? m_drawCounts : m_lateDrawCounts;
+	GPUBuffer *tasks = (phase == DRAW_CULL_PHASE_EARLY) ? m_meshTasks : m_lateMeshTasks;
+	GPUBuffer *taskCommands = (phase == DRAW_CULL_PHASE_EARLY) ? m_meshTaskCommands : m_lateMeshTaskCommands;
 
-	// lighting pass
-	m_renderGraph->addPass(RenderPassDef()
-		.setAttachments({
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING]), nullptr, Colour::black()),
-			RenderGraphAttachment::getDepth(VK_ATTACHMENT_LOAD_OP_LOAD, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_DEPTH]))
-		})
+	bool meshletCulling = usesMeshletCulling();
+	bool meshShaders = usesMeshShaders();
+
+	std::vector<GPUBuffer *> inputBuffers = { m_drawRecords };
+	std::vector<GPUBuffer *> storageBuffers = { commands, counts, m_drawVisibility };
+	std::vector<ImageView *> inputViews;
+
+	if (meshletCulling)
+	{
+		inputBuffers.push_back(m_meshlets);
+		storageBuffers.push_back(tasks);
+		storageBuffers.push_back(taskCommands);
+	}
+
+	if (phase == DRAW_CULL_PHASE_LATE)
+		inputViews = { stdView(m_hiZ) };
+
+	m_renderGraph->addTask(ComputeTaskDef()
+		.setInputBuffers(inputBuffers)
+		.setStorageBuffers(storageBuffers)
 		.setInputViews(inputViews)
-		.setRecordFn([&, context](CommandBuffer *cmd, const RenderInfo &info) -> void
+		.setRecordFn([&, phase, commands, counts, tasks, taskCommands, meshletCulling, meshShaders](CommandBuffer *cmd) -> void
 		{
-			// ambient lighting
+			// the counts are cleared with a transfer, which the graph's compute barriers don't cover
+			// the task shader isn't a stage the graph knows about either, so last frame's reads of the task buffers are waited on here
+			// last frame's late cull writing the visibility flags is the graph's job, every buffer starts the frame as written by anything
+			VkMemoryBarrier2 clearBarrier = {};
+			clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+			clearBarrier.srcStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | (meshShaders ? VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_2_NONE);
+			clearBarrier.srcAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+			clearBarrier.dstStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+			cmd->pipelineBarrier(0, { clearBarrier }, {}, {});
+
+			cmd->fillBuffer(counts, 0, VK_WHOLE_SIZE, 0);
+
+			if (meshletCulling)
+				cmd->fillBuffer(taskCommands, 0, VK_WHOLE_SIZE, 0);
+
+			VkMemoryBarrier2 countBarrier = {};
+			countBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+			countBarrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+			countBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			countBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			countBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+			cmd->pipelineBarrier(0, { countBarrier }, {}, {});
+
+			ComputePipelineDef drawCommandsPipeline;
+			drawCommandsPipeline.setShader(m_app->getShaders().getShader("draw_commands"));
+
+			PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(drawCommandsPipeline);
+
+			cmd->bindPipeline(
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineState.pipeline
+			);
+
+			// only sampled in the late phase, the early one leaves it alone
+			cmd->bindDescriptors(
+				0,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineState.layout,
+				{ m_drawCommands_descriptor },
+				{}
+			);
+
+			GPU_DrawCommandsPushConstants pc = {};
+			pc.draws		= bufAddr(m_drawRecords);
+			pc.commands		= bufAddr(commands);
+			pc.counts		= bufAddr(counts);
+			pc.visible		= bufAddr(getFrame().visibleDraws);
+			pc.visibility	= bufAddr(m_drawVisibility);
+			pc.frameData	= bufAddr(getFrame().frameConstants);
+			pc.transforms	= bufAddr(m_transformBuffer.getBuffer(m_app->getGraphics()->getCurrentFrameIndex()));
+			pc.cullData		= bufAddr(getFrame().cullData);
+			pc.tasks		= meshletCulling ? bufAddr(tasks) : 0;
+			pc.taskCommands	= meshletCulling ? bufAddr(taskCommands) : 0;
+			pc.visibleCount	= m_visibleDrawCount;
+			pc.phase		= phase;
+			pc.output		= meshletCulling ? DRAW_OUTPUT_MESHLETS : DRAW_OUTPUT_DRAWS;
+
+			cmd->pushConstants(
+				pipelineState.layout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				sizeof(GPU_DrawCommandsPushConstants),
+				&pc
+			);
+
+			// nothing visible still has to clear the counts so the draws come out empty
+			if (m_visibleDrawCount > 0)
+				cmd->dispatch((m_visibleDrawCount + 63) / 64, 1, 1);
+
+			if (meshShaders)
+			{
+				// the graph hands the task counts over to the indirect draw, the tasks themselves and the pyramid are read by the task shader
+				VkMemoryBarrier2 taskBarrier = {};
+				taskBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+				taskBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+				taskBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+				taskBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT;
+				taskBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+				cmd->pipelineBarrier(0, { taskBarrier }, {}, {});
+			}
+			else if (meshletCulling)
 			{
-				GraphicsPipelineDef ambientLightingPipeline;
-				ambientLightingPipeline.setShader(m_app->getShaders().getShader("deferred_lighting_ambient"));
-				ambientLightingPipeline.setDepthTest(false);
-				ambientLightingPipeline.setDepthWrite(false);
+				meshletCullPass(cmd, phase);
+			}
+		})
+	);
+}
 
-				PipelineState pipelineData = m_app->getPipelines().fetchGraphicsPipeline(ambientLightingPipeline, info);
+void Renderer::meshletCullPass(CommandBuffer *cmd, DrawCullPhase phase)
+{
+	GPUBuffer *commands = (phase == DRAW_CULL_PHASE_EARLY) ? m_drawCommands : m_lateDrawCommands;
+	GPUBuffer *counts = (phase == DRAW_CULL_PHASE_EARLY) ? m_drawCounts : m_lateDrawCounts;
+	GPUBuffer *tasks = (phase == DRAW_CULL_PHASE_EARLY) ? m_meshTasks : m_lateMeshTasks;
+	GPUBuffer *taskCommands = (phase == DRAW_CULL_PHASE_EARLY) ? m_meshTaskCommands : m_lateMeshTaskCommands;
 
-				cmd->bindPipeline(
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipelineData.pipeline
-				);
+	// runs inside the draw commands task, whose tasks and task counts it picks up, the graph only sees the two as one
+	VkMemoryBarrier2 taskBarrier = {};
+	taskBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	taskBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	taskBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	taskBarrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	taskBarrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+	cmd->pipelineBarrier(0, { taskBarrier }, {}, {});
+
+	ComputePipelineDef meshletCullPipeline;
+	meshletCullPipeline.setShader(m_app->getShaders().getShader("meshlet_cull"));
+
+	PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(meshletCullPipeline);
+
+	cmd->bindPipeline(
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineState.pipeline
+	);
+
+	cmd->bindDescriptors(
+		0,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineState.layout,
+		{ m_drawCommands_descriptor },
+		{}
+	);
+
+	GPU_MeshletCullPushConstants pc = {};
+	pc.draws		= bufAddr(m_drawRecords);
+	pc.meshlets		= bufAddr(m_meshlets);
+	pc.tasks		= bufAddr(tasks);
+	pc.commands		= bufAddr(commands);
+	pc.counts		= bufAddr(counts);
+	pc.frameData	= bufAddr(getFrame().frameConstants);
+	pc.transforms	= bufAddr(m_transformBuffer.getBuffer(m_app->getGraphics()->getCurrentFrameIndex()));
+	pc.cullData		= bufAddr(getFrame().cullData);
+	pc.phase		= phase;
+
+	// one dispatch per batch, sized by however many tasks the draws in it handed over
+	for (int i = 0; i < m_drawBatches.size(); i++)
+	{
+		cauto &batch = m_drawBatches[i];
+
+		if (batch.taskCount == 0)
+			continue;
+
+		pc.taskOffset = batch.firstTask;
+
+		cmd->pushConstants(
+			pipelineState.layout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			sizeof(GPU_MeshletCullPushConstants),
+			&pc
+		);
+
+		cmd->dispatchIndirect(taskCommands, sizeof(VkDispatchIndirectCommand) * i);
+	}
+}
+
+void Renderer::hiZPass()
+{
+	Image *depth = getGBuffer().attachments[GBuffer::ATTACHMENT_DEPTH];
+
+	m_renderGraph->addTask(ComputeTaskDef()
+		.setInputViews({ stdView(depth) })
+		.setStorageViews({ stdView(m_hiZ) })
+		.setRecordFn([&, depth](CommandBuffer *cmd) -> void
+		{
+			// the depth buffer has memory by now
+			writeTransientDescriptors();
+
+			ComputePipelineDef hiZReducePipeline;
+			hiZReducePipeline.setShader(m_app->getShaders().getShader("hiz_reduce"));
+
+			PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(hiZReducePipeline);
+
+			cmd->bindPipeline(
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineState.pipeline
+			);
+
+			uint32_t srcWidth = depth->getWidth();
+			uint32_t srcHeight = depth->getHeight();
+
+			for (int i = 0; i < m_hiZReduce_descriptors.size(); i++)
+			{
+				GPU_HiZReducePushConstants pc = {};
+				pc.srcWidth		= srcWidth;
+				pc.srcHeight	= srcHeight;
+				pc.dstWidth		= CalcU::max(m_hiZ->getWidth() >> i, 1);
+				pc.dstHeight	= CalcU::max(m_hiZ->getHeight() >> i, 1);
+				pc.firstMip		= (i == 0) ? 1 : 0;
 
 				cmd->bindDescriptors(
 					0,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipelineData.layout,
-					{ m_app->getBindlessResources()->getDescriptor() },
+					VK_PIPELINE_BIND_POINT_COMPUTE,
+					pipelineState.layout,
+					{ m_hiZReduce_descriptors[i] },
 					{}
 				);
 
-				GPU_DeferredLightingPushConstants pc = {};
-				pc.position_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_POSITION]));
-				pc.albedo_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_ALBEDO]));
-				pc.normal_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_NORMAL]));
-				pc.material_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_MATERIAL]));
-				pc.emissive_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_EMISSIVE]));
-				pc.irradianceMap_id		= cbmIdx(stdView(m_environmentProbe.irradiance));
-				pc.prefilterMap_id		= cbmIdx(stdView(m_environmentProbe.prefilter));
-				pc.brdfLUT_id			= tex2DIdx(stdView(m_brdfLUT));
-				pc.textureSampler_id	= smpIdx(m_app->getTextures().getLinearSampler());
-				pc.cubemapSampler_id	= smpIdx(m_app->getTextures().getLinearSampler());
-				pc.cameraPosition		= { context.camera->position.x, context.camera->position.y, context.camera->position.z, 0.0f };
-			
 				cmd->pushConstants(
-					pipelineData.layout,
-					VK_SHADER_STAGE_ALL_GRAPHICS,
-					sizeof(GPU_DeferredLightingPushConstants),
+					pipelineState.layout,
+					VK_SHADER_STAGE_COMPUTE_BIT,
+					sizeof(GPU_HiZReducePushConstants),
 					&pc
 				);
 
-				cmd->draw(3);
+				cmd->dispatch((pc.dstWidth + 7) / 8, (pc.dstHeight + 7) / 8, 1);
+
+				// the next level reads this one, the graph only sees the pyramid as a whole
+				VkMemoryBarrier2 levelBarrier = {};
+				levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+				levelBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+				levelBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+				levelBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+				levelBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+				cmd->pipelineBarrier(0, { levelBarrier }, {}, {});
+
+				srcWidth = pc.dstWidth;
+				srcHeight = pc.dstHeight;
 			}
+		})
+	);
+}
+
+void Renderer::deferredPass(DrawCullPhase phase)
+{
+	GPUBuffer *commands = (phase == DRAW_CULL_PHASE_EARLY) ? m_drawCommands : m_lateDrawCommands;
+	GPUBuffer *counts = (phase == DRAW_CULL_PHASE_EARLY) ? m_drawCounts : m_lateDrawCounts;
+	GPUBuffer *tasks = (phase == DRAW_CULL_PHASE_EARLY) ? m_meshTasks : m_lateMeshTasks;
+	GPUBuffer *taskCommands = (phase == DRAW_CULL_PHASE_EARLY) ? m_meshTaskCommands : m_lateMeshTaskCommands;
+
+	bool meshShaders = usesMeshShaders();
+
+	std::vector<GPUBuffer *> indirectBuffers;
+
+	if (meshShaders)
+		indirectBuffers = { taskCommands, commands, counts };
+	else if (!m_drawBatches.empty())
+		indirectBuffers = { commands, counts };
+
+	// the late phase draws on top of what the early one left behind
+	VkAttachmentLoadOp loadOp = (phase == DRAW_CULL_PHASE_EARLY) ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+
+	ShaderPassType shaderPass = SHADER_PASS_DEFERRED;
+	ShaderPassType meshletShaderPass = SHADER_PASS_DEFERRED_MESHLET;
+
+	if (m_gBufferLayout == GBUFFER_LAYOUT_COMPACT)
+	{
+		shaderPass = SHADER_PASS_DEFERRED_COMPACT;
+		meshletShaderPass = SHADER_PASS_DEFERRED_COMPACT_MESHLET;
+	}
+	else if (m_gBufferLayout == GBUFFER_LAYOUT_VISIBILITY)
+	{
+		shaderPass = SHADER_PASS_VISIBILITY;
+	}
+
+	std::vector<RenderGraphAttachment> attachments;
 
-			// direct lighting
+	for (int i = 0; i < GBuffer::ATTACHMENT_LIGHTING; i++)
+	{
+		if (getGBuffer().attachments[i])
+			attachments.push_back(RenderGraphAttachment::getColour(loadOp, stdView(getGBuffer().attachments[i]), nullptr, Colour::black()));
+	}
+
+	attachments.push_back(RenderGraphAttachment::getDepth(loadOp, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_DEPTH]), nullptr, 1.0f, 0));
+
+	m_renderGraph->addPass(RenderPassDef()
+		.setAttachments(attachments)
+		.setIndirectBuffers(indirectBuffers)
+		.setRecordFn([&, phase, commands, counts, tasks, taskCommands, meshShaders, shaderPass, meshletShaderPass](CommandBuffer *cmd, const RenderInfo &info) -> void
+		{
+			uint64_t currentPipelineHash = 0;
+			VkPipelineLayout currentLayout = VK_NULL_HANDLE;
+
+			// the mesh shader pipelines push to more stages, so switching between the two paths needs everything bound again
+			auto bindPipeline = [&](const GraphicsPipelineDef &pipelineDef) -> PipelineState
 			{
-				GraphicsPipelineDef directLightingPipeline;
-				directLightingPipeline.setShader(m_app->getShaders().getShader("deferred_lighting_point_light"));
-				directLightingPipeline.setVertexFormat(&vertex_types::PRIMITIVE_VERTEX_FORMAT);
-				directLightingPipeline.setDepthTest(false);
-				directLightingPipeline.setDepthWrite(false);
-				directLightingPipeline.setCullMode(VK_CULL_MODE_FRONT_BIT);
+				PipelineState pipelineData = m_app->getPipelines().tryFetchGraphicsPipeline(pipelineDef, info);
 
-				BlendState st;
-				st.enabled = true;
-				st.colour.op = VK_BLEND_OP_ADD;
-				st.colour.dst = VK_BLEND_FACTOR_ONE;
-				st.colour.src = VK_BLEND_FACTOR_ONE;
+				// still compiling in the background, skip it for now rather than hitching
+				if (pipelineData.pipeline == VK_NULL_HANDLE)
+					return pipelineData;
 
-				directLightingPipeline.setBlendState(st);
+				if (currentLayout != pipelineData.layout)
+				{
+					cmd->bindDescriptors(
+						0,
+						VK_PIPELINE_BIND_POINT_GRAPHICS,
+						pipelineData.layout,
+						{ m_app->getBindlessResources()->getDescriptor() },
+						{}
+					);
 
-				PipelineState pipelineSt = m_app->getPipelines().fetchGraphicsPipeline(directLightingPipeline, info);
+					// the same for every draw, the rest comes from the draw records
+					GPU_ModelPushConstants pushConstants = {};
+					pushConstants.buffers				= bufAddr(getFrame().modelBuffers);
+					pushConstants.irradianceMap_id		= cbmIdx(stdView(m_environmentProbe.irradiance));
+					pushConstants.prefilterMap_id		= cbmIdx(stdView(m_environmentProbe.prefilter));
+					pushConstants.brdfLUT_id			= tex2DIdx(stdView(m_brdfLUT));
+					pushConstants.cubemapSampler_id		= smpIdx(m_app->getTextures().getLinearSampler());
+					pushConstants.textureSampler_id		= smpIdx(m_app->getTextures().getLinearSampler());
+					pushConstants.hiZ_id				= meshShaders ? tex2DIdx(stdView(m_hiZ)) : 0;
+					pushConstants.tasks					= meshShaders ? bufAddr(tasks) : 0;
+					pushConstants.phase					= phase;
 
-				cmd->bindPipeline(
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipelineSt.pipeline
-				);
+					cmd->pushConstants(
+						pipelineData.layout,
+						pipelineDef.getShader()->getPushConstantStages(),
+						sizeof(GPU_ModelPushConstants),
+						&pushConstants
+					);
 
-				cmd->bindDescriptors(
-					0,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipelineSt.layout,
-					{ m_app->getBindlessResources()->getDescriptor() },
-					{}
-				);
+					currentLayout = pipelineData.layout;
+					currentPipelineHash = ~pipelineDef.getHash(); // force a bind below
+				}
 
-				m_sphereMesh->bind(cmd);
+				if (currentPipelineHash != pipelineDef.getHash())
+				{
+					cmd->bindPipeline(
+						VK_PIPELINE_BIND_POINT_GRAPHICS,
+						pipelineData.pipeline
+					);
+
+					currentPipelineHash = pipelineDef.getHash();
+				}
+
+				return pipelineData;
+			};
 
-				// todo: instanced rendering
-				for (int i = 0; i < context.scene->getPointLightCount(); i++)
+			for (int i = 0; i < m_drawBatches.size(); i++)
+			{
+				cauto &batch = m_drawBatches[i];
+
+				if (meshShaders && batch.meshletDrawCount > 0)
 				{
-					cauto &l = context.scene->getPointLights()[i];
+					cauto &pipelineDef = batch.mesh->getMaterial()->getPipeline(meshletShaderPass);
+
+					PipelineState pipelineData = bindPipeline(pipelineDef);
 
-					struct
+					if (pipelineData.pipeline != VK_NULL_HANDLE)
 					{
-						VkDeviceAddress frameData;
-						VkDeviceAddress lights;
+						// the task shader pulls everything else through the draw records, only where the batch's tasks start changes
+						uint32_t taskOffset = batch.firstTask;
+
+						cmd->pushConstants(
+							pipelineData.layout,
+							pipelineDef.getShader()->getPushConstantStages(),
+							sizeof(uint32_t),
+							&taskOffset,
+							offsetof(GPU_ModelPushConstants, taskOffset)
+						);
+
+						cmd->drawMeshTasksIndirect(
+							taskCommands,
+							sizeof(VkDrawMeshTasksIndirectCommandEXT) * i,
+							1,
+							sizeof(VkDrawMeshTasksIndirectCommandEXT)
+						);
+					}
+				}
+
+				// without mesh shaders the meshlets come out as indexed draws along with everything else
+				if (meshShaders && batch.meshletDrawCount == batch.drawCount)
+					continue;
+
+				if (bindPipeline(batch.mesh->getMaterial()->getPipeline(shaderPass)).pipeline == VK_NULL_HANDLE)
+					continue;
+
+				batch.mesh->bind(cmd);
+
+				cmd->drawIndexedIndirectCount(
+					commands,
+					sizeof(VkDrawIndexedIndirectCommand) * batch.firstCommand,
+					counts,
+					sizeof(uint32_t) * i,
+					batch.commandCount,
+					sizeof(VkDrawIndexedIndirectCommand)
+				);
+			}
+		})
+	);
+}
+
+void Renderer::lightClusterPass()
+{
+	m_renderGraph->addTask(ComputeTaskDef()
+		.setStorageBuffers({ m_lightClusters })
+		.setRecordFn([&](CommandBuffer *cmd) -> void
+		{
+			ComputePipelineDef lightClustersPipeline;
+			lightClustersPipeline.setShader(m_app->getShaders().getShader("light_clusters"));
 
-						glm::mat4 model;
+			PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(lightClustersPipeline);
+
+			cmd->bindPipeline(
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineState.pipeline
+			);
 
-						uint32_t position_id;
-						uint32_t albedo_id;
-						uint32_t normal_id;
-						uint32_t material_id;
-						uint32_t emissive_id;
+			glm::mat4 proj = m_context.camera->getProj();
+
+			GPU_LightClustersPushConstants pc = {};
+			pc.lights		= bufAddr(getFrame().pointLights);
+			pc.clusters		= bufAddr(m_lightClusters);
+			pc.frameData	= bufAddr(getFrame().frameConstants);
+			pc.lightCount	= m_context.scene->getPointLightCount();
+			pc.P00			= proj[0][0];
+			pc.P11			= proj[1][1];
+			pc.znear		= m_context.camera->near;
+			pc.zfar			= m_context.camera->far;
+
+			cmd->pushConstants(
+				pipelineState.layout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				sizeof(GPU_LightClustersPushConstants),
+				&pc
+			);
+
+			// every cluster gets its count written even without any lights, so there's nothing to clear beforehand
+			cmd->dispatch((LIGHT_CLUSTER_COUNT + 63) / 64, 1, 1);
+		})
+	);
+}
+
+void Renderer::lightingPass()
+{
+	// depth is read rather than attached, the compact layout rebuilds position from it
+	std::vector<ImageView *> inputViews;
+
+	for (int i = 0; i < GBuffer::ATTACHMENT_MAX_ENUM; i++)
+	{
+		if (i != GBuffer::ATTACHMENT_LIGHTING && getGBuffer().attachments[i])
+			inputViews.push_back(stdView(getGBuffer().attachments[i]));
+	}
+
+	// the visibility buffer gets its material data straight from the draws
+	std::vector<GPUBuffer *> inputBuffers = { m_lightClusters };
+
+	if (m_gBufferLayout == GBUFFER_LAYOUT_VISIBILITY && m_drawRecords)
+	{
+		inputBuffers.push_back(m_drawRecords);
+	}
+
+	// ambient and every light in one go, each pixel only goes over the lights binned into its cluster
+	m_renderGraph->addPass(RenderPassDef()
+		.setAttachments({
+			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_CLEAR, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]), nullptr, Colour::black())
+		})
+		.setInputViews(inputViews)
+		.setInputBuffers(inputBuffers)
+		.setRecordFn([&](CommandBuffer *cmd, const RenderInfo &info) -> void
+		{
+			const char *shaderNames[GBUFFER_LAYOUT_MAX_ENUM] = { "deferred_lighting", "deferred_lighting_compact", "deferred_lighting_visibility" };
+
+			GraphicsPipelineDef lightingPipeline;
+			lightingPipeline.setShader(m_app->getShaders().getShader(shaderNames[m_gBufferLayout]));
+			lightingPipeline.setDepthTest(false);
+			lightingPipeline.setDepthWrite(false);
+
+			PipelineState pipelineData = m_app->getPipelines().fetchGraphicsPipeline(lightingPipeline, info);
+
+			cmd->bindPipeline(
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineData.pipeline
+			);
+
+			cmd->bindDescriptors(
+				0,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineData.layout,
+				{ m_app->getBindlessResources()->getDescriptor() },
+				{}
+			);
 
-						uint32_t brdfLUT_id;
+			writeTransientDescriptors();
 
-						uint32_t textureSampler_id;
-						
-						uint32_t light_id;
-					}
-					pc;
-					
-					float heuristicR = 4.0f;
-
-					pc.frameData			= bufAddr(m_frameConstantsBuffer);
-					pc.lights				= bufAddr(m_pointLightBuffer);
-					pc.position_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_POSITION]));
-					pc.albedo_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_ALBEDO]));
-					pc.normal_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_NORMAL]));
-					pc.material_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_MATERIAL]));
-					pc.emissive_id			= tex2DIdx(stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_EMISSIVE]));
-					pc.brdfLUT_id			= tex2DIdx(stdView(m_brdfLUT));
-					pc.textureSampler_id	= smpIdx(m_app->getTextures().getLinearSampler());
-					
-					pc.model = glm::identity<glm::mat4>()
-						* glm::translate(glm::identity<glm::mat4>(), l.getPosition())
-						* glm::scale(glm::identity<glm::mat4>(), { heuristicR, heuristicR, heuristicR });
-
-					pc.light_id = i;
+			// layouts leave out whatever their lighting shader doesn't read
+			auto attachmentIdx = [&](int attachment) -> uint32_t
+			{
+				Image *image = getGBuffer().attachments[attachment];
+				return image ? tex2DIdx(stdView(image)) : 0;
+			};
+
+			GPU_DeferredLightingPushConstants pc = {};
+			pc.frameData			= bufAddr(getFrame().frameConstants);
+			pc.lights				= bufAddr(getFrame().pointLights);
+			pc.clusters				= bufAddr(m_lightClusters);
+			pc.buffers				= bufAddr(getFrame().modelBuffers);
+			pc.position_id			= attachmentIdx(GBuffer::ATTACHMENT_POSITION);
+			pc.depth_id				= attachmentIdx(GBuffer::ATTACHMENT_DEPTH);
+			pc.albedo_id			= attachmentIdx(GBuffer::ATTACHMENT_ALBEDO);
+			pc.normal_id			= attachmentIdx(GBuffer::ATTACHMENT_NORMAL);
+			pc.material_id			= attachmentIdx(GBuffer::ATTACHMENT_MATERIAL);
+			pc.emissive_id			= attachmentIdx(GBuffer::ATTACHMENT_EMISSIVE);
+			pc.visibility_id		= attachmentIdx(GBuffer::ATTACHMENT_VISIBILITY);
+			pc.irradianceMap_id		= cbmIdx(stdView(m_environmentProbe.irradiance));
+			pc.prefilterMap_id		= cbmIdx(stdView(m_environmentProbe.prefilter));
+			pc.brdfLUT_id			= tex2DIdx(stdView(m_brdfLUT));
+			pc.textureSampler_id	= smpIdx(m_app->getTextures().getLinearSampler());
+			pc.cubemapSampler_id	= smpIdx(m_app->getTextures().getLinearSampler());
+			pc.znear				= m_context.camera->near;
+			pc.zfar					= m_context.camera->far;
 
-					cmd->pushConstants(
-						pipelineSt.layout,
-						VK_SHADER_STAGE_ALL_GRAPHICS,
-						sizeof(pc),
-						&pc
-					);
+			cmd->pushConstants(
+				pipelineData.layout,
+				VK_SHADER_STAGE_ALL_GRAPHICS,
+				sizeof(GPU_DeferredLightingPushConstants),
+				&pc
+			);
 
-					cmd->drawIndexed(m_sphereMesh->getIndexCount());
-				}
-			}
+			cmd->draw(3);
 		})
 	);
 }
 
-void Renderer::renderSkybox(const RenderContext &context)
+void Renderer::renderSkybox()
 {
 	m_renderGraph->addPass(RenderPassDef()
 		.setAttachments({	
-			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_LOAD, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING])),
-			RenderGraphAttachment::getDepth(VK_ATTACHMENT_LOAD_OP_LOAD, stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_DEPTH]))
+			RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_LOAD, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING])),
+			RenderGraphAttachment::getDepth(VK_ATTACHMENT_LOAD_OP_LOAD, stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_DEPTH]))
 		})
 		.setInputViews({ stdView(m_environmentMap) })
 		.setRecordFn([&](CommandBuffer *cmd, const RenderInfo &info) -> void
@@ -731,7 +2066,7 @@ void Renderer::renderSkybox(const RenderContext &context)
 			}
 			pc;
 
-			pc.viewProj = context.camera->getProj() * context.camera->getRotationMatrix();
+			pc.viewProj = m_context.camera->getProj() * m_context.camera->getRotationMatrix();
 
 			cmd->pushConstants(
 				pipelineSt.layout,
@@ -742,24 +2077,140 @@ void Renderer::renderSkybox(const RenderContext &context)
 
 			m_skyboxMesh->bind(cmd);
 
-			cmd->drawIndexed(m_skyboxMesh->getIndexCount());
+			cmd->drawIndexed(m_skyboxMesh->getIndexCount(), 1, m_skyboxMesh->getFirstIndex(), m_skyboxMesh->getFirstVertex());
 		})
 	);
 }
 
-void Renderer::tonemappingPass(float exposure)
+void Renderer::bloomPass()
 {
+	Image *lighting = getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING];
+
 	m_renderGraph->addTask(ComputeTaskDef()
-		.setStorageViews({ stdView(m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING])})
-		.setRecordFn([&, exposure](CommandBuffer *cmd) -> void
+		.setInputViews({ stdView(lighting) })
+		.setStorageViews({ stdView(m_bloom) })
+		.setAsyncCompute(true)
+		.setRecordFn([&, lighting](CommandBuffer *cmd) -> void
 		{
-			Shader *hdrTonemappingShader = m_app->getShaders().getShader("hdr_tonemapping");
-	
-			ComputePipelineDef hdrTonemappingPipeline;
-			hdrTonemappingPipeline.setShader(hdrTonemappingShader);
+			// each level reads the one next to it, the graph only sees the chain as a whole
+			auto levelBarrier = [&]() -> void
+			{
+				VkMemoryBarrier2 barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+				barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+				barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+				barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+				barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+				cmd->pipelineBarrier(0, { barrier }, {}, {});
+			};
+
+			// down the chain
+			{
+				ComputePipelineDef bloomDownsamplePipeline;
+				bloomDownsamplePipeline.setShader(m_app->getShaders().getShader("bloom_downsample"));
+
+				PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(bloomDownsamplePipeline);
+
+				cmd->bindPipeline(
+					VK_PIPELINE_BIND_POINT_COMPUTE,
+					pipelineState.pipeline
+				);
+
+				uint32_t srcWidth = lighting->getWidth();
+				uint32_t srcHeight = lighting->getHeight();
+
+				for (int i = 0; i < m_bloomDownsample_descriptors.size(); i++)
+				{
+					GPU_BloomDownsamplePushConstants pc = {};
+					pc.srcWidth		= srcWidth;
+					pc.srcHeight	= srcHeight;
+					pc.dstWidth		= CalcU::max(m_bloom->getWidth() >> i, 1);
+					pc.dstHeight	= CalcU::max(m_bloom->getHeight() >> i, 1);
+					pc.firstMip		= (i == 0) ? 1 : 0;
+					pc.threshold	= m_postProcess.getSettings().bloomThreshold;
+
+					cmd->bindDescriptors(
+						0,
+						VK_PIPELINE_BIND_POINT_COMPUTE,
+						pipelineState.layout,
+						{ m_bloomDownsample_descriptors[i] },
+						{}
+					);
+
+					cmd->pushConstants(
+						pipelineState.layout,
+						VK_SHADER_STAGE_COMPUTE_BIT,
+						sizeof(GPU_BloomDownsamplePushConstants),
+						&pc
+					);
+
+					cmd->dispatch((pc.dstWidth + 7) / 8, (pc.dstHeight + 7) / 8, 1);
+
+					levelBarrier();
+
+					srcWidth = pc.dstWidth;
+					srcHeight = pc.dstHeight;
+				}
+			}
+
+			// and back up, each level gets the blurred one below it added on
+			{
+				ComputePipelineDef bloomUpsamplePipeline;
+				bloomUpsamplePipeline.setShader(m_app->getShaders().getShader("bloom_upsample"));
+
+				PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(bloomUpsamplePipeline);
+
+				cmd->bindPipeline(
+					VK_PIPELINE_BIND_POINT_COMPUTE,
+					pipelineState.pipeline
+				);
+
+				for (int i = (int)m_bloomUpsample_descriptors.size() - 1; i >= 0; i--)
+				{
+					GPU_BloomUpsamplePushConstants pc = {};
+					pc.srcWidth		= CalcU::max(m_bloom->getWidth() >> (i + 1), 1);
+					pc.srcHeight	= CalcU::max(m_bloom->getHeight() >> (i + 1), 1);
+					pc.dstWidth		= CalcU::max(m_bloom->getWidth() >> i, 1);
+					pc.dstHeight	= CalcU::max(m_bloom->getHeight() >> i, 1);
+
+					cmd->bindDescriptors(
+						0,
+						VK_PIPELINE_BIND_POINT_COMPUTE,
+						pipelineState.layout,
+						{ m_bloomUpsample_descriptors[i] },
+						{}
+					);
+
+					cmd->pushConstants(
+						pipelineState.layout,
+						VK_SHADER_STAGE_COMPUTE_BIT,
+						sizeof(GPU_BloomUpsamplePushConstants),
+						&pc
+					);
+
+					cmd->dispatch((pc.dstWidth + 7) / 8, (pc.dstHeight + 7) / 8, 1);
+
+					levelBarrier();
+				}
+			}
+		})
+	);
+}
+
+void Renderer::luminanceHistogramPass()
+{
+	m_renderGraph->addTask(ComputeTaskDef()
+		.setInputViews({ stdView(getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]) })
+		.setStorageBuffers({ m_luminanceHistogram })
+		.setAsyncCompute(true)
+		.setRecordFn([&](CommandBuffer *cmd) -> void
+		{
+			ComputePipelineDef luminanceHistogramPipeline;
+			luminanceHistogramPipeline.setShader(m_app->getShaders().getShader("luminance_histogram"));
+
+			PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(luminanceHistogramPipeline);
 
-			PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(hdrTonemappingPipeline);
-			
 			cmd->bindPipeline(
 				VK_PIPELINE_BIND_POINT_COMPUTE,
 				pipelineState.pipeline
@@ -769,30 +2220,67 @@ void Renderer::tonemappingPass(float exposure)
 				0,
 				VK_PIPELINE_BIND_POINT_COMPUTE,
 				pipelineState.layout,
-				{ m_hdrTonemapping_descriptor },
+				{ m_luminanceHistogram_descriptor },
 				{}
 			);
 
-			struct
-			{
-				uint32_t width;
-				uint32_t height;
-				float exposure;
-			}
-			pc;
+			GPU_LuminanceHistogramPushConstants pc = {};
+			pc.histogram					= bufAddr(m_luminanceHistogram);
+			pc.width						= getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]->getWidth();
+			pc.height						= getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING]->getHeight();
+			pc.minLogLuminance				= MIN_LOG_LUMINANCE;
+			pc.inverseLogLuminanceRange		= 1.0f / (MAX_LOG_LUMINANCE - MIN_LOG_LUMINANCE);
+
+			cmd->pushConstants(
+				pipelineState.layout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				sizeof(GPU_LuminanceHistogramPushConstants),
+				&pc
+			);
 
-			pc.width = (uint32_t)m_app->getPlatform()->getWindowSizeInPixels().x;
-			pc.height = (uint32_t)m_app->getPlatform()->getWindowSizeInPixels().y;
-			pc.exposure = exposure;
+			cmd->dispatch((pc.width + 15) / 16, (pc.height + 15) / 16, 1);
+		})
+	);
+}
+
+void Renderer::exposureAdaptPass()
+{
+	m_renderGraph->addTask(ComputeTaskDef()
+		.setStorageBuffers({ m_luminanceHistogram, m_exposureData })
+		.setAsyncCompute(true)
+		.setRecordFn([&](CommandBuffer *cmd) -> void
+		{
+			ComputePipelineDef exposureAdaptPipeline;
+			exposureAdaptPipeline.setShader(m_app->getShaders().getShader("exposure_adapt"));
+
+			PipelineState pipelineState = m_app->getPipelines().fetchComputePipeline(exposureAdaptPipeline);
+
+			cmd->bindPipeline(
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineState.pipeline
+			);
+
+			Image *target = getGBuffer().attachments[GBuffer::ATTACHMENT_LIGHTING];
+
+			GPU_ExposureAdaptPushConstants pc = {};
+			pc.histogram				= bufAddr(m_luminanceHistogram);
+			pc.exposure					= bufAddr(m_exposureData);
+			pc.pixelCount				= target->getWidth() * target->getHeight();
+			pc.minLogLuminance			= MIN_LOG_LUMINANCE;
+			pc.logLuminanceRange		= MAX_LOG_LUMINANCE - MIN_LOG_LUMINANCE;
+			pc.deltaTime				= m_context.deltaTime;
+			pc.adaptationRate			= m_exposureAdaptationRate;
+			pc.exposureCompensation		= m_exposureCompensation;
 
 			cmd->pushConstants(
 				pipelineState.layout,
 				VK_SHADER_STAGE_COMPUTE_BIT,
-				sizeof(pc),
+				sizeof(GPU_ExposureAdaptPushConstants),
 				&pc
 			);
 
-			cmd->dispatch(pc.width, pc.height, 1);
+			// a single group, one thread per bin, which also clears the histogram for next frame
+			cmd->dispatch(1, 1, 1);
 		})
 	);
 }
@@ -801,76 +2289,116 @@ void Renderer::createGBuffer()
 {
 	Swapchain *swapchain = m_app->getGraphics()->getSwapchain();
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_POSITION] = m_app->getGraphics()->createImage(
+	Image *depth = m_renderGraph->createTransientImage(
 		swapchain->getWidth(),
 		swapchain->getHeight(),
-		1,
-		VK_FORMAT_R32G32B32A32_SFLOAT,
-		VK_IMAGE_VIEW_TYPE_2D,
-		VK_IMAGE_TILING_OPTIMAL,
-		1,
-		VK_SAMPLE_COUNT_1_BIT,
-		false,
-		false
+		m_app->getGraphics()->getDepthFormat()
 	);
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_ALBEDO] = m_app->getGraphics()->createImage(
-		swapchain->getWidth(),
-		swapchain->getHeight(),
-		1,
-		VK_FORMAT_R32G32B32A32_SFLOAT,
-		VK_IMAGE_VIEW_TYPE_2D,
-		VK_IMAGE_TILING_OPTIMAL,
-		1,
-		VK_SAMPLE_COUNT_1_BIT,
-		false,
-		false
-	);
+	for (int i = 0; i < GBUFFER_LAYOUT_MAX_ENUM; i++)
+	{
+		m_gBuffers[i].attachments[GBuffer::ATTACHMENT_DEPTH] = depth;
+		createGBufferLayout((GBufferLayout)i);
+	}
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_NORMAL] = m_app->getGraphics()->createImage(
-		swapchain->getWidth(),
-		swapchain->getHeight(),
-		1,
-		VK_FORMAT_R32G32B32A32_SFLOAT,
-		VK_IMAGE_VIEW_TYPE_2D,
-		VK_IMAGE_TILING_OPTIMAL,
-		1,
-		VK_SAMPLE_COUNT_1_BIT,
-		false,
-		false
-	);
+	// the largest power of two that fits in the depth buffer, that way every level past the first is an exact 2x2 reduction
+	uint32_t hiZWidth = 1;
+	uint32_t hiZHeight = 1;
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_MATERIAL] = m_app->getGraphics()->createImage(
-		swapchain->getWidth(),
-		swapchain->getHeight(),
-		1,
-		VK_FORMAT_R32G32B32A32_SFLOAT,
-		VK_IMAGE_VIEW_TYPE_2D,
-		VK_IMAGE_TILING_OPTIMAL,
-		1,
-		VK_SAMPLE_COUNT_1_BIT,
-		false,
-		false
-	);
+	while (hiZWidth * 2 <= swapchain->getWidth())
+		hiZWidth *= 2;
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_EMISSIVE] = m_app->getGraphics()->createImage(
-		swapchain->getWidth(),
-		swapchain->getHeight(),
+	while (hiZHeight * 2 <= swapchain->getHeight())
+		hiZHeight *= 2;
+
+	uint32_t hiZMipCount = 1;
+
+	while ((CalcU::max(hiZWidth, hiZHeight) >> hiZMipCount) > 0)
+		hiZMipCount++;
+
+	// outlives the frame so it can't be transient, the depth buffer it's built from is gone by the next one
+	m_hiZ = m_app->getGraphics()->createImage(
+		hiZWidth,
+		hiZHeight,
 		1,
-		VK_FORMAT_R32G32B32A32_SFLOAT,
+		VK_FORMAT_R32_SFLOAT,
 		VK_IMAGE_VIEW_TYPE_2D,
 		VK_IMAGE_TILING_OPTIMAL,
-		1,
+		hiZMipCount,
 		VK_SAMPLE_COUNT_1_BIT,
 		false,
-		false
+		true
 	);
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING] = m_app->getGraphics()->createImage(
+	// the transient ones can't have views until the graph has given them memory
+	for (auto &gBuffer : m_gBuffers)
+		tex2DIdx(stdView(gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING]));
+}
+
+void Renderer::createGBufferLayout(GBufferLayout layout)
+{
+	Swapchain *swapchain = m_app->getGraphics()->getSwapchain();
+
+	GBuffer &gBuffer = m_gBuffers[layout];
+
+	VkFormat formats[GBuffer::ATTACHMENT_DEPTH] = {};
+
+	if (layout == GBUFFER_LAYOUT_COMPACT)
+	{
+		formats[GBuffer::ATTACHMENT_POSITION]	= VK_FORMAT_UNDEFINED; // rebuilt from depth
+		formats[GBuffer::ATTACHMENT_ALBEDO]		= VK_FORMAT_R8G8B8A8_SRGB;
+		formats[GBuffer::ATTACHMENT_NORMAL]		= VK_FORMAT_R16G16_SNORM;
+		formats[GBuffer::ATTACHMENT_MATERIAL]	= VK_FORMAT_R8G8_UNORM;
+		formats[GBuffer::ATTACHMENT_EMISSIVE]	= VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+		formats[GBuffer::ATTACHMENT_LIGHTING]	= VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+	}
+	else if (layout == GBUFFER_LAYOUT_VISIBILITY)
+	{
+		// everything else comes from the triangle these point at
+		formats[GBuffer::ATTACHMENT_VISIBILITY]	= VK_FORMAT_R32_UINT;
+		formats[GBuffer::ATTACHMENT_LIGHTING]	= VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+	}
+	else
+	{
+		for (int i = 0; i < GBuffer::ATTACHMENT_DEPTH; i++)
+			formats[i] = VK_FORMAT_R32G32B32A32_SFLOAT;
+
+		formats[GBuffer::ATTACHMENT_VISIBILITY] = VK_FORMAT_UNDEFINED;
+	}
+
+	// everything apart from the lighting target is dead once lighting is done, so let the graph alias them
+	for (int i = 0; i < GBuffer::ATTACHMENT_LIGHTING; i++)
+	{
+		if (formats[i] == VK_FORMAT_UNDEFINED)
+		{
+			gBuffer.attachments[i] = nullptr;
+			continue;
+		}
+
+		gBuffer.attachments[i] = m_renderGraph->createTransientImage(
+			swapchain->getWidth(),
+			swapchain->getHeight(),
+			formats[i]
+		);
+	}
+
+	// only one layout is drawn at a time, so any earlier one with the same lighting format can lend it its target
+	for (int i = 0; i < layout; i++)
+	{
+		Image *lighting = m_gBuffers[i].attachments[GBuffer::ATTACHMENT_LIGHTING];
+
+		if (lighting->getFormat() == formats[GBuffer::ATTACHMENT_LIGHTING])
+		{
+			gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING] = lighting;
+			return;
+		}
+	}
+
+	gBuffer.attachments[GBuffer::ATTACHMENT_LIGHTING] = m_app->getGraphics()->createImage(
 		swapchain->getWidth(),
 		swapchain->getHeight(),
 		1,
-		VK_FORMAT_R32G32B32A32_SFLOAT,
+		formats[GBuffer::ATTACHMENT_LIGHTING],
 		VK_IMAGE_VIEW_TYPE_2D,
 		VK_IMAGE_TILING_OPTIMAL,
 		1,
@@ -878,82 +2406,87 @@ void Renderer::createGBuffer()
 		false,
 		true
 	);
+}
 
-	m_gBuffer.attachments[GBuffer::ATTACHMENT_DEPTH] = m_app->getGraphics()->createImage(
-		swapchain->getWidth(),
-		swapchain->getHeight(),
+void Renderer::createPostProcessResources()
+{
+	Swapchain *swapchain = m_app->getGraphics()->getSwapchain();
+
+	uint32_t bloomWidth = CalcU::max(swapchain->getWidth() / 2, 1);
+	uint32_t bloomHeight = CalcU::max(swapchain->getHeight() / 2, 1);
+
+	// stop before the smallest level gets down to nothing
+	uint32_t bloomMipCount = 1;
+
+	while (bloomMipCount < BLOOM_MIP_COUNT && (CalcU::min(bloomWidth, bloomHeight) >> bloomMipCount) > 0)
+		bloomMipCount++;
+
+	m_bloom = m_app->getGraphics()->createImage(
+		bloomWidth,
+		bloomHeight,
 		1,
-		m_app->getGraphics()->getDepthFormat(),
+		VK_FORMAT_R16G16B16A16_SFLOAT,
 		VK_IMAGE_VIEW_TYPE_2D,
 		VK_IMAGE_TILING_OPTIMAL,
-		1,
+		bloomMipCount,
 		VK_SAMPLE_COUNT_1_BIT,
 		false,
-		false
+		true
 	);
-	
-	for (int i = 0; i < GBuffer::ATTACHMENT_MAX_ENUM; i++)
-		tex2DIdx(stdView(m_gBuffer.attachments[i]));
+
+	for (int i = 0; i < m_colourGradingLUTs.size(); i++)
+	{
+		m_colourGradingLUTs[i] = m_app->getGraphics()->createImage(
+			PostProcessStack::COLOUR_GRADING_LUT_SIZE,
+			PostProcessStack::COLOUR_GRADING_LUT_SIZE,
+			PostProcessStack::COLOUR_GRADING_LUT_SIZE,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			VK_IMAGE_VIEW_TYPE_3D,
+			VK_IMAGE_TILING_OPTIMAL,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			false,
+			false
+		);
+
+		// both get filled so whichever one the composite ends up bound to is always in a sampleable layout
+		uploadColourGradingLUT(i);
+	}
 }
 
-void Renderer::createUnitSphereMesh()
+void Renderer::uploadColourGradingLUT(uint32_t index)
 {
-	std::vector<PrimitiveVertex> vertices;
-	std::vector<uint16_t> indices;
-
-	const float pi = 3.141592f;
-	const float tau = pi * 2.0f;
-
-	const float R = 1.0f;
+	std::vector<uint32_t> texels;
+	m_postProcess.bakeColourGradingLUT(&texels);
 
-	auto cartesianFromSpherical = [&](float r, float phi, float theta) -> glm::vec3 {
-		return {
-			 r * glm::cos(theta) * glm::cos(phi),
-			 r * glm::sin(theta),
-			-r * glm::cos(theta) * glm::sin(phi)
-		};
-	};
+	m_app->getGraphics()->getUploader().uploadImage(m_colourGradingLUTs[index], texels.data(), sizeof(uint32_t) * texels.size(), false);
+}
 
-	float dphi = tau / 50.0f;
-	float dtheta = pi / 20.0f;
+void Renderer::updateColourGradingLUT()
+{
+	if (m_colourGradingFramesLeft > 0)
+		m_colourGradingFramesLeft--;
 
-	for (int i = 0; i < 50; i++)
+	if (m_colourGradingUploadValue != 0)
 	{
-		float phi = dphi*i;
-
-		for (int j = 0; j < 20; j++)
-		{
-			float theta = dtheta*j - pi*0.5f;
-
-			glm::vec3 p0 = cartesianFromSpherical(R, phi,			theta);
-			glm::vec3 p1 = cartesianFromSpherical(R, phi,			theta + dtheta);
-			glm::vec3 p2 = cartesianFromSpherical(R, phi + dphi,	theta);
-			glm::vec3 p3 = cartesianFromSpherical(R, phi + dphi,	theta + dtheta);
-
-			indices.push_back(vertices.size() + 0);
-			indices.push_back(vertices.size() + 1);
-			indices.push_back(vertices.size() + 2);
+		// same as streamed textures, only swap over once the gpu has actually finished the upload
+		if (m_colourGradingUploadValue > m_app->getGraphics()->getGraphicsQueue().getCompletedTimelineValue())
+			return;
+
+		// frames recorded from here on sample the new one, the old one is left alone until the ones before have finished with it
+		m_colourGradingLUTIndex ^= 1;
+		m_colourGradingUploadValue = 0;
+		m_colourGradingFramesLeft = gfx_constants::FRAMES_IN_FLIGHT;
+	}
 
-			if (j != 19)
-			{
-				indices.push_back(vertices.size() + 2);
-				indices.push_back(vertices.size() + 1);
-				indices.push_back(vertices.size() + 3);
-			}
+	// dragging a slider only ever has one bake in flight, anything after that gets picked up by the next one
+	if (!m_colourGradingDirty || m_colourGradingFramesLeft > 0)
+		return;
 
-			vertices.push_back((PrimitiveVertex) { .position = p0 });
-			vertices.push_back((PrimitiveVertex) { .position = p1 });
-			vertices.push_back((PrimitiveVertex) { .position = p2 });
-			vertices.push_back((PrimitiveVertex) { .position = p3 });
-		}
-	}
+	uploadColourGradingLUT(m_colourGradingLUTIndex ^ 1);
 
-	m_sphereMesh = new Mesh(m_app->getGraphics());
-	m_sphereMesh->build(
-		&vertex_types::PRIMITIVE_VERTEX_FORMAT,
-		vertices.data(), vertices.size(),
-		indices.data(), indices.size()
-	);
+	m_colourGradingUploadValue = m_app->getGraphics()->getUploader().flush();
+	m_colourGradingDirty = false;
 }
 
 void Renderer::createSkyboxResources()
@@ -1016,7 +2549,10 @@ void Renderer::precomputeBRDF_LUT()
 
 	mgp_LOG("Precomputing BRDF...");
 
-	m_renderGraph->addPass(RenderPassDef()
+	// one-off, so it gets its own graph rather than being cached into the per-frame one
+	RenderGraph graph(m_app->getGraphics());
+
+	graph.addPass(RenderPassDef()
 		.setAttachments({ RenderGraphAttachment::getColour(VK_ATTACHMENT_LOAD_OP_LOAD, stdView(m_brdfLUT), nullptr, Colour::black()) })
 		.setRecordFn([&](CommandBuffer *cmd, const RenderInfo &info) -> void
 		{
@@ -1031,6 +2567,13 @@ void Renderer::precomputeBRDF_LUT()
 			cmd->draw(3);
 		})
 	);
+
+	// nothing in the graph reads it (it's sampled through the bindless set) so make sure it doesn't get culled
+	graph.addOutput(m_brdfLUT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	CommandBuffer *cmd = m_app->getGraphics()->beginInstantSubmit();
+	graph.recordTo(cmd, nullptr);
+	m_app->getGraphics()->submit(cmd);
 }
 
 void Renderer::generateEnvironmentMaps()
@@ -1135,7 +2678,7 @@ void Renderer::generateEnvironmentMaps()
 
 				m_skyboxMesh->bind(cmd);
 
-				cmd->drawIndexed(m_skyboxMesh->getIndexCount());
+				cmd->drawIndexed(m_skyboxMesh->getIndexCount(), 1, m_skyboxMesh->getFirstIndex(), m_skyboxMesh->getFirstVertex());
 			}
 			cmd->endRendering();
 		}
@@ -1220,7 +2763,7 @@ void Renderer::generateEnvironmentMaps()
 
 				m_skyboxMesh->bind(cmd);
 
-				cmd->drawIndexed(m_skyboxMesh->getIndexCount());
+				cmd->drawIndexed(m_skyboxMesh->getIndexCount(), 1, m_skyboxMesh->getFirstIndex(), m_skyboxMesh->getFirstVertex());
 			}
 			cmd->endRendering();
 		}
@@ -1302,7 +2845,7 @@ void Renderer::generateEnvironmentMaps()
 
 					m_skyboxMesh->bind(cmd);
 
-					cmd->drawIndexed(m_skyboxMesh->getIndexCount());
+					cmd->drawIndexed(m_skyboxMesh->getIndexCount(), 1, m_skyboxMesh->getFirstIndex(), m_skyboxMesh->getFirstVertex());
 				}
 				cmd->endRendering();
 			}
@@ -1331,35 +2874,79 @@ Material *Renderer::buildMaterial(const MaterialData &data)
 			continue;
 
 		passPipelines[i].setShader(technique.passes[i]);
-		passPipelines[i].setVertexFormat(technique.vertexFormat);
+
+		// the mesh shader fetches its own vertices
+		if (i != SHADER_PASS_DEFERRED_MESHLET && i != SHADER_PASS_DEFERRED_COMPACT_MESHLET)
+			passPipelines[i].setVertexFormat(technique.vertexFormat);
 	}
 
-	GPU_BindlessMaterial handles = {};
-	handles.diffuse_id		= data.textures[0].id;
-	handles.ambient_id		= data.textures[1].id;
-	handles.material_id		= data.textures[2].id;
-	handles.normal_id		= data.textures[3].id;
-	handles.emissive_id		= data.textures[4].id;
+	// integer targets can't be blended
+	if (technique.passes[SHADER_PASS_VISIBILITY])
+	{
+		BlendState visibilityBlend;
+		visibilityBlend.enabled = false;
 
-	uint32_t tableIndex = m_materialFreeIndex++;
+		passPipelines[SHADER_PASS_VISIBILITY].setBlendState(visibilityBlend);
+	}
 
-	m_bindlessMaterialTable->writeType<GPU_BindlessMaterial>(handles, tableIndex);
+	uint32_t tableIndex = m_materialFreeIndex++;
 
 	Material *material = new Material(tableIndex, data.textures, passPipelines, nullptr);
 
+	// a row no frame has read yet, so every copy can have it straight away
+	for (auto &frame : m_frames)
+		writeMaterialRow(frame.materials, material);
+
 	m_materials.insert({ data.getHash(), material });
 
 	return material;
 }
 
+void Renderer::retargetTexture(const BindlessHandle &from, const BindlessHandle &to)
+{
+	for (auto &[hash, material] : m_materials)
+	{
+		bool changed = false;
+
+		for (int i = 0; i < material->getTextures().size(); i++)
+		{
+			if (material->getTexture(i).id == from.id)
+			{
+				material->setTexture(i, to);
+				changed = true;
+			}
+		}
+
+		// the other frames' copies are still being read, they get rewritten as each one comes round
+		if (changed)
+			m_materialRewrites[material] = gfx_constants::FRAMES_IN_FLIGHT;
+	}
+}
+
+void Renderer::writeMaterialRow(GPUBuffer *table, const Material *material)
+{
+	GPU_BindlessMaterial handles = {};
+	handles.diffuse_id		= material->getTexture(0).id;
+	handles.ambient_id		= material->getTexture(1).id;
+	handles.material_id		= material->getTexture(2).id;
+	handles.normal_id		= material->getTexture(3).id;
+	handles.emissive_id		= material->getTexture(4).id;
+
+	table->writeType<GPU_BindlessMaterial>(handles, material->getTableIndex());
+}
+
 void Renderer::loadTechniques()
 {
 	// PBR
 	{
 		Technique texturedPBR_gbuffer;
 		texturedPBR_gbuffer.passes[SHADER_PASS_DEFERRED] = m_app->getShaders().getShader("texturedPBR_gbuffer");
+		texturedPBR_gbuffer.passes[SHADER_PASS_DEFERRED_COMPACT] = m_app->getShaders().getShader("texturedPBR_gbuffer_compact");
+		texturedPBR_gbuffer.passes[SHADER_PASS_VISIBILITY] = m_app->getShaders().getShader("texturedPBR_visibility");
+		texturedPBR_gbuffer.passes[SHADER_PASS_DEFERRED_MESHLET] = m_app->getGraphics()->hasMeshShaders() ? m_app->getShaders().getShader("texturedPBR_gbuffer_meshlet") : nullptr;
+		texturedPBR_gbuffer.passes[SHADER_PASS_DEFERRED_COMPACT_MESHLET] = m_app->getGraphics()->hasMeshShaders() ? m_app->getShaders().getShader("texturedPBR_gbuffer_compact_meshlet") : nullptr;
 		texturedPBR_gbuffer.passes[SHADER_PASS_FORWARD] = nullptr;
-		texturedPBR_gbuffer.vertexFormat = &vertex_types::MODEL_VERTEX_FORMAT;
+		texturedPBR_gbuffer.vertexFormat = &vertex_types::PACKED_MODEL_VERTEX_FORMAT;
 		addTechnique("texturedPBR_gbuffer_opaque", texturedPBR_gbuffer);
 	}
 }
@@ -1369,6 +2956,16 @@ void Renderer::addTechnique(const std::string &name, const Technique &technique)
 	m_techniques.insert({ name, technique });
 }
 
+FrameResources &Renderer::getFrame()
+{
+	return m_frames[m_app->getGraphics()->getCurrentFrameIndex()];
+}
+
+GBuffer &Renderer::getGBuffer()
+{
+	return m_gBuffers[m_gBufferLayout];
+}
+
 Descriptor *Renderer::allocateDescriptor(const std::vector<DescriptorLayout *> &layouts)
 {
 	return m_descriptorPool->allocate(layouts);
@@ -1398,3 +2995,19 @@ uint32_t Renderer::cbmIdx(ImageView *cubemap)
 {
 	return m_app->getBindlessResources()->fromCubemap(cubemap).id;
 }
+
+bool Renderer::usesMeshletCulling() const
+{
+	// the visibility buffer packs triangle ids per draw, meshlet draws would restart them
+	return m_meshletCulling && m_gBufferLayout != GBUFFER_LAYOUT_VISIBILITY && m_meshletCount > 0;
+}
+
+bool Renderer::usesMeshShaders() const
+{
+	return usesMeshletCulling() && m_app->getGraphics()->hasMeshShaders();
+}
+
+bool Renderer::canUseVisibilityLayout() const
+{
+	return m_drawCount <= MAX_VISIBILITY_DRAWS;
+}
@@ -1,11 +1,18 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <array>
+
+#include <glm/glm.hpp>
 
 #include "graphics/render_graph.h"
+#include "graphics/constants.h"
 
 #include "material.h"
+#include "transform_buffer.h"
+#include "post_process.h"
 
 namespace mgp
 {
@@ -24,6 +31,21 @@ namespace mgp
 	class App;
 	class Mesh;
 
+	/*
+		The full layout keeps everything in RGBA32F, world position included.
+		The compact one packs it down to what lighting actually needs and gets position back from depth:
+		RGBA8 sRGB albedo, octahedral RG16 normals, RG8 roughness / metal and R11G11B10 emissive and lighting.
+		The visibility one only stores which triangle covers each pixel, the lighting pass fetches its vertices and samples the material itself.
+	*/
+	enum GBufferLayout
+	{
+		GBUFFER_LAYOUT_FULL,
+		GBUFFER_LAYOUT_COMPACT,
+		GBUFFER_LAYOUT_VISIBILITY,
+
+		GBUFFER_LAYOUT_MAX_ENUM
+	};
+
 	struct GBuffer
 	{
 		enum
@@ -33,13 +55,14 @@ namespace mgp
 			ATTACHMENT_NORMAL,
 			ATTACHMENT_MATERIAL,
 			ATTACHMENT_EMISSIVE,
+			ATTACHMENT_VISIBILITY,
 			ATTACHMENT_LIGHTING,
 			ATTACHMENT_DEPTH,
 
 			ATTACHMENT_MAX_ENUM
 		};
 
-		Image *attachments[ATTACHMENT_MAX_ENUM];
+		Image *attachments[ATTACHMENT_MAX_ENUM]; // null for anything the layout doesn't use
 	};
 
 	struct EnvironmentProbe
@@ -47,16 +70,62 @@ namespace mgp
 		Image *prefilter, *irradiance;
 	};
 
+	// matches PointLight in shared/types.slang
+	struct GPU_PointLight
+	{
+		glm::vec4 position; // [x,y,z]: position, [w]: radius
+		glm::vec4 colour; // [x,y,z]: colour, [w]: intensity
+		glm::vec4 attenuation; // [x]*dist^2 + [y]*dist + [z], [w]: has shadows? 0/1
+	};
+
+	// host-written buffers that the gpu may still be reading while the next frames are being recorded
+	struct FrameResources
+	{
+		GPUBuffer *frameConstants;
+		GPUBuffer *pointLights;
+		GPUBuffer *modelBuffers;
+		GPUBuffer *visibleDraws; // draw record indices that survived culling, sized to the draw list
+		GPUBuffer *cullData;
+		GPUBuffer *materials; // the bindless material table, a streamed texture's new slot has to reach every copy in turn
+	};
+
+	/*
+		Occlusion culling runs in two phases.
+		Early draws whatever was visible last frame, the hi-z pyramid is then built from that depth and late
+		tests everything against it, drawing only what was newly uncovered and remembering what's visible for next frame.
+	*/
+	enum DrawCullPhase
+	{
+		DRAW_CULL_PHASE_EARLY,
+		DRAW_CULL_PHASE_LATE
+	};
+
+	// meshes that share a pipeline and vertex / index buffers, drawn together with a single indirect call
+	struct DrawBatch
+	{
+		Mesh *mesh; // any mesh in the batch, only used to bind the pipeline and buffers
+		uint32_t firstDraw;
+		uint32_t drawCount;
+		uint32_t meshletDrawCount; // the rest were never split and are drawn whole
+		uint32_t firstCommand;
+		uint32_t commandCount; // room for a command per meshlet, a draw without any takes one
+		uint32_t firstTask;
+		uint32_t taskCount; // task workgroups if every draw in the batch survived
+	};
+
 	struct RenderContext
 	{
 		CommandBuffer *cmd;
 		Swapchain *swapchain;
 		Scene *scene;
 		Camera *camera;
+		float deltaTime;
 	};
 
 	class Renderer
 	{
+		constexpr static uint32_t INITIAL_POINT_LIGHT_CAPACITY = 256;
+
 	public:
 		Renderer();
 		~Renderer() = default;
@@ -67,12 +136,18 @@ namespace mgp
 		
 		Material *buildMaterial(const MaterialData &data);
 
+		// points every material sampling one texture slot at another, each frame's table picks it up the next time that frame comes round
+		void retargetTexture(const BindlessHandle &from, const BindlessHandle &to);
+
 	private:
 
 		// init
 		void createGBuffer();
+		void createGBufferLayout(GBufferLayout layout);
 		void createSkyboxResources();
-		void createUnitSphereMesh();
+		void createPostProcessResources();
+		void uploadColourGradingLUT(uint32_t index);
+		void updateColourGradingLUT();
 
 		// pbr
 		void precomputeBRDF_LUT();
@@ -82,41 +157,131 @@ namespace mgp
 		void loadTechniques();
 		void addTechnique(const std::string &name, const Technique &technique);
 
+		// graph
+		void buildRenderGraph();
+		void uploadFrameData();
+		void buildDrawRecords();
+		void writeModelBuffers();
+		void writeLightingDescriptors();
+		void setGBufferLayout(GBufferLayout layout);
+		void writeTransientDescriptors();
+		void writeMaterialRow(GPUBuffer *table, const Material *material);
+		void resizePointLightBuffers(uint32_t capacity);
+		void cullScene();
+
 		// world
 		void shadowPass(const RenderContext &context);
-		void deferredPass(const RenderContext &context);
-		void lightingPass(const RenderContext &context);
+		void drawCullPass(DrawCullPhase phase);
+		void meshletCullPass(CommandBuffer *cmd, DrawCullPhase phase);
+		void hiZPass();
+		void deferredPass(DrawCullPhase phase);
+		void lightClusterPass();
+		void lightingPass();
 
 		// skybox
-		void renderSkybox(const RenderContext &context);
+		void renderSkybox();
 
 		// post-processing
-		void tonemappingPass(float exposure);
+		void bloomPass();
+		void luminanceHistogramPass();
+		void exposureAdaptPass();
+		void compositePass();
 
 		// utils
+		FrameResources &getFrame();
+		GBuffer &getGBuffer();
 		Descriptor *allocateDescriptor(const std::vector<DescriptorLayout *> &layouts);
 		ImageView *stdView(Image *image);
 		VkDeviceAddress bufAddr(GPUBuffer *buffer);
 		uint32_t smpIdx(Sampler *sampler);
 		uint32_t tex2DIdx(ImageView *view);
 		uint32_t cbmIdx(ImageView *cubemap);
+		bool usesMeshletCulling() const;
+		bool usesMeshShaders() const;
+		bool canUseVisibilityLayout() const;
 
 		App *m_app;
 
 		RenderGraph *m_renderGraph;
+		uint32_t m_graphWidth;
+		uint32_t m_graphHeight;
+
+		RenderContext m_context;
+
+		// the plan's stage list is read when recording, only the passes it needs are baked into the graph
+		PostProcessStack m_postProcess;
+		PostProcessPlan m_postProcessPlan;
+		uint32_t m_frameCount;
+
+		float m_exposureCompensation;
+		float m_exposureAdaptationRate;
+
+		GPUBuffer *m_luminanceHistogram;
+		GPUBuffer *m_exposureData;
+
+		Image *m_bloom; // half res, one level per step of the chain
+		std::vector<Descriptor *> m_bloomDownsample_descriptors; // one per level
+		std::vector<Descriptor *> m_bloomUpsample_descriptors; // one per level apart from the last
+
+		// ping-ponged so moving a slider never has to touch the lut frames in flight are still sampling
+		std::array<Image *, 2> m_colourGradingLUTs;
+		uint32_t m_colourGradingLUTIndex; // the one the composite samples
+		bool m_colourGradingDirty; // the settings have moved on since the last bake
+		uint64_t m_colourGradingUploadValue; // graphics timeline value the back lut's upload lands at, 0 if there isn't one
+		uint32_t m_colourGradingFramesLeft; // frames until the back lut stops being sampled
 
-		GBuffer m_gBuffer;
+		// all three layouts exist up front so they can be switched between at runtime
+		// only the active one's transients are ever alive so the graph lays the others on top of it, depth and same-format lighting targets are shared outright
+		std::array<GBuffer, GBUFFER_LAYOUT_MAX_ENUM> m_gBuffers;
+		GBufferLayout m_gBufferLayout;
 
-		GPUBuffer *m_frameConstantsBuffer;
-		GPUBuffer *m_transformDataBuffer;
-		GPUBuffer *m_bindlessMaterialTable;
-		GPUBuffer *m_pointLightBuffer;
-		GPUBuffer *m_modelBuffersBuffer;
+		std::array<FrameResources, gfx_constants::FRAMES_IN_FLIGHT> m_frames;
+
+		TransformBuffer m_transformBuffer;
+
+		// the per-frame light buffers grow to fit the scene, then the gpu bins them into froxels every frame
+		uint32_t m_pointLightCapacity;
+		std::vector<GPU_PointLight> m_gpuPointLights;
+		GPUBuffer *m_lightClusters;
+
+		// built once from the scene's render list, the gpu turns these into the indirect commands every frame
+		GPUBuffer *m_drawRecords;
+		GPUBuffer *m_drawCommands;
+		GPUBuffer *m_drawCounts;
+		GPUBuffer *m_lateDrawCommands;
+		GPUBuffer *m_lateDrawCounts;
+		GPUBuffer *m_drawVisibility; // one flag per draw record, whether it was visible at the end of last frame
+		std::vector<DrawBatch> m_drawBatches;
+		uint32_t m_drawCount;
+		uint32_t m_drawListVersion;
+
+		// every mesh's meshlets back to back, culled by the task shader or by a compute pass that writes indexed draws without one
+		GPUBuffer *m_meshlets;
+		GPUBuffer *m_meshletVertices;
+		GPUBuffer *m_meshletTriangles;
+		GPUBuffer *m_meshTasks;
+		GPUBuffer *m_meshTaskCommands; // one per batch
+		GPUBuffer *m_lateMeshTasks;
+		GPUBuffer *m_lateMeshTaskCommands;
+		uint32_t m_meshletCount;
+		bool m_meshletCulling;
+
+		// render list index -> draw record index, culling works on the former and the gpu on the latter
+		std::vector<uint32_t> m_drawRecordIndices;
+		std::vector<uint32_t> m_visibleDraws;
+		uint32_t m_visibleDrawCount;
+		double m_cullTime;
+
+		Image *m_hiZ;
+		std::vector<Descriptor *> m_hiZReduce_descriptors; // one per level
+		uint32_t m_transientPlacement; // the render graph's placement the transient descriptors were last written for
+
+		Descriptor *m_drawCommands_descriptor;
 
 		DescriptorPool *m_descriptorPool;
 
-		Descriptor *m_textureUV_descriptor;
-		Descriptor *m_hdrTonemapping_descriptor;
+		std::array<Descriptor *, 2> m_postComposite_descriptors; // one per colour grading lut
+		Descriptor *m_luminanceHistogram_descriptor;
 
 		Image *m_brdfLUT;
 
@@ -126,9 +291,8 @@ namespace mgp
 		Mesh *m_skyboxMesh;
 		Descriptor *m_skybox_descriptor;
 
-		Mesh *m_sphereMesh;
-
 		std::unordered_map<uint64_t, Material *> m_materials;
+		std::unordered_map<Material *, uint32_t> m_materialRewrites; // how many frames' tables still have the old row
 		std::unordered_map<std::string, Technique> m_techniques;
 		uint32_t m_materialFreeIndex;
 	};
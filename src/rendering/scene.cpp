@@ -9,8 +9,10 @@ Scene::Scene()
 	: m_renderObjects()
 	, m_renderList()
 	, m_renderListDirty(true)
-	, m_pointsLights{}
-	, m_pointLightCount(0)
+	, m_renderListVersion(0)
+	, m_bounds()
+	, m_boundsVersion(0)
+	, m_pointLights()
 {
 }
 
@@ -62,6 +64,7 @@ RenderObject *Scene::createRenderObject()
 {
 	m_renderListDirty = true;
 	m_renderObjects.emplace_back();
+	m_renderObjects.back().index = m_renderObjects.size() - 1;
 	return &m_renderObjects.back(); // bad
 }
 
@@ -98,35 +101,68 @@ const std::vector<Mesh *> &Scene::getRenderList()
 		sortRenderListByMaterialHash(0, m_renderList.size() - 1);
 
 		m_renderListDirty = false;
+		m_renderListVersion++;
 	}
 
 	return m_renderList;
 }
 
+uint32_t Scene::getRenderListVersion()
+{
+	getRenderList();
+
+	return m_renderListVersion;
+}
+
+void Scene::updateBounds()
+{
+	cauto &renderList = getRenderList();
+
+	bool rebuilt = m_boundsVersion != m_renderListVersion;
+
+	if (rebuilt)
+	{
+		m_bounds.resize(renderList.size());
+		m_boundsVersion = m_renderListVersion;
+	}
+
+	for (uint32_t i = 0; i < renderList.size(); i++)
+	{
+		Mesh *mesh = renderList[i];
+		RenderObject *owner = mesh->getParent()->getOwner();
+
+		if (!rebuilt && (!owner || !owner->transform.hasChanged()))
+			continue;
+
+		glm::mat4 transform = owner ? owner->transform.getMatrix() : glm::identity<glm::mat4>();
+
+		m_bounds.set(i, mesh->getBoundingBox(), mesh->getBoundingSphere(), transform);
+	}
+}
+
 void Scene::addLight(const Light& light)
 {
 	switch (light.getType())
 	{
 		case Light::TYPE_POINT:
 		{
-			m_pointsLights[m_pointLightCount] = light;
-			m_pointLightCount++;
+			m_pointLights.push_back(light);
 		}
 		break;
 	}
 }
 
-std::array<Light, MAX_POINT_LIGHTS> &Scene::getPointLights()
+std::vector<Light> &Scene::getPointLights()
 {
-	return m_pointsLights;
+	return m_pointLights;
 }
 
-const std::array<Light, MAX_POINT_LIGHTS> &Scene::getPointLights() const
+const std::vector<Light> &Scene::getPointLights() const
 {
-	return m_pointsLights;
+	return m_pointLights;
 }
 
 int Scene::getPointLightCount() const
 {
-	return m_pointLightCount;
+	return m_pointLights.size();
 }
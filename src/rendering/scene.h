@@ -9,6 +9,7 @@
 #include "math/transform.h"
 
 #include "light.h"
+#include "culling.h"
 
 namespace mgp
 {
@@ -20,6 +21,9 @@ namespace mgp
 	public:
 		Transform transform;
 		Model *model;
+
+		// slot in the per-object transform buffer
+		uint32_t index;
 	};
 
 	class Scene
@@ -36,10 +40,18 @@ namespace mgp
 		std::vector<RenderObject> &getRenderObjects();
 		const std::vector<Mesh *> &getRenderList();
 
+		// bumped every time the render list gets rebuilt, so anything derived from it knows when to follow
+		uint32_t getRenderListVersion();
+
+		// brings the world space bounds of every mesh in the render list up to date, indexed the same as the list
+		// has to happen before anything clears the transforms' change flags for the frame
+		void updateBounds();
+		const CullBounds &getBounds() const { return m_bounds; }
+
 		void addLight(const Light &light);
 
-		std::array<Light, MAX_POINT_LIGHTS> &getPointLights();
-		const std::array<Light, MAX_POINT_LIGHTS> &getPointLights() const;
+		std::vector<Light> &getPointLights();
+		const std::vector<Light> &getPointLights() const;
 
 		int getPointLightCount() const;
 
@@ -51,8 +63,11 @@ namespace mgp
 
 		std::vector<Mesh *> m_renderList;
 		bool m_renderListDirty;
+		uint32_t m_renderListVersion;
+
+		CullBounds m_bounds;
+		uint32_t m_boundsVersion;
 
-		std::array<Light, MAX_POINT_LIGHTS> m_pointsLights;
-		int m_pointLightCount;
+		std::vector<Light> m_pointLights;
 	};
 }
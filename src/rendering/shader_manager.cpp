@@ -50,6 +50,7 @@ ShaderStage *ShaderManager::loadShaderStage(const std::string &name, const std::
 
 void ShaderManager::addShader(const std::string &name, Shader *shader)
 {
+	shader->setName(name);
 	m_shaderCache.insert({ name, shader });
 }
 
@@ -65,7 +66,6 @@ void ShaderManager::loadShaders()
 		loadShaderStage("fullscreen_triangle_vs",				"fullscreen_triangle_vs",				VK_SHADER_STAGE_VERTEX_BIT);
 		loadShaderStage("model_vs",								"model_vs",								VK_SHADER_STAGE_VERTEX_BIT);
 		loadShaderStage("model_shadow_map_vs",					"model_shadow_map_vs",					VK_SHADER_STAGE_VERTEX_BIT);
-		loadShaderStage("deferred_lighting_point_light_vs",		"deferred_lighting_point_light",		VK_SHADER_STAGE_VERTEX_BIT);
 
 		// fragment shaders
 		loadShaderStage("equirectangular_to_cubemap_fs",		"equirectangular_to_cubemap_fs",		VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -74,14 +74,32 @@ void ShaderManager::loadShaders()
 		loadShaderStage("brdf_integrator_fs",					"brdf_integrator_fs",					VK_SHADER_STAGE_FRAGMENT_BIT);
 //		loadShaderStage("texturedPBR_fs",						"texturedPBR_fs",						VK_SHADER_STAGE_FRAGMENT_BIT);
 		loadShaderStage("texturedPBR_gbuffer_fs",				"texturedPBR_gbuffer_fs",				VK_SHADER_STAGE_FRAGMENT_BIT);
-		loadShaderStage("deferred_lighting_ambient_fs",			"deferred_lighting_ambient_fs",			VK_SHADER_STAGE_FRAGMENT_BIT);
-		loadShaderStage("deferred_lighting_point_light_fs",		"deferred_lighting_point_light",		VK_SHADER_STAGE_FRAGMENT_BIT);
+		loadShaderStage("texturedPBR_gbuffer_compact_fs",		"texturedPBR_gbuffer_compact_fs",		VK_SHADER_STAGE_FRAGMENT_BIT);
+		loadShaderStage("deferred_lighting_fs",					"deferred_lighting_fs",					VK_SHADER_STAGE_FRAGMENT_BIT);
+		loadShaderStage("deferred_lighting_compact_fs",			"deferred_lighting_compact_fs",			VK_SHADER_STAGE_FRAGMENT_BIT);
+		loadShaderStage("texturedPBR_visibility_fs",			"texturedPBR_visibility_fs",			VK_SHADER_STAGE_FRAGMENT_BIT);
+		loadShaderStage("deferred_lighting_visibility_fs",		"deferred_lighting_visibility_fs",		VK_SHADER_STAGE_FRAGMENT_BIT);
 		loadShaderStage("skybox_fs",							"skybox",								VK_SHADER_STAGE_FRAGMENT_BIT);
 		loadShaderStage("texture_uv_fs",						"texture_uv_fs",						VK_SHADER_STAGE_FRAGMENT_BIT);
+		loadShaderStage("post_composite_fs",					"post_composite_fs",					VK_SHADER_STAGE_FRAGMENT_BIT);
 		loadShaderStage("shadow_map_fs",						"shadow_map_fs",						VK_SHADER_STAGE_FRAGMENT_BIT);
 
 		// compute shaders
-		loadShaderStage("hdr_tonemapping_cs", "hdr_tonemapping_cs",									VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("draw_commands_cs", "draw_commands_cs",										VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("hiz_reduce_cs", "hiz_reduce_cs",											VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("light_clusters_cs", "light_clusters_cs",									VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("luminance_histogram_cs", "luminance_histogram_cs",							VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("exposure_adapt_cs", "exposure_adapt_cs",									VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("bloom_downsample_cs", "bloom_downsample_cs",								VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("bloom_upsample_cs", "bloom_upsample_cs",									VK_SHADER_STAGE_COMPUTE_BIT);
+		loadShaderStage("meshlet_cull_cs", "meshlet_cull_cs",										VK_SHADER_STAGE_COMPUTE_BIT);
+
+		// task / mesh shaders, only there if the device supports them
+		if (m_app->getGraphics()->hasMeshShaders())
+		{
+			loadShaderStage("model_ts",							"model_ms",								VK_SHADER_STAGE_TASK_BIT_EXT);
+			loadShaderStage("model_ms",							"model_ms",								VK_SHADER_STAGE_MESH_BIT_EXT);
+		}
 	}
 
 	// effects
@@ -108,23 +126,73 @@ void ShaderManager::loadShaders()
 			}
 		));
 
-		// DEFERRED LIGHTING AMBIENT
-		addShader("deferred_lighting_ambient", m_app->getGraphics()->createShader(
-			sizeof(int)*12 + sizeof(float)*4,
+		addShader("texturedPBR_gbuffer_compact", m_app->getGraphics()->createShader(
+			sizeof(int)*16,
+			{ m_app->getBindlessResources()->getLayout() },
+			{
+				getShaderStage("model_vs"),
+				getShaderStage("texturedPBR_gbuffer_compact_fs")
+			}
+		));
+
+		addShader("texturedPBR_visibility", m_app->getGraphics()->createShader(
+			sizeof(int)*16,
+			{ m_app->getBindlessResources()->getLayout() },
+			{
+				getShaderStage("model_vs"),
+				getShaderStage("texturedPBR_visibility_fs")
+			}
+		));
+
+		// same fragment shaders fed by meshlets the task shader kept
+		if (m_app->getGraphics()->hasMeshShaders())
+		{
+			addShader("texturedPBR_gbuffer_meshlet", m_app->getGraphics()->createShader(
+				sizeof(int)*16,
+				{ m_app->getBindlessResources()->getLayout() },
+				{
+					getShaderStage("model_ts"),
+					getShaderStage("model_ms"),
+					getShaderStage("texturedPBR_gbuffer_fs")
+				}
+			));
+
+			addShader("texturedPBR_gbuffer_compact_meshlet", m_app->getGraphics()->createShader(
+				sizeof(int)*16,
+				{ m_app->getBindlessResources()->getLayout() },
+				{
+					getShaderStage("model_ts"),
+					getShaderStage("model_ms"),
+					getShaderStage("texturedPBR_gbuffer_compact_fs")
+				}
+			));
+		}
+
+		// DEFERRED LIGHTING
+		addShader("deferred_lighting", m_app->getGraphics()->createShader(
+			4*sizeof(VkDeviceAddress) + 12*sizeof(uint32_t) + 2*sizeof(float),
+			{ m_app->getBindlessResources()->getLayout() },
+			{
+				getShaderStage("fullscreen_triangle_vs"),
+				getShaderStage("deferred_lighting_fs")
+			}
+		));
+
+		addShader("deferred_lighting_compact", m_app->getGraphics()->createShader(
+			4*sizeof(VkDeviceAddress) + 12*sizeof(uint32_t) + 2*sizeof(float),
 			{ m_app->getBindlessResources()->getLayout() },
 			{
 				getShaderStage("fullscreen_triangle_vs"),
-				getShaderStage("deferred_lighting_ambient_fs")
+				getShaderStage("deferred_lighting_compact_fs")
 			}
 		));
 
-		// DEFERRED LIGHTING POINT LIGHT
-		addShader("deferred_lighting_point_light", m_app->getGraphics()->createShader(
-			2*sizeof(VkDeviceAddress) + 16*sizeof(float) + 8*sizeof(uint32_t),
+		addShader("deferred_lighting_visibility", m_app->getGraphics()->createShader(
+			4*sizeof(VkDeviceAddress) + 12*sizeof(uint32_t) + 2*sizeof(float),
 			{ m_app->getBindlessResources()->getLayout() },
 			{
-				getShaderStage("deferred_lighting_point_light_vs"),
-				getShaderStage("deferred_lighting_point_light_fs")
+				getShaderStage("fullscreen_triangle_vs"),
+				getShaderStage("deferred_lighting_visibility_fs")
 			}
 		));
 
@@ -219,14 +287,95 @@ void ShaderManager::loadShaders()
 			));
 		}
 
-		// HDR TONEMAPPING
+		// BLOOM
 		{
-			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, { DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ) }, 0);
-			
-			addShader("hdr_tonemapping", m_app->getGraphics()->createShader(
-				sizeof(uint32_t)*2 + sizeof(float),
+			DescriptorLayout *downsampleLayout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, {
+				DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+				DescriptorLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE),
+				DescriptorLayoutBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+			}, 0);
+
+			addShader("bloom_downsample", m_app->getGraphics()->createShader(
+				sizeof(uint32_t)*5 + sizeof(float),
+				{ downsampleLayout },
+				{ getShaderStage("bloom_downsample_cs") }
+			));
+
+			DescriptorLayout *upsampleLayout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, {
+				DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE),
+				DescriptorLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+			}, 0);
+
+			addShader("bloom_upsample", m_app->getGraphics()->createShader(
+				sizeof(uint32_t)*4,
+				{ upsampleLayout },
+				{ getShaderStage("bloom_upsample_cs") }
+			));
+		}
+
+		// LUMINANCE HISTOGRAM
+		{
+			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, { DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) }, 0);
+
+			addShader("luminance_histogram", m_app->getGraphics()->createShader(
+				sizeof(VkDeviceAddress) + sizeof(uint32_t)*2 + sizeof(float)*2,
+				{ layout },
+				{ getShaderStage("luminance_histogram_cs") }
+			));
+		}
+
+		// EXPOSURE ADAPTATION
+		{
+			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, { }, 0);
+
+			addShader("exposure_adapt", m_app->getGraphics()->createShader(
+				sizeof(VkDeviceAddress)*2 + sizeof(uint32_t) + sizeof(float)*5,
+				{ layout },
+				{ getShaderStage("exposure_adapt_cs") }
+			));
+		}
+
+		// INDIRECT DRAW COMMANDS
+		{
+			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, { DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) }, 0);
+
+			addShader("draw_commands", m_app->getGraphics()->createShader(
+				10*sizeof(VkDeviceAddress) + 4*sizeof(uint32_t),
+				{ layout },
+				{ getShaderStage("draw_commands_cs") }
+			));
+
+			// reads the same pyramid through the same layout
+			addShader("meshlet_cull", m_app->getGraphics()->createShader(
+				8*sizeof(VkDeviceAddress) + 2*sizeof(uint32_t),
 				{ layout },
-				{ getShaderStage("hdr_tonemapping_cs") }
+				{ getShaderStage("meshlet_cull_cs") }
+			));
+		}
+
+		// HI-Z PYRAMID
+		{
+			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, {
+				DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+				DescriptorLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE),
+				DescriptorLayoutBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+			}, 0);
+
+			addShader("hiz_reduce", m_app->getGraphics()->createShader(
+				sizeof(uint32_t)*5,
+				{ layout },
+				{ getShaderStage("hiz_reduce_cs") }
+			));
+		}
+
+		// LIGHT CLUSTERS
+		{
+			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_COMPUTE_BIT, { }, 0);
+
+			addShader("light_clusters", m_app->getGraphics()->createShader(
+				3*sizeof(VkDeviceAddress) + 2*sizeof(uint32_t) + 4*sizeof(float),
+				{ layout },
+				{ getShaderStage("light_clusters_cs") }
 			));
 		}
 
@@ -243,5 +392,23 @@ void ShaderManager::loadShaders()
 				}
 			));
 		}
+
+		// POST COMPOSITE
+		{
+			DescriptorLayout *layout = m_app->getDescriptorLayouts().fetchLayout(VK_SHADER_STAGE_ALL_GRAPHICS, {
+				DescriptorLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+				DescriptorLayoutBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+				DescriptorLayoutBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+			}, 0);
+
+			addShader("post_composite", m_app->getGraphics()->createShader(
+				sizeof(VkDeviceAddress) + sizeof(uint32_t)*3 + sizeof(float)*3,
+				{ layout },
+				{
+					getShaderStage("fullscreen_triangle_vs"),
+					getShaderStage("post_composite_fs")
+				}
+			));
+		}
 	}
 }
@@ -1,23 +1,33 @@
 #include "texture_manager.h"
 
 #include "core/common.h"
+#include "core/app.h"
 
 #include "graphics/graphics_core.h"
 #include "graphics/bitmap.h"
 #include "graphics/gpu_buffer.h"
 #include "graphics/image.h"
+#include "graphics/image_view.h"
 
 using namespace mgp;
 
-void TextureManager::init(GraphicsCore *gfx)
+void TextureManager::init(App *app)
 {
-	m_gfx = gfx;
+	m_app = app;
+	m_gfx = app->getGraphics();
+
+	m_stopWorkers = false;
 
 	loadTextures();
 }
 
 void TextureManager::destroy()
 {
+	stopStreamingWorkers();
+
+	m_streaming.clear();
+	m_pendingSwaps.clear();
+
 	for (auto &[name, image] : m_loadedImageCache)
 		delete image;
 
@@ -42,6 +52,15 @@ Image *TextureManager::loadTexture(const std::string &name, const std::string &p
 
 	Bitmap bitmap(path);
 
+	Image *image = createTexture(bitmap);
+
+	m_loadedImageCache.insert({ name, image });
+
+	return image;
+}
+
+Image *TextureManager::createTexture(Bitmap &bitmap)
+{
 	Image *image = m_gfx->createImage(
 		bitmap.getWidth(), bitmap.getHeight(), 1,
 		(bitmap.getFormat() == Bitmap::FORMAT_RGBA8) ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT,
@@ -53,32 +72,179 @@ Image *TextureManager::loadTexture(const std::string &name, const std::string &p
 		false
 	);
 
-	GPUBuffer *stagingBuffer = m_gfx->createGPUBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-		bitmap.getMemorySize()
-	);
+	// goes out with the next submission, along with everything else loaded before then
+	m_gfx->getUploader().uploadImage(image, bitmap.getData(), bitmap.getMemorySize(), true);
+
+	return image;
+}
+
+BindlessHandle TextureManager::requestTexture(const std::string &name, const std::string &path, Image *fallback)
+{
+	BindlessResources *bindless = m_app->getBindlessResources();
+
+	// already on its way, everyone shares the one slot
+	auto it = m_streaming.find(name);
+
+	if (it != m_streaming.end())
+		return it->second;
+
+	if (m_loadedImageCache.contains(name) || m_workers.empty())
+		return bindless->fromTexture2D(m_app->getImageViews().fetchStdView(loadTexture(name, path)));
+
+	BindlessHandle handle = bindless->reserveTexture2D(m_app->getImageViews().fetchStdView(fallback));
 
-	stagingBuffer->write(bitmap.getData(), bitmap.getMemorySize(), 0);
+	m_streaming.insert({ name, handle });
 
-	CommandBuffer *cmd = m_gfx->beginInstantSubmit();
 	{
-		cmd->transitionLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		cmd->copyBufferToImage(stagingBuffer, image);
-		cmd->generateMipmaps(image);
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_jobs.push_back({ name, path });
 	}
-	m_gfx->submit(cmd);
 
-	m_loadedImageCache.insert({ name, image });
+	m_jobCondition.notify_one();
 
-	// wait when staging buffer needs to delete
-	// todo: yes, this is terrible and there really should just
-	//       be a single staging buffer used for the whole program
-	m_gfx->waitIdle();
+	return handle;
+}
 
-	delete stagingBuffer;
+void TextureManager::startStreamingWorkers(unsigned workerCount)
+{
+	if (!m_workers.empty())
+		return;
 
-	return image;
+	m_stopWorkers = false;
+
+	for (unsigned i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&TextureManager::workerLoop, this);
+
+	mgp_LOG("Started %u texture streaming workers.", workerCount);
+}
+
+void TextureManager::stopStreamingWorkers()
+{
+	if (m_workers.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+
+		m_stopWorkers = true;
+		m_jobs.clear();
+	}
+
+	m_jobCondition.notify_all();
+
+	for (auto &worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+
+	// whatever didn't make it is never going to, its slot just keeps the fallback
+	for (auto &result : m_results)
+		delete result.bitmap;
+
+	m_results.clear();
+}
+
+void TextureManager::workerLoop()
+{
+	while (true)
+	{
+		DecodeJob job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+
+			m_jobCondition.wait(lock, [&]() { return m_stopWorkers || !m_jobs.empty(); });
+
+			if (m_stopWorkers)
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		Bitmap *bitmap = new Bitmap(job.path);
+
+		{
+			std::lock_guard<std::mutex> lock(m_resultMutex);
+			m_results.push_back({ std::move(job.name), bitmap });
+		}
+	}
+}
+
+void TextureManager::update()
+{
+	std::vector<DecodeResult> results;
+
+	{
+		// if a worker is mid-push we'll just pick it up next time
+		std::unique_lock<std::mutex> lock(m_resultMutex, std::try_to_lock);
+
+		if (lock.owns_lock())
+		{
+			while (!m_results.empty() && results.size() < MAX_STREAMED_UPLOADS_PER_FRAME)
+			{
+				results.push_back(m_results.front());
+				m_results.pop_front();
+			}
+		}
+	}
+
+	if (!results.empty())
+	{
+		for (auto &result : results)
+		{
+			Image *image = createTexture(*result.bitmap);
+
+			m_loadedImageCache.insert({ result.name, image });
+
+			delete result.bitmap;
+
+			m_pendingSwaps.push_back({ result.name, m_app->getImageViews().fetchStdView(image), 0 });
+		}
+
+		// send them off now so we know exactly which timeline value to wait for before swapping
+		uint64_t uploadValue = m_gfx->getUploader().flush();
+
+		for (auto &swap : m_pendingSwaps)
+		{
+			if (swap.uploadValue == 0)
+				swap.uploadValue = uploadValue;
+		}
+	}
+
+	for (int i = (int)m_retiredSlots.size() - 1; i >= 0; i--)
+	{
+		if (--m_retiredSlots[i].framesLeft > 0)
+			continue;
+
+		m_app->getBindlessResources()->releaseTexture2D(m_retiredSlots[i].handle);
+		m_retiredSlots.erase(m_retiredSlots.begin() + i);
+	}
+
+	if (m_pendingSwaps.empty())
+		return;
+
+	// only hand out the new image once the gpu has actually finished uploading it
+	uint64_t completedValue = m_gfx->getGraphicsQueue().getCompletedTimelineValue();
+
+	for (int i = (int)m_pendingSwaps.size() - 1; i >= 0; i--)
+	{
+		if (m_pendingSwaps[i].uploadValue > completedValue)
+			continue;
+
+		auto it = m_streaming.find(m_pendingSwaps[i].name);
+
+		// frames in flight are still sampling the fallback through the old slot, so the image gets a slot of its own and the materials move over to it
+		BindlessHandle loaded = m_app->getBindlessResources()->fromTexture2D(m_pendingSwaps[i].view);
+		m_app->getRenderer().retargetTexture(it->second, loaded);
+
+		// one round of frames for every copy of the material table to move over, another for the frames reading the old copies to finish
+		m_retiredSlots.push_back({ it->second, gfx_constants::FRAMES_IN_FLIGHT * 2 });
+
+		m_streaming.erase(it);
+
+		m_pendingSwaps.erase(m_pendingSwaps.begin() + i);
+	}
 }
 
 void TextureManager::loadTextures()
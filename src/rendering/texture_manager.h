@@ -1,27 +1,52 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <deque>
 #include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rendering/bindless.h"
 
 namespace mgp
 {
+	class App;
 	class GraphicsCore;
 
 	class Image;
+	class ImageView;
 	class Sampler;
+	class Bitmap;
 
 	class TextureManager
 	{
+		// keeps a burst of finished decodes from turning into a burst of uploads in a single frame
+		constexpr static uint32_t MAX_STREAMED_UPLOADS_PER_FRAME = 8;
+
 	public:
 		TextureManager() = default;
 		~TextureManager() = default;
 
-		void init(GraphicsCore *gfx);
+		void init(App *app);
 		void destroy();
-		
+
 		Image *getTexture(const std::string &name);
 		Image *loadTexture(const std::string &name, const std::string &path);
-		
+
+		// returns straight away with a handle that samples the fallback until the real texture has been decoded and uploaded
+		// without any workers running this just loads synchronously
+		BindlessHandle requestTexture(const std::string &name, const std::string &path, Image *fallback);
+
+		void startStreamingWorkers(unsigned workerCount);
+		void stopStreamingWorkers();
+
+		// uploads whatever the workers finished decoding and swaps in textures the gpu is done uploading, never blocks
+		void update();
+
+		uint32_t getStreamingCount() const { return m_streaming.size(); }
+
 		Sampler *getLinearSampler();
 		Sampler *getNearestSampler();
 
@@ -32,12 +57,57 @@ namespace mgp
 		Image *getFallbackEmissive();
 
 	private:
+		struct DecodeJob
+		{
+			std::string name;
+			std::string path;
+		};
+
+		struct DecodeResult
+		{
+			std::string name;
+			Bitmap *bitmap;
+		};
+
+		struct PendingSwap
+		{
+			std::string name;
+			const ImageView *view;
+			uint64_t uploadValue;
+		};
+
+		struct RetiredSlot
+		{
+			BindlessHandle handle;
+			uint32_t framesLeft;
+		};
+
+		App *m_app;
 		GraphicsCore *m_gfx;
 
 		void loadTextures();
 
+		Image *createTexture(Bitmap &bitmap);
+
+		void workerLoop();
+
 		std::unordered_map<std::string, Image *> m_loadedImageCache;
 
+		std::vector<std::thread> m_workers;
+		bool m_stopWorkers;
+
+		std::mutex m_jobMutex;
+		std::condition_variable m_jobCondition;
+		std::deque<DecodeJob> m_jobs;
+
+		std::mutex m_resultMutex;
+		std::deque<DecodeResult> m_results;
+
+		// only touched by the main thread, textures stay in here until their slot has been swapped over
+		std::unordered_map<std::string, BindlessHandle> m_streaming;
+		std::vector<PendingSwap> m_pendingSwaps;
+		std::vector<RetiredSlot> m_retiredSlots; // fallback slots nothing points at anymore, freed once no frame in flight can still sample them
+
 		Sampler *m_linearSampler;
 		Sampler *m_nearestSampler;
 	};
@@ -0,0 +1,269 @@
+#include "transform_buffer.h"
+
+#include <algorithm>
+
+#include "core/common.h"
+
+#include "math/simd.h"
+
+#include "graphics/graphics_core.h"
+#include "graphics/gpu_buffer.h"
+
+#include "scene.h"
+
+using namespace mgp;
+
+// transpose(inverse(m)) of the upper 3x3, the cofactor columns over the determinant
+static void computeNormalMatrix(const glm::mat4 &model, glm::mat4 *normal)
+{
+	glm::vec3 a0 = model[0];
+	glm::vec3 a1 = model[1];
+	glm::vec3 a2 = model[2];
+
+	glm::vec3 c0 = glm::cross(a1, a2);
+	glm::vec3 c1 = glm::cross(a2, a0);
+	glm::vec3 c2 = glm::cross(a0, a1);
+
+	float invDet = 1.0f / glm::dot(a0, c0);
+
+	(*normal) = glm::mat4(
+		glm::vec4(c0 * invDet, 0.0f),
+		glm::vec4(c1 * invDet, 0.0f),
+		glm::vec4(c2 * invDet, 0.0f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	);
+}
+
+// same as above but four matrices at a time, one per lane
+static void computeNormalMatrices(const glm::mat4 *models, glm::mat4 *normals, uint32_t count)
+{
+	uint32_t i = 0;
+
+#if MGP_SIMD_SSE
+	for (; i + 4 <= count; i += 4)
+	{
+		const glm::mat4 &m0 = models[i + 0];
+		const glm::mat4 &m1 = models[i + 1];
+		const glm::mat4 &m2 = models[i + 2];
+		const glm::mat4 &m3 = models[i + 3];
+
+		// a[column][row]
+		__m128 a[3][3];
+
+		for (int c = 0; c < 3; c++)
+		{
+			for (int r = 0; r < 3; r++)
+				a[c][r] = _mm_set_ps(m3[c][r], m2[c][r], m1[c][r], m0[c][r]);
+		}
+
+		auto cross = [](const __m128 *u, const __m128 *v, __m128 *out) -> void
+		{
+			out[0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+			out[1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+			out[2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+		};
+
+		__m128 cof[3][3];
+
+		cross(a[1], a[2], cof[0]);
+		cross(a[2], a[0], cof[1]);
+		cross(a[0], a[1], cof[2]);
+
+		__m128 det = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(a[0][0], cof[0][0]), _mm_mul_ps(a[0][1], cof[0][1])),
+			_mm_mul_ps(a[0][2], cof[0][2])
+		);
+
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+		alignas(16) float lanes[3][3][4];
+
+		for (int c = 0; c < 3; c++)
+		{
+			for (int r = 0; r < 3; r++)
+				_mm_store_ps(lanes[c][r], _mm_mul_ps(cof[c][r], invDet));
+		}
+
+		for (int k = 0; k < 4; k++)
+		{
+			glm::mat4 &normal = normals[i + k];
+
+			normal = glm::identity<glm::mat4>();
+
+			for (int c = 0; c < 3; c++)
+			{
+				for (int r = 0; r < 3; r++)
+					normal[c][r] = lanes[c][r][k];
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+		computeNormalMatrix(models[i], &normals[i]);
+}
+
+TransformBuffer::TransformBuffer()
+	: m_gfx(nullptr)
+	, m_buffers()
+	, m_capacity(0)
+	, m_entries()
+	, m_framesPending()
+	, m_pendingSlots()
+	, m_changedSlots()
+	, m_changedModels()
+	, m_changedNormals()
+	, m_uploadedCount(0)
+	, m_uploadRangeCount(0)
+{
+}
+
+void TransformBuffer::init(GraphicsCore *gfx)
+{
+	m_gfx = gfx;
+
+	resize(INITIAL_CAPACITY);
+}
+
+void TransformBuffer::destroy()
+{
+	for (auto &buffer : m_buffers)
+	{
+		delete buffer;
+		buffer = nullptr;
+	}
+
+	m_capacity = 0;
+}
+
+void TransformBuffer::resize(uint32_t capacity)
+{
+	for (auto &buffer : m_buffers)
+	{
+		delete buffer;
+
+		buffer = m_gfx->createGPUBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+			sizeof(Entry) * capacity
+		);
+	}
+
+	m_capacity = capacity;
+
+	// the new copies start out empty so every slot has to go out to all of them again
+	m_pendingSlots.clear();
+
+	for (uint32_t i = 0; i < m_framesPending.size(); i++)
+	{
+		m_framesPending[i] = gfx_constants::FRAMES_IN_FLIGHT;
+		m_pendingSlots.push_back(i);
+	}
+}
+
+bool TransformBuffer::update(Scene *scene, uint32_t frameIndex)
+{
+	auto &objects = scene->getRenderObjects();
+
+	uint32_t objectCount = objects.size();
+
+	m_entries.resize(objectCount, { glm::identity<glm::mat4>(), glm::identity<glm::mat4>() });
+	m_framesPending.resize(objectCount, 0);
+
+	bool reallocated = false;
+
+	if (objectCount > m_capacity)
+	{
+		uint32_t capacity = m_capacity;
+
+		while (capacity < objectCount)
+			capacity *= 2;
+
+		// frames in flight are still reading the old copies
+		m_gfx->waitIdle();
+
+		resize(capacity);
+
+		reallocated = true;
+	}
+
+	// rebuild everything that moved since last frame in one go
+	m_changedSlots.clear();
+
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		if (!objects[i].transform.hasChanged())
+			continue;
+
+		objects[i].transform.clearChanged();
+		m_changedSlots.push_back(i);
+	}
+
+	if (!m_changedSlots.empty())
+	{
+		m_changedModels.resize(m_changedSlots.size());
+		m_changedNormals.resize(m_changedSlots.size());
+
+		for (uint32_t i = 0; i < m_changedSlots.size(); i++)
+			m_changedModels[i] = objects[m_changedSlots[i]].transform.getMatrix();
+
+		computeNormalMatrices(m_changedModels.data(), m_changedNormals.data(), m_changedSlots.size());
+
+		for (uint32_t i = 0; i < m_changedSlots.size(); i++)
+		{
+			uint32_t slot = m_changedSlots[i];
+
+			m_entries[slot].model = m_changedModels[i];
+			m_entries[slot].normalMatrix = m_changedNormals[i];
+
+			if (m_framesPending[slot] == 0)
+				m_pendingSlots.push_back(slot);
+
+			m_framesPending[slot] = gfx_constants::FRAMES_IN_FLIGHT;
+		}
+	}
+
+	m_uploadedCount = m_pendingSlots.size();
+	m_uploadRangeCount = 0;
+
+	if (m_pendingSlots.empty())
+		return reallocated;
+
+	std::sort(m_pendingSlots.begin(), m_pendingSlots.end());
+
+	// write out runs of neighbouring slots in one go
+	GPUBuffer *buffer = m_buffers[frameIndex];
+
+	uint32_t runStart = 0;
+
+	for (uint32_t i = 1; i <= m_pendingSlots.size(); i++)
+	{
+		if (i < m_pendingSlots.size() && m_pendingSlots[i] == m_pendingSlots[i - 1] + 1)
+			continue;
+
+		uint32_t firstSlot = m_pendingSlots[runStart];
+		uint32_t slotCount = i - runStart;
+
+		buffer->write(&m_entries[firstSlot], sizeof(Entry) * slotCount, sizeof(Entry) * firstSlot);
+
+		m_uploadRangeCount++;
+		runStart = i;
+	}
+
+	// this frame's copy is caught up, drop whatever every copy now has
+	uint32_t remaining = 0;
+
+	for (uint32_t i = 0; i < m_pendingSlots.size(); i++)
+	{
+		uint32_t slot = m_pendingSlots[i];
+
+		m_framesPending[slot]--;
+
+		if (m_framesPending[slot] > 0)
+			m_pendingSlots[remaining++] = slot;
+	}
+
+	m_pendingSlots.resize(remaining);
+
+	return reallocated;
+}
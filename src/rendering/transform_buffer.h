@@ -0,0 +1,71 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <vector>
+#include <array>
+
+#include <glm/glm.hpp>
+
+#include "graphics/constants.h"
+
+namespace mgp
+{
+	class GraphicsCore;
+	class GPUBuffer;
+	class Scene;
+
+	/*
+		One slot per render object, indexed by RenderObject::index, with a copy per frame in flight.
+		Only objects whose transform changed get their matrices rebuilt, and they're written out in contiguous
+		runs to each frame's copy in turn, so the per-frame cost follows how many objects moved rather than how many exist.
+	*/
+	class TransformBuffer
+	{
+		constexpr static uint32_t INITIAL_CAPACITY = 256;
+
+	public:
+		// matches TransformData in shared/types.slang
+		struct Entry
+		{
+			glm::mat4 model;
+			glm::mat4 normalMatrix;
+		};
+
+		TransformBuffer();
+		~TransformBuffer() = default;
+
+		void init(GraphicsCore *gfx);
+		void destroy();
+
+		// returns true if the buffers had to be recreated, anything holding on to their addresses needs updating
+		bool update(Scene *scene, uint32_t frameIndex);
+
+		GPUBuffer *getBuffer(uint32_t frameIndex) const { return m_buffers[frameIndex]; }
+
+		uint32_t getUploadedCount() const { return m_uploadedCount; }
+		uint32_t getUploadRangeCount() const { return m_uploadRangeCount; }
+
+	private:
+		void resize(uint32_t capacity);
+
+		GraphicsCore *m_gfx;
+
+		std::array<GPUBuffer *, gfx_constants::FRAMES_IN_FLIGHT> m_buffers;
+		uint32_t m_capacity;
+
+		std::vector<Entry> m_entries;
+
+		// how many of the frame copies are still behind on each slot
+		std::vector<uint8_t> m_framesPending;
+		std::vector<uint32_t> m_pendingSlots;
+
+		// scratch for the objects that changed this frame
+		std::vector<uint32_t> m_changedSlots;
+		std::vector<glm::mat4> m_changedModels;
+		std::vector<glm::mat4> m_changedNormals;
+
+		uint32_t m_uploadedCount;
+		uint32_t m_uploadRangeCount;
+	};
+}
@@ -1,13 +1,49 @@
 #include "vertex_types.h"
 
+#include <glm/gtc/packing.hpp>
+
+#include "math/calc.h"
+
 mgp::VertexFormat mgp::vertex_types::PRIMITIVE_VERTEX_FORMAT;
 mgp::VertexFormat mgp::vertex_types::PRIMITIVE_UV_VERTEX_FORMAT;
 mgp::VertexFormat mgp::vertex_types::MODEL_VERTEX_FORMAT;
+mgp::VertexFormat mgp::vertex_types::PACKED_MODEL_VERTEX_FORMAT;
 
 using namespace mgp;
 
+static int16_t packSnorm(float x)
+{
+	return (int16_t)glm::packSnorm1x16(x);
+}
+
+// folds the unit sphere onto an octahedron and then flat onto a square, which spreads the precision pretty evenly
+static glm::vec2 encodeOctahedral(const glm::vec3 &v)
+{
+	float length = glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z);
+
+	if (length <= 0.0f)
+		return glm::vec2(0.0f);
+
+	glm::vec3 n = v / length;
+
+	if (n.z < 0.0f)
+	{
+		return glm::vec2(
+			(1.0f - glm::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - glm::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)
+		);
+	}
+
+	return glm::vec2(n.x, n.y);
+}
+
 void vertex_types::initVertexTypes()
 {
+	PRIMITIVE_VERTEX_FORMAT.setName("primitive");
+	PRIMITIVE_UV_VERTEX_FORMAT.setName("primitive_uv");
+	MODEL_VERTEX_FORMAT.setName("model");
+	PACKED_MODEL_VERTEX_FORMAT.setName("packed_model");
+
 	PRIMITIVE_VERTEX_FORMAT.setBindings(
 		{
 			VertexFormat::Binding(
@@ -49,4 +85,57 @@ void vertex_types::initVertexTypes()
 			)
 		}
 	);
+
+	PACKED_MODEL_VERTEX_FORMAT.setBindings(
+		{
+			VertexFormat::Binding(
+				sizeof(PackedModelVertex),
+				VK_VERTEX_INPUT_RATE_VERTEX,
+				{
+					VertexFormat::Attribute(VK_FORMAT_R16G16B16A16_SNORM,	offsetof(PackedModelVertex, position)),
+					VertexFormat::Attribute(VK_FORMAT_R16G16_SFLOAT,		offsetof(PackedModelVertex, uv)),
+					VertexFormat::Attribute(VK_FORMAT_R16G16_SNORM,			offsetof(PackedModelVertex, normal)),
+					VertexFormat::Attribute(VK_FORMAT_R16G16_SNORM,			offsetof(PackedModelVertex, tangent)),
+					VertexFormat::Attribute(VK_FORMAT_R8G8B8A8_UNORM,		offsetof(PackedModelVertex, colour))
+				}
+			)
+		}
+	);
+}
+
+PackedModelVertex vertex_types::packModelVertex(const ModelVertex &vertex, const BoundingBox &bounds)
+{
+	PackedModelVertex result = {};
+
+	glm::vec3 centre = bounds.getCentre();
+	glm::vec3 extents = bounds.getExtents();
+
+	for (int i = 0; i < 3; i++)
+	{
+		// flat along this axis, everything decodes to the centre anyway
+		float relative = (extents[i] > 0.0f) ? (vertex.position[i] - centre[i]) / extents[i] : 0.0f;
+		result.position[i] = packSnorm(relative);
+	}
+
+	// which way the bitangent points relative to cross(normal, tangent), mirrored uvs flip it
+	float handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent);
+	result.position[3] = packSnorm(handedness < 0.0f ? -1.0f : 1.0f);
+
+	result.uv[0] = glm::packHalf1x16(vertex.uv.x);
+	result.uv[1] = glm::packHalf1x16(vertex.uv.y);
+
+	glm::vec2 normal = encodeOctahedral(vertex.normal);
+	result.normal[0] = packSnorm(normal.x);
+	result.normal[1] = packSnorm(normal.y);
+
+	glm::vec2 tangent = encodeOctahedral(vertex.tangent);
+	result.tangent[0] = packSnorm(tangent.x);
+	result.tangent[1] = packSnorm(tangent.y);
+
+	for (int i = 0; i < 3; i++)
+		result.colour[i] = (uint8_t)CalcF::round(CalcF::clamp(vertex.colour[i], 0.0f, 1.0f) * 255.0f);
+
+	result.colour[3] = 255;
+
+	return result;
 }
@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 
+#include "math/bounds.h"
+
 #include "graphics/vertex_format.h"
 
 namespace mgp
@@ -27,12 +29,31 @@ namespace mgp
 		glm::vec3 bitangent;
 	};
 
+	/*
+		What a ModelVertex actually gets uploaded as, 24 bytes rather than 68.
+		Positions are snorm relative to the mesh's bounding box so the shaders need its centre and extents to decode them,
+		the bitangent is rebuilt from the normal and tangent with the sign stashed in the position's spare component.
+		Has to match PackedModelVertex in vertices.slang.
+	*/
+	struct PackedModelVertex
+	{
+		int16_t position[4];	// snorm16, xyz relative to the bounds, w = bitangent sign
+		uint16_t uv[2];			// half
+		int16_t normal[2];		// octahedral snorm16
+		int16_t tangent[2];		// octahedral snorm16
+		uint8_t colour[4];		// unorm8
+	};
+
 	namespace vertex_types
 	{
 		extern VertexFormat PRIMITIVE_VERTEX_FORMAT;
 		extern VertexFormat PRIMITIVE_UV_VERTEX_FORMAT;
 		extern VertexFormat MODEL_VERTEX_FORMAT;
+		extern VertexFormat PACKED_MODEL_VERTEX_FORMAT;
 
 		void initVertexTypes();
+
+		// the bounds have to be the same ones the mesh ends up with, the shaders decode against them
+		PackedModelVertex packModelVertex(const ModelVertex &vertex, const BoundingBox &bounds);
 	}
 }